@@ -0,0 +1,337 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "core.h"
+
+#include <cstdlib> // for std::malloc/free
+#include <new> // for std::bad_alloc & placement new
+#include <type_traits> // for std::is_trivially_destructible
+#include <utility> // for std::forward
+#include <vector> // for std::vector
+
+#if defined(_MSC_VER)
+#include <malloc.h> // for _aligned_malloc
+#endif
+
+namespace moos {
+
+// Alignment that suits all SIMD loads & stores up to AVX-512, and also avoids sharing cache lines
+constexpr size_t SimdAlignment = 64;
+
+namespace detail {
+
+    constexpr bool isPowerOfTwo(size_t x)
+    {
+        return x != 0 && (x & (x - 1)) == 0;
+    }
+
+    constexpr size_t alignUp(size_t x, size_t alignment)
+    {
+        return (x + alignment - 1) & ~(alignment - 1);
+    }
+
+} // namespace detail
+
+// Allocates size bytes aligned to alignment (a power of two), which must be freed with alignedFree. Returns nullptr on failure.
+inline void* alignedAlloc(size_t size, size_t alignment = SimdAlignment)
+{
+    MOOS_ASSERT(detail::isPowerOfTwo(alignment));
+    alignment = std::max(alignment, sizeof(void*));
+    size = detail::alignUp(std::max(size, static_cast<size_t>(1)), alignment);
+#if defined(_MSC_VER)
+    return _aligned_malloc(size, alignment);
+#else
+    void* memory = nullptr;
+    return (posix_memalign(&memory, alignment, size) == 0) ? memory : nullptr;
+#endif
+}
+
+inline void alignedFree(void* memory)
+{
+#if defined(_MSC_VER)
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+// Standard allocator with at least the given alignment (e.g. for std::vector<mat4> with 64-byte aligned elements, which
+// the default allocator only guarantees for up to alignof(std::max_align_t) before C++17)
+template<typename T, size_t Alignment = SimdAlignment>
+class AlignedAllocator {
+public:
+    static_assert(detail::isPowerOfTwo(Alignment), "alignment must be a power of two");
+    static constexpr size_t alignment = (Alignment > alignof(T)) ? Alignment : alignof(T);
+
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        void* memory = alignedAlloc(count * sizeof(T), alignment);
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, size_t) noexcept
+    {
+        alignedFree(memory);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+template<typename T, size_t Alignment = SimdAlignment>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
+
+// Linear (bump) allocator for temporary per-frame data, e.g. scratch arrays for batch functions. Allocating is just an
+// aligned pointer increment, and memory is only released all at once with reset, or back to a marker with resetTo (so
+// nested scopes can free their own allocations). Objects aren't destructed, so only trivially destructible types can be
+// allocated. The capacity is fixed; running out is an error (asserted) and returns nullptr. Not thread-safe.
+class FrameArena {
+public:
+    using Marker = size_t;
+
+    explicit FrameArena(size_t capacity)
+        : m_memory(static_cast<u8*>(alignedAlloc(capacity, SimdAlignment)))
+        , m_capacity(capacity)
+    {
+        MOOS_ASSERT(m_memory != nullptr);
+    }
+
+    ~FrameArena()
+    {
+        alignedFree(m_memory);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    size_t capacity() const { return m_capacity; }
+    size_t used() const { return m_offset; }
+
+    void* allocate(size_t size, size_t alignment = SimdAlignment)
+    {
+        MOOS_ASSERT(detail::isPowerOfTwo(alignment) && alignment <= SimdAlignment);
+        size_t start = detail::alignUp(m_offset, alignment);
+        if (start > m_capacity || size > m_capacity - start) {
+            MOOS_ASSERT(false && "frame arena is out of memory");
+            return nullptr;
+        }
+        m_offset = start + size;
+        return m_memory + start;
+    }
+
+    // Allocates an array of count default-initialized (i.e. for math types, uninitialized) objects
+    template<typename T>
+    T* allocateArray(size_t count, size_t alignment = SimdAlignment)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "frame arena objects are never destructed");
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            MOOS_ASSERT(false && "frame arena is out of memory");
+            return nullptr;
+        }
+        T* objects = static_cast<T*>(allocate(count * sizeof(T), std::max(alignment, alignof(T))));
+        for (size_t i = 0; objects != nullptr && i < count; ++i) {
+            new (objects + i) T;
+        }
+        return objects;
+    }
+
+    Marker mark() const { return m_offset; }
+
+    void resetTo(Marker marker)
+    {
+        MOOS_ASSERT(marker <= m_offset);
+        m_offset = marker;
+    }
+
+    void reset()
+    {
+        m_offset = 0;
+    }
+
+private:
+    u8* m_memory { nullptr };
+    size_t m_capacity { 0 };
+    size_t m_offset { 0 };
+};
+
+// Standard allocator that allocates from a FrameArena, e.g. for a temporary std::vector that's discarded with the frame.
+// Deallocation is a no-op, so growing a vector leaves its old storage in the arena until it's reset.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& arena) noexcept
+        : m_arena(&arena)
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : m_arena(&other.arena())
+    {
+    }
+
+    FrameArena& arena() const { return *m_arena; }
+
+    T* allocate(size_t count)
+    {
+        void* memory = (count <= static_cast<size_t>(-1) / sizeof(T)) ? m_arena->allocate(count * sizeof(T), std::max(alignof(T), static_cast<size_t>(16))) : nullptr;
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T*, size_t) noexcept
+    {
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return m_arena == &other.arena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return m_arena != &other.arena(); }
+
+private:
+    FrameArena* m_arena;
+};
+
+// Pool of fixed-size, aligned slots for objects of type T, e.g. BVH or hierarchy nodes that are created & destroyed one
+// at a time. Memory is allocated in blocks of slotsPerBlock slots which are kept until the pool is destroyed, so once
+// warmed up, creating and destroying objects is allocation-free (a free list push/pop). Objects still alive when the
+// pool is destroyed are not destructed. Not thread-safe.
+template<typename T, size_t Alignment = alignof(T)>
+class PoolAllocator {
+public:
+    explicit PoolAllocator(size_t slotsPerBlock = 256)
+        : m_slotsPerBlock(std::max(slotsPerBlock, static_cast<size_t>(1)))
+    {
+    }
+
+    ~PoolAllocator()
+    {
+        for (void* block : m_blocks) {
+            alignedFree(block);
+        }
+    }
+
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    size_t liveCount() const { return m_liveCount; }
+    size_t capacity() const { return m_blocks.size() * m_slotsPerBlock; }
+
+    // Uninitialized storage for one T
+    void* allocate()
+    {
+        if (m_freeList == nullptr) {
+            addBlock();
+        }
+        FreeSlot* slot = m_freeList;
+        m_freeList = slot->next;
+        m_liveCount += 1;
+        return slot;
+    }
+
+    void deallocate(void* memory)
+    {
+        if (memory == nullptr) {
+            return;
+        }
+        MOOS_ASSERT(m_liveCount > 0);
+        FreeSlot* slot = static_cast<FreeSlot*>(memory);
+        slot->next = m_freeList;
+        m_freeList = slot;
+        m_liveCount -= 1;
+    }
+
+    template<typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        if (object != nullptr) {
+            object->~T();
+            deallocate(object);
+        }
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    static constexpr size_t SlotAlignment = std::max({ Alignment, alignof(T), alignof(FreeSlot) });
+    static constexpr size_t SlotSize = detail::alignUp(std::max(sizeof(T), sizeof(FreeSlot)), SlotAlignment);
+
+    void addBlock()
+    {
+        u8* block = static_cast<u8*>(alignedAlloc(SlotSize * m_slotsPerBlock, SlotAlignment));
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        m_blocks.push_back(block);
+
+        // Link the slots in address order, so consecutive allocations are contiguous
+        for (size_t i = m_slotsPerBlock; i-- > 0;) {
+            FreeSlot* slot = reinterpret_cast<FreeSlot*>(block + i * SlotSize);
+            slot->next = m_freeList;
+            m_freeList = slot;
+        }
+    }
+
+    size_t m_slotsPerBlock;
+    std::vector<void*> m_blocks {};
+    FreeSlot* m_freeList { nullptr };
+    size_t m_liveCount { 0 };
+};
+
+} // namespace moos
@@ -0,0 +1,252 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "core.h"
+#include "quatcompression.h"
+#include "quaternion.h"
+#include "vector.h"
+
+#include <algorithm> // for std::upper_bound
+#include <vector> // for std::vector
+
+namespace moos {
+
+// Compressed keyframe formats
+
+// Rotation keys are stored in the 48-bit smallest three format, see quatcompression.h
+using CompressedQuat = QuatSmallestThree48;
+
+inline CompressedQuat compressQuat(const fquat& q)
+{
+    return compressQuatSmallestThree48(q);
+}
+
+// The range of values that a set of quantized vectors can take, e.g. all translation keys of one joint track
+struct QuantizationRange {
+    fvec3 min;
+    fvec3 extent;
+};
+
+inline QuantizationRange quantizationRangeForPoints(const fvec3* points, size_t count)
+{
+    MOOS_ASSERT(count > 0);
+    fvec3 minPoint = points[0];
+    fvec3 maxPoint = points[0];
+    for (size_t i = 1; i < count; ++i) {
+        minPoint = min(minPoint, points[i]);
+        maxPoint = max(maxPoint, points[i]);
+    }
+    return { minPoint, maxPoint - minPoint };
+}
+
+// A vector stored as 16-bit fixed-point values in some QuantizationRange
+struct CompressedVec3 {
+    u16 data[3];
+};
+
+inline CompressedVec3 compressVec3(const fvec3& v, const QuantizationRange& range)
+{
+    CompressedVec3 c;
+    for (int i = 0; i < 3; ++i) {
+        f32 normalized = (range.extent[i] > 0.0f) ? (v[i] - range.min[i]) / range.extent[i] : 0.0f;
+        c.data[i] = static_cast<u16>(std::round(clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+    }
+    return c;
+}
+
+inline fvec3 decompressVec3(const CompressedVec3& c, const QuantizationRange& range)
+{
+    constexpr f32 scale = 1.0f / 65535.0f;
+    fvec3 normalized = { static_cast<f32>(c.data[0]), static_cast<f32>(c.data[1]), static_cast<f32>(c.data[2]) };
+    return range.min + range.extent * (normalized * scale);
+}
+
+namespace detail {
+
+    // Decompresses all pairs of keys a[i] & b[i] and interpolates between them with nlerp using the factor t[i]
+    inline void decompressAndBlendQuats(const CompressedQuat* a, const CompressedQuat* b, const f32* t, fquat* result, size_t count)
+    {
+        size_t i = 0;
+
+#ifdef MOOS_SSE
+        for (; i + 4 <= count; i += 4) {
+            __m128 ax, ay, az, aw;
+            __m128 bx, by, bz, bw;
+            decodeSmallestThree48x4(a + i, ax, ay, az, aw);
+            decodeSmallestThree48x4(b + i, bx, by, bz, bw);
+
+            __m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+            __m128 sign = _mm_and_ps(cosTheta, _mm_set1_ps(-0.0f));
+            __m128 tb = _mm_loadu_ps(t + i);
+            __m128 ta = _mm_sub_ps(_mm_set1_ps(1.0f), tb);
+            tb = _mm_xor_ps(tb, sign);
+
+            __m128 x = _mm_add_ps(_mm_mul_ps(ta, ax), _mm_mul_ps(tb, bx));
+            __m128 y = _mm_add_ps(_mm_mul_ps(ta, ay), _mm_mul_ps(tb, by));
+            __m128 z = _mm_add_ps(_mm_mul_ps(ta, az), _mm_mul_ps(tb, bz));
+            __m128 w = _mm_add_ps(_mm_mul_ps(ta, aw), _mm_mul_ps(tb, bw));
+
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+            __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+            x = _mm_mul_ps(x, invLength);
+            y = _mm_mul_ps(y, invLength);
+            z = _mm_mul_ps(z, invLength);
+            w = _mm_mul_ps(w, invLength);
+
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            result[i + 0] = fquat(x);
+            result[i + 1] = fquat(y);
+            result[i + 2] = fquat(z);
+            result[i + 3] = fquat(w);
+        }
+#endif
+
+        for (; i < count; ++i) {
+            result[i] = nlerp(decompressQuat(a[i]), decompressQuat(b[i]), t[i]);
+        }
+    }
+
+} // namespace detail
+
+// Playback state for sampling an AnimationClip. For sequential playback (i.e. increasing time) the cached key
+// indices mean that finding the keys to interpolate between is O(1) per joint instead of a search.
+struct AnimationCursor {
+    std::vector<u32> keyIndices;
+
+    // (scratch memory for sampling, kept here to avoid allocations on every sample)
+    std::vector<CompressedQuat> rotationKeysA;
+    std::vector<CompressedQuat> rotationKeysB;
+    std::vector<f32> interpolationFactors;
+};
+
+class AnimationClip {
+public:
+    // Adds a track for the next joint (i.e., the joint index is the number of previously added tracks) and returns
+    // its joint index. The key times must be sorted and there must be at least one key.
+    size_t addJointTrack(const f32* keyTimes, const fquat* rotations, const fvec3* translations, size_t keyCount)
+    {
+        MOOS_ASSERT(keyCount > 0);
+
+        Track track;
+        track.firstKey = static_cast<u32>(m_keyTimes.size());
+        track.keyCount = static_cast<u32>(keyCount);
+        track.translationRange = quantizationRangeForPoints(translations, keyCount);
+
+        for (size_t i = 0; i < keyCount; ++i) {
+            MOOS_ASSERT(i == 0 || keyTimes[i] >= keyTimes[i - 1]);
+            m_keyTimes.push_back(keyTimes[i]);
+            m_rotations.push_back(compressQuat(rotations[i]));
+            m_translations.push_back(compressVec3(translations[i], track.translationRange));
+        }
+
+        m_duration = std::max(m_duration, keyTimes[keyCount - 1]);
+        m_tracks.push_back(track);
+
+        return m_tracks.size() - 1;
+    }
+
+    size_t jointCount() const
+    {
+        return m_tracks.size();
+    }
+
+    f32 duration() const
+    {
+        return m_duration;
+    }
+
+    // Samples the local rotation & translation of all joints at the given time (clamped to the clip), writing
+    // jointCount() values to the output arrays. For looping, wrap the time before calling this.
+    void sample(f32 time, AnimationCursor& cursor, fquat* rotations, fvec3* translations) const
+    {
+        size_t count = jointCount();
+        if (cursor.keyIndices.size() != count) {
+            cursor.keyIndices.assign(count, 0u);
+            cursor.rotationKeysA.resize(count);
+            cursor.rotationKeysB.resize(count);
+            cursor.interpolationFactors.resize(count);
+        }
+
+        for (size_t joint = 0; joint < count; ++joint) {
+            const Track& track = m_tracks[joint];
+            const f32* times = m_keyTimes.data() + track.firstKey;
+
+            u32 key = findKey(times, track.keyCount, time, cursor.keyIndices[joint]);
+            cursor.keyIndices[joint] = key;
+
+            u32 nextKey = std::min(key + 1, track.keyCount - 1);
+            f32 keyDuration = times[nextKey] - times[key];
+            f32 t = (keyDuration > 0.0f) ? clamp((time - times[key]) / keyDuration, 0.0f, 1.0f) : 0.0f;
+
+            cursor.rotationKeysA[joint] = m_rotations[track.firstKey + key];
+            cursor.rotationKeysB[joint] = m_rotations[track.firstKey + nextKey];
+            cursor.interpolationFactors[joint] = t;
+
+            fvec3 translationA = decompressVec3(m_translations[track.firstKey + key], track.translationRange);
+            fvec3 translationB = decompressVec3(m_translations[track.firstKey + nextKey], track.translationRange);
+            translations[joint] = lerp(translationA, translationB, t);
+        }
+
+        detail::decompressAndBlendQuats(cursor.rotationKeysA.data(), cursor.rotationKeysB.data(),
+                                        cursor.interpolationFactors.data(), rotations, count);
+    }
+
+private:
+    static u32 findKey(const f32* times, u32 keyCount, f32 time, u32 cachedKey)
+    {
+        // Returns the last key with a time <= the given time (or the first key if none are)
+
+        if (cachedKey < keyCount && times[cachedKey] <= time) {
+            // Sequential playback: step forward from the previous key, which usually is zero or one steps
+            u32 key = cachedKey;
+            while (key + 1 < keyCount && times[key + 1] <= time) {
+                key += 1;
+            }
+            return key;
+        }
+
+        const f32* upper = std::upper_bound(times, times + keyCount, time);
+        return (upper == times) ? 0u : static_cast<u32>(upper - times - 1);
+    }
+
+    struct Track {
+        u32 firstKey;
+        u32 keyCount;
+        QuantizationRange translationRange;
+    };
+
+    std::vector<Track> m_tracks {};
+
+    // (keys for all tracks, stored contiguously per track)
+    std::vector<f32> m_keyTimes {};
+    std::vector<CompressedQuat> m_rotations {};
+    std::vector<CompressedVec3> m_translations {};
+
+    f32 m_duration { 0.0f };
+};
+
+} // namespace moos
@@ -0,0 +1,156 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "core.h"
+#include "matrix.h"
+#include "transform.h"
+#include "vector.h"
+
+namespace moos {
+
+// A camera which caches its view & projection matrices, the view-projection matrix, and their inverses. The derived
+// matrices are only recomputed when requested after the view or projection has changed, and the inverses use the
+// closed-form versions (see inverseRigid & inversePerspectiveProjection), so updating many cameras per frame is cheap
+// even if only some of the matrices are used. Reading a dirty matrix updates the cache, so it's not thread-safe.
+
+template<typename T, typename _ = void>
+class tcamera {
+};
+
+template<typename T>
+class tcamera<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
+public:
+    // The view matrix must be a rigid transform, e.g. as created by lookAt
+    void setView(const tmat4<T>& view)
+    {
+        m_view = view;
+        m_dirtyFlags |= InverseViewDirty | ViewProjectionDirty | InverseViewProjectionDirty;
+    }
+
+    void lookAt(const tvec3<T>& eye, const tvec3<T>& target, const tvec3<T>& up = tvec3<T>(0, 1, 0))
+    {
+        setView(moos::lookAt(eye, target, up));
+    }
+
+    // The projection matrix must be one of the perspective projections in transform.h
+    void setPerspectiveProjection(const tmat4<T>& projection)
+    {
+        m_projection = projection;
+        m_perspective = true;
+        m_dirtyFlags |= InverseProjectionDirty | ViewProjectionDirty | InverseViewProjectionDirty;
+    }
+
+    // The projection matrix must be one of the orthographic projections in transform.h
+    void setOrthographicProjection(const tmat4<T>& projection)
+    {
+        m_projection = projection;
+        m_perspective = false;
+        m_dirtyFlags |= InverseProjectionDirty | ViewProjectionDirty | InverseViewProjectionDirty;
+    }
+
+    bool isPerspective() const
+    {
+        return m_perspective;
+    }
+
+    const tmat4<T>& view() const
+    {
+        return m_view;
+    }
+
+    const tmat4<T>& projection() const
+    {
+        return m_projection;
+    }
+
+    const tmat4<T>& viewProjection() const
+    {
+        if (m_dirtyFlags & ViewProjectionDirty) {
+            m_viewProjection = m_projection * m_view;
+            m_dirtyFlags &= ~ViewProjectionDirty;
+        }
+        return m_viewProjection;
+    }
+
+    const tmat4<T>& inverseView() const
+    {
+        if (m_dirtyFlags & InverseViewDirty) {
+            m_inverseView = inverseRigid(m_view);
+            m_dirtyFlags &= ~InverseViewDirty;
+        }
+        return m_inverseView;
+    }
+
+    const tmat4<T>& inverseProjection() const
+    {
+        if (m_dirtyFlags & InverseProjectionDirty) {
+            m_inverseProjection = m_perspective
+                ? inversePerspectiveProjection(m_projection)
+                : inverseOrthographicProjection(m_projection);
+            m_dirtyFlags &= ~InverseProjectionDirty;
+        }
+        return m_inverseProjection;
+    }
+
+    const tmat4<T>& inverseViewProjection() const
+    {
+        if (m_dirtyFlags & InverseViewProjectionDirty) {
+            m_inverseViewProjection = inverseView() * inverseProjection();
+            m_dirtyFlags &= ~InverseViewProjectionDirty;
+        }
+        return m_inverseViewProjection;
+    }
+
+    tvec3<T> position() const
+    {
+        return inverseView().w.xyz();
+    }
+
+private:
+    enum DirtyFlags : u32 {
+        InverseViewDirty = 1u << 0,
+        InverseProjectionDirty = 1u << 1,
+        ViewProjectionDirty = 1u << 2,
+        InverseViewProjectionDirty = 1u << 3,
+    };
+
+    tmat4<T> m_view {};
+    tmat4<T> m_projection {};
+    bool m_perspective { false };
+
+    mutable tmat4<T> m_viewProjection {};
+    mutable tmat4<T> m_inverseView {};
+    mutable tmat4<T> m_inverseProjection {};
+    mutable tmat4<T> m_inverseViewProjection {};
+    mutable u32 m_dirtyFlags { 0u };
+};
+
+using camera = tcamera<Float>;
+using fcamera = tcamera<f32>;
+using dcamera = tcamera<f64>;
+
+} // namespace moos
@@ -0,0 +1,168 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "core.h"
+#include "matrix.h"
+#include "vector.h"
+
+namespace moos {
+
+// Camera-relative rendering for large worlds: positions & world matrices are kept in f64, and are made relative to a
+// camera origin (usually the camera position) in f64 before converting to f32 once, so that everything on the hot path
+// (culling, skinning, the GPU) can stay in f32 without jitter far away from the world origin. The view matrix must then
+// be made relative to the same origin, see cameraRelativeViewMatrix. For precision-critical math on values which are
+// still large after this, see df64.
+
+namespace detail {
+
+    inline fmat4 toFloatMatrix(const dmat4& m, const dvec4& translation)
+    {
+        return { { static_cast<f32>(m.x.x), static_cast<f32>(m.x.y), static_cast<f32>(m.x.z), static_cast<f32>(m.x.w) },
+                 { static_cast<f32>(m.y.x), static_cast<f32>(m.y.y), static_cast<f32>(m.y.z), static_cast<f32>(m.y.w) },
+                 { static_cast<f32>(m.z.x), static_cast<f32>(m.z.y), static_cast<f32>(m.z.z), static_cast<f32>(m.z.w) },
+                 { static_cast<f32>(translation.x), static_cast<f32>(translation.y), static_cast<f32>(translation.z), static_cast<f32>(translation.w) } };
+    }
+
+} // namespace detail
+
+// A world matrix relative to the origin, i.e., translate(-origin) * world
+inline fmat4 cameraRelativeMatrix(const dmat4& world, const dvec3& origin)
+{
+    dvec4 translation = { world.w.xyz() - origin, world.w.w };
+    return detail::toFloatMatrix(world, translation);
+}
+
+// A view matrix for camera-relative positions, i.e., view * translate(origin), with the product computed in f64
+inline fmat4 cameraRelativeViewMatrix(const dmat4& view, const dvec3& origin)
+{
+    dvec4 translation = view.w;
+    translation = { translation.x + view.x.x * origin.x + view.y.x * origin.y + view.z.x * origin.z,
+                    translation.y + view.x.y * origin.x + view.y.y * origin.y + view.z.y * origin.z,
+                    translation.z + view.x.z * origin.x + view.y.z * origin.y + view.z.z * origin.z,
+                    translation.w + view.x.w * origin.x + view.y.w * origin.y + view.z.w * origin.z };
+    return detail::toFloatMatrix(view, translation);
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    inline __m128 loadDoubleVec4AsFloat(const f64* v)
+    {
+        return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(v)), _mm_cvtpd_ps(_mm_loadu_pd(v + 2)));
+    }
+
+    // The columns of cameraRelativeMatrix(world, origin), where origin is (x, y) & (z, 0) as two registers
+    inline void cameraRelativeColumns(const dmat4& world, __m128d originXY, __m128d originZ0, __m128 columns[4])
+    {
+        const f64* src = value_ptr(world);
+        columns[0] = loadDoubleVec4AsFloat(src + 0);
+        columns[1] = loadDoubleVec4AsFloat(src + 4);
+        columns[2] = loadDoubleVec4AsFloat(src + 8);
+        __m128d xy = _mm_sub_pd(_mm_loadu_pd(src + 12), originXY);
+        __m128d zw = _mm_sub_pd(_mm_loadu_pd(src + 14), originZ0);
+        columns[3] = _mm_movelh_ps(_mm_cvtpd_ps(xy), _mm_cvtpd_ps(zw));
+    }
+
+} // namespace detail
+
+#endif
+
+// Batch versions of cameraRelativeMatrix, either as full matrices or with the tmat3x4 layout of quatToMatrixBatch, i.e.,
+// the rows of the affine transform
+inline void cameraRelativeMatricesBatch(const dmat4* worlds, const dvec3& origin, fmat4* result, size_t count)
+{
+#ifdef MOOS_SSE
+    __m128d originXY = _mm_setr_pd(origin.x, origin.y);
+    __m128d originZ0 = _mm_setr_pd(origin.z, 0.0);
+    for (size_t i = 0; i < count; ++i) {
+        __m128 columns[4];
+        detail::cameraRelativeColumns(worlds[i], originXY, originZ0, columns);
+        f32* dst = value_ptr(result[i]);
+        _mm_storeu_ps(dst + 0, columns[0]);
+        _mm_storeu_ps(dst + 4, columns[1]);
+        _mm_storeu_ps(dst + 8, columns[2]);
+        _mm_storeu_ps(dst + 12, columns[3]);
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = cameraRelativeMatrix(worlds[i], origin);
+    }
+#endif
+}
+
+inline void cameraRelativeMatricesBatch(const dmat4* worlds, const dvec3& origin, fmat3x4* result, size_t count)
+{
+#ifdef MOOS_SSE
+    __m128d originXY = _mm_setr_pd(origin.x, origin.y);
+    __m128d originZ0 = _mm_setr_pd(origin.z, 0.0);
+    for (size_t i = 0; i < count; ++i) {
+        __m128 columns[4];
+        detail::cameraRelativeColumns(worlds[i], originXY, originZ0, columns);
+        _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+        f32* dst = value_ptr(result[i]);
+        _mm_storeu_ps(dst + 0, columns[0]);
+        _mm_storeu_ps(dst + 4, columns[1]);
+        _mm_storeu_ps(dst + 8, columns[2]);
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        fmat4 m = transpose(cameraRelativeMatrix(worlds[i], origin));
+        result[i].x = m.x;
+        result[i].y = m.y;
+        result[i].z = m.z;
+    }
+#endif
+}
+
+// Makes count positions relative to the origin, i.e., result[i] = positions[i] - origin
+inline void cameraRelativePositionsBatch(const dvec3* positions, const dvec3& origin, fvec3* result, size_t count)
+{
+    size_t i = 0;
+
+#ifdef MOOS_SSE
+    // (two positions are three registers of two doubles, with the origin repeating as xy, zx, yz)
+    __m128d originXY = _mm_setr_pd(origin.x, origin.y);
+    __m128d originZX = _mm_setr_pd(origin.z, origin.x);
+    __m128d originYZ = _mm_setr_pd(origin.y, origin.z);
+    for (; i + 2 <= count; i += 2) {
+        const f64* src = &positions[i].x;
+        __m128 a = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src + 0), originXY));
+        __m128 b = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src + 2), originZX));
+        __m128 c = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src + 4), originYZ));
+        f32* dst = &result[i].x;
+        _mm_storeu_ps(dst, _mm_movelh_ps(a, b));
+        _mm_storel_pi(reinterpret_cast<__m64*>(dst + 4), c);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        dvec3 relative = positions[i] - origin;
+        result[i] = { static_cast<f32>(relative.x), static_cast<f32>(relative.y), static_cast<f32>(relative.z) };
+    }
+}
+
+} // namespace moos
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "matrix.h"
+#include "transform.h"
 
 namespace moos {
 
@@ -66,6 +67,38 @@ Float blackBodyRadiation(Float temperature, Float wavelengthInNanometer)
 
 namespace colorspace {
 
+    namespace detail {
+
+        // For f32 colors these use the fast approximations (see core.h), since their errors of a few ULP are far below what
+        // matters for color values, while they are considerably faster than std::exp and std::pow.
+
+        inline Float exp(Float x)
+        {
+#ifdef MOOS_USE_DOUBLE_BY_DEFAULT
+            return std::exp(x);
+#else
+            return fast::exp(x);
+#endif
+        }
+
+        inline Float pow(Float x, Float y)
+        {
+#ifdef MOOS_USE_DOUBLE_BY_DEFAULT
+            return std::pow(x, y);
+#else
+            return fast::pow(x, y);
+#endif
+        }
+
+    } // namespace detail
+
+    // Converts count colors with a color space conversion matrix, e.g. sRGB_from_XYZ below. The result may alias the
+    // colors. For f32 colors this is dispatched to the best kernel for the CPU, see cpu.h.
+    inline void convertBatch(const mat3& conversion, const vec3* colors, vec3* result, size_t count)
+    {
+        transformPointsBatch(mat4(conversion), colors, result, count);
+    }
+
     namespace XYZ {
 
         // Assuming 1931 standard observer
@@ -77,21 +110,21 @@ namespace colorspace {
             Float t1 = (wave - 442.0) * ((wave < 442.0) ? 0.0624 : 0.0374);
             Float t2 = (wave - 599.8) * ((wave < 599.8) ? 0.0264 : 0.0323);
             Float t3 = (wave - 501.1) * ((wave < 501.1) ? 0.0490 : 0.0382);
-            return 0.362 * std::exp(-0.5 * t1 * t1) + 1.056 * std::exp(-0.5 * t2 * t2) - 0.065 * std::exp(-0.5 * t3 * t3);
+            return 0.362 * detail::exp(-0.5 * t1 * t1) + 1.056 * detail::exp(-0.5 * t2 * t2) - 0.065 * detail::exp(-0.5 * t3 * t3);
         }
 
         Float yBarFit(Float wave)
         {
             Float t1 = (wave - 568.8) * ((wave < 568.8) ? 0.0213 : 0.0247);
             Float t2 = (wave - 530.9) * ((wave < 530.9) ? 0.0613 : 0.0322);
-            return 0.821 * std::exp(-0.5 * t1 * t1) + 0.286 * std::exp(-0.5 * t2 * t2);
+            return 0.821 * detail::exp(-0.5 * t1 * t1) + 0.286 * detail::exp(-0.5 * t2 * t2);
         }
 
         Float zBarFit(Float wave)
         {
             Float t1 = (wave - 437.0) * ((wave < 437.0) ? 0.0845 : 0.0278);
             Float t2 = (wave - 459.0) * ((wave < 459.0) ? 0.0385 : 0.0725);
-            return 1.217 * std::exp(-0.5 * t1 * t1) + 0.681 * std::exp(-0.5 * t2 * t2);
+            return 1.217 * detail::exp(-0.5 * t1 * t1) + 0.681 * detail::exp(-0.5 * t2 * t2);
         }
 
         Float photometricCurveFit(Float wave)
@@ -147,12 +180,12 @@ namespace colorspace {
 
     } // namespace XYZ
 
-    const mat3 XYZ_from_sRGB = mat3(
+    constexpr mat3 XYZ_from_sRGB = mat3(
         { 0.4123865632529917, 0.21263682167732384, 0.019330620152483987 },
         { 0.35759149092062537, 0.7151829818412507, 0.11919716364020845 },
         { 0.18045049120356368, 0.07218019648142547, 0.9503725870054354 });
 
-    const mat3 sRGB_from_XYZ = mat3(
+    constexpr mat3 sRGB_from_XYZ = mat3(
         { 3.2410032329763587, -0.9692242522025166, 0.055639419851975444 },
         { -1.5373989694887855, 1.875929983695176, -0.20401120612390997 },
         { -0.4986158819963629, 0.041554226340084724, 1.0571489771875335 });
@@ -161,14 +194,14 @@ namespace colorspace {
 
         // Primaries & white point from https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkColorSpaceKHR.html
 
-        const vec2 primaries[3] = {
+        constexpr vec2 primaries[3] = {
             vec2(0.64, 0.33),
             vec2(0.30, 0.60),
             vec2(0.15, 0.06)
         };
 
-        const vec2 whitePoint = vec2(0.3127, 0.3290);
-        const Float whitePointIlluminant = standardIlluminant::D65;
+        constexpr vec2 whitePoint = vec2(0.3127, 0.3290);
+        constexpr Float whitePointIlluminant = standardIlluminant::D65;
 
         Float luminance(const vec3& color)
         {
@@ -181,7 +214,7 @@ namespace colorspace {
             // (i.e. convert from linear sRGB to gamma-encoded sRGB)
             return (linear < 0.0031308)
                 ? 12.92 * linear
-                : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                : 1.055 * detail::pow(linear, 1.0 / 2.4) - 0.055;
         }
 
         Float gammaDecode(Float encoded)
@@ -189,17 +222,34 @@ namespace colorspace {
             // (i.e. convert from gamma-encoded sRGB to linear sRGB)
             return (encoded < 0.04045)
                 ? encoded / 12.92
-                : std::pow((encoded + 0.055) / 1.055, 2.4);
+                : detail::pow((encoded + 0.055) / 1.055, 2.4);
         }
 
         vec3 gammaEncode(const vec3& linear)
         {
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+            // (all three channels at once)
+            __m128 x = simd::load(linear);
+            __m128 curve = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.055f), fast::pow(x, _mm_set1_ps(1.0f / 2.4f))), _mm_set1_ps(0.055f));
+            __m128 isLinear = _mm_cmplt_ps(x, _mm_set1_ps(0.0031308f));
+            __m128 encoded = _mm_or_ps(_mm_and_ps(isLinear, _mm_mul_ps(x, _mm_set1_ps(12.92f))), _mm_andnot_ps(isLinear, curve));
+            return simd::storeVec3(encoded);
+#else
             return { gammaEncode(linear.x), gammaEncode(linear.y), gammaEncode(linear.z) };
+#endif
         }
 
         vec3 gammaDecode(const vec3& encoded)
         {
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+            __m128 x = simd::load(encoded);
+            __m128 base = _mm_div_ps(_mm_add_ps(x, _mm_set1_ps(0.055f)), _mm_set1_ps(1.055f));
+            __m128 isLinear = _mm_cmplt_ps(x, _mm_set1_ps(0.04045f));
+            __m128 linear = _mm_or_ps(_mm_and_ps(isLinear, _mm_div_ps(x, _mm_set1_ps(12.92f))), _mm_andnot_ps(isLinear, fast::pow(base, _mm_set1_ps(2.4f))));
+            return simd::storeVec3(linear);
+#else
             return { gammaDecode(encoded.x), gammaDecode(encoded.y), gammaDecode(encoded.z) };
+#endif
         }
 
         vec3 fromBlackBodyTemperature(Float temperature, int numSteps = 100)
@@ -211,12 +261,12 @@ namespace colorspace {
 
     } // namespace sRGB
 
-    const mat3 XYZ_from_Rec2020 = mat3(
+    constexpr mat3 XYZ_from_Rec2020 = mat3(
         { 0.636953507, 0.262698339, 0.0280731358 },
         { 0.144619185, 0.678008766, 0.0280731358 },
         { 0.168855854, 0.0592928953, 1.06082723 });
 
-    const mat3 Rec2020_from_XYZ = mat3(
+    constexpr mat3 Rec2020_from_XYZ = mat3(
         { 1.71666343, -0.66667384, 0.01764248 },
         { -0.35567332, 1.61645574, -0.04277698 },
         { -0.25336809, 0.0157683, 0.94224328 });
@@ -225,14 +275,14 @@ namespace colorspace {
 
         // Primaries & white point from https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkColorSpaceKHR.html
 
-        const vec2 primaries[3] = {
+        constexpr vec2 primaries[3] = {
             vec2(0.708, 0.292),
             vec2(0.17, 0.797),
             vec2(0.131, 0.046)
         };
 
-        const vec2 whitePoint = vec2(0.3127, 0.3290);
-        const Float whitePointIlluminant = standardIlluminant::D65;
+        constexpr vec2 whitePoint = vec2(0.3127, 0.3290);
+        constexpr Float whitePointIlluminant = standardIlluminant::D65;
 
         Float encodePQfromLinear(Float x, Float maxNits)
         {
@@ -275,13 +325,13 @@ namespace colorspace {
         // credit for coming up with this fit and implementing it. Buy him a beer next time you see him. :)"
 
         // sRGB => XYZ => D65_2_D60 => AP1 => RRT_SAT
-        const mat3 inputMatrix = mat3(
+        constexpr mat3 inputMatrix = mat3(
             { 0.59719, 0.07600, 0.02840 },
             { 0.35458, 0.90834, 0.13383 },
             { 0.04823, 0.01566, 0.83777 });
 
         // ODT_SAT => XYZ => D60_2_D65 => sRGB
-        const mat3 outputMatrix = mat3(
+        constexpr mat3 outputMatrix = mat3(
             { 1.60475, -0.10208, -0.00327 },
             { -0.53108, 1.10813, -0.07276 },
             { -0.07367, -0.00605, 1.07602 });
@@ -28,10 +28,17 @@
 #include <cassert> // for the assert macro
 #include <cmath> // for basic math functions
 #include <cstdint> // for integer definitions
+#include <cstring> // for std::memcpy
+#include <limits> // for std::numeric_limits etc.
 #include <type_traits> // for std::enable_if etc.
+#include <utility> // for std::declval
 
 #ifndef MOOS_NO_INTRINSICS
+#if defined(_MSC_VER)
 #include <intrin.h>
+#elif defined(__SSE__)
+#include <immintrin.h>
+#endif
 #endif
 
 namespace moos {
@@ -43,6 +50,40 @@ namespace moos {
 #define MOOS_ASSERT(x) assert(x)
 #endif
 
+// SIMD specializations (e.g. for f32 vectors and quaternions) are used if the target supports SSE2.
+// Define MOOS_NO_INTRINSICS to disable all of them and only use the portable scalar code paths.
+#if !defined(MOOS_NO_INTRINSICS) && defined(__SSE2__)
+#define MOOS_SSE
+#endif
+
+// Some functions (e.g. the fast math approximations) also have versions for eight f32 values at a time if the target
+// supports AVX2. Like the SSE versions, these are disabled by MOOS_NO_INTRINSICS.
+#if defined(MOOS_SSE) && defined(__AVX2__)
+#define MOOS_AVX2
+#endif
+
+// Detects if a constexpr function is being evaluated at compile time, which lets it use a constexpr implementation
+// then but the (usually faster) non-constexpr one at runtime. Not defined if the compiler doesn't support it.
+#if defined(__cpp_lib_is_constant_evaluated)
+#define MOOS_IS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define MOOS_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#elif defined(_MSC_VER) && _MSC_VER >= 1925
+#define MOOS_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#elif defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define MOOS_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+
+// Functions with SIMD code paths can only be constexpr if constant evaluation can be detected, so that they can use
+// their scalar code paths at compile time.
+#ifdef MOOS_IS_CONSTANT_EVALUATED
+#define MOOS_CONSTEXPR_SIMD constexpr
+#else
+#define MOOS_CONSTEXPR_SIMD inline
+#endif
+
 // Some types assume a default float precision or don't allow choosing precision per object,
 // but instead globally. For these cases this option exist. By default a 32-bit float is used.
 #ifdef MOOS_USE_DOUBLE_BY_DEFAULT
@@ -93,6 +134,384 @@ using size_t = std::size_t;
 #define ENABLE_IF_FLOATING_POINT(T) typename = typename std::enable_if<std::is_floating_point<T>::value>::type
 #define ENABLE_IF_INTEGRAL(T) typename = typename std::enable_if<std::is_integral<T>::value>::type
 
+// Returns true if called during constant evaluation (always false if it can't be detected)
+constexpr bool isConstantEvaluated()
+{
+#ifdef MOOS_IS_CONSTANT_EVALUATED
+    return MOOS_IS_CONSTANT_EVALUATED();
+#else
+    return false;
+#endif
+}
+
+// Math functions which can be used in constant expressions, e.g. for computing constant matrices at compile time. At
+// runtime they call the <cmath> functions, so they only differ from those during compilation, where they are evaluated
+// in f64 with a max. error of 3 ULP (for sin, cos & tan for |x| < 1e6, and for pow when |y * ln(x)| < 1, after which
+// its error grows proportionally). Without compiler support for detecting constant evaluation (see
+// MOOS_IS_CONSTANT_EVALUATED) they always call the <cmath> functions.
+
+namespace cx {
+
+    namespace detail {
+
+        constexpr f64 infinity = std::numeric_limits<f64>::infinity();
+        constexpr f64 quietNaN = std::numeric_limits<f64>::quiet_NaN();
+
+        constexpr f64 halfPi = 1.57079632679489655800e+00;
+        constexpr f64 halfPiLow = 6.12323399573676603587e-17;
+        constexpr f64 quarterPi = 7.85398163397448278999e-01;
+        constexpr f64 sqrt2 = 1.41421356237309504880;
+
+        // pi/2 & ln(2) split into parts with trailing zero bits, so that multiplying them with small integers is exact
+        constexpr f64 halfPiPart1 = 1.57079632673412561417e+00;
+        constexpr f64 halfPiPart2 = 6.07710050630396597660e-11;
+        constexpr f64 halfPiPart3 = 2.02226624871116645580e-21;
+        constexpr f64 ln2Part1 = 6.93147180369123816490e-01;
+        constexpr f64 ln2Part2 = 1.90821492927058770002e-10;
+
+        constexpr bool isNaN(f64 x)
+        {
+            return x != x;
+        }
+
+        constexpr f64 abs(f64 x)
+        {
+            return (x < 0.0) ? -x : x + 0.0; // (+ 0.0 to turn -0.0 into 0.0)
+        }
+
+        constexpr f64 floor(f64 x)
+        {
+            // (all f64 values at least this large are integers)
+            if (isNaN(x) || abs(x) >= 4503599627370496.0) {
+                return x;
+            }
+            f64 truncated = static_cast<f64>(static_cast<i64>(x));
+            if (truncated == x) {
+                return x;
+            }
+            return (truncated > x) ? truncated - 1.0 : truncated;
+        }
+
+        constexpr f64 scaleByPowerOfTwo(f64 x, int n)
+        {
+            for (; n > 0; --n) {
+                x *= 2.0;
+            }
+            for (; n < 0; ++n) {
+                x *= 0.5;
+            }
+            return x;
+        }
+
+        // Returns a * b - product exactly, where product is the rounded a * b (Dekker's algorithm)
+        constexpr f64 productError(f64 a, f64 b, f64 product)
+        {
+            constexpr f64 splitter = 134217729.0; // (2^27 + 1)
+            f64 aScaled = splitter * a;
+            f64 aHigh = aScaled - (aScaled - a);
+            f64 aLow = a - aHigh;
+            f64 bScaled = splitter * b;
+            f64 bHigh = bScaled - (bScaled - b);
+            f64 bLow = b - bHigh;
+            return ((aHigh * bHigh - product) + aHigh * bLow + aLow * bHigh) + aLow * bLow;
+        }
+
+        constexpr f64 sqrt(f64 x)
+        {
+            if (isNaN(x) || x < 0.0) {
+                return quietNaN;
+            }
+            if (x == 0.0 || x == infinity) {
+                return x;
+            }
+
+            // Newton-Raphson iteration, which decreases monotonically from a starting point above the root, so stop
+            // as soon as it doesn't decrease anymore. The last step is then repeated with the exact residual.
+            f64 root = (x > 1.0) ? x : 1.0;
+            while (true) {
+                f64 next = 0.5 * (root + x / root);
+                if (!(next < root)) {
+                    break;
+                }
+                root = next;
+            }
+            f64 square = root * root;
+            f64 residual = (x - square) - productError(root, root, square);
+            return root + residual / (2.0 * root);
+        }
+
+        constexpr f64 exp(f64 x)
+        {
+            if (isNaN(x)) {
+                return x;
+            }
+            if (x > 709.8) {
+                return infinity;
+            }
+            if (x < -745.2) {
+                return 0.0;
+            }
+
+            // e^x = 2^k * e^r with |r| <= ln(2)/2, where e^r is evaluated with its Taylor series
+            f64 k = floor(x / (ln2Part1 + ln2Part2) + 0.5);
+            f64 r = (x - k * ln2Part1) - k * ln2Part2;
+            f64 sum = 1.0;
+            for (int n = 20; n >= 1; --n) {
+                sum = 1.0 + r / n * sum;
+            }
+            return scaleByPowerOfTwo(sum, static_cast<int>(k));
+        }
+
+        constexpr f64 log(f64 x)
+        {
+            if (isNaN(x) || x < 0.0) {
+                return quietNaN;
+            }
+            if (x == 0.0) {
+                return -infinity;
+            }
+            if (x == infinity) {
+                return x;
+            }
+
+            // x = 2^k * m with m in [sqrt(1/2), sqrt(2)), where ln(m) = 2 * atanh(s) with s = (m - 1) / (m + 1) is
+            // evaluated with its Taylor series
+            int k = 0;
+            f64 m = x;
+            for (; m >= sqrt2; m *= 0.5) {
+                ++k;
+            }
+            for (; m < 0.5 * sqrt2; m *= 2.0) {
+                --k;
+            }
+            f64 s = (m - 1.0) / (m + 1.0);
+            f64 s2 = s * s;
+            f64 sum = 0.0;
+            for (int n = 29; n >= 1; n -= 2) {
+                sum = sum * s2 + 1.0 / n;
+            }
+            return k * ln2Part1 + (k * ln2Part2 + 2.0 * s * sum);
+        }
+
+        constexpr f64 pow(f64 x, f64 y)
+        {
+            // Exponentiation by squaring for integral exponents (which also allows negative x), otherwise e^(y * ln(x))
+            if (floor(y) == y && abs(y) < 2147483648.0) {
+                i64 n = static_cast<i64>(abs(y));
+                f64 result = 1.0;
+                for (f64 base = x; n > 0; n /= 2, base *= base) {
+                    if (n % 2 == 1) {
+                        result *= base;
+                    }
+                }
+                return (y < 0.0) ? 1.0 / result : result;
+            }
+            if (x == 0.0) {
+                return (y > 0.0) ? 0.0 : infinity;
+            }
+            return exp(y * log(x));
+        }
+
+        constexpr f64 sinSeries(f64 r)
+        {
+            // (for |r| <= pi/4, where 12 terms are enough)
+            f64 r2 = r * r;
+            f64 sum = 1.0;
+            for (int n = 25; n >= 3; n -= 2) {
+                sum = 1.0 - r2 / (n * (n - 1)) * sum;
+            }
+            return r * sum;
+        }
+
+        constexpr f64 cosSeries(f64 r)
+        {
+            f64 r2 = r * r;
+            f64 sum = 1.0;
+            for (int n = 24; n >= 2; n -= 2) {
+                sum = 1.0 - r2 / (n * (n - 1)) * sum;
+            }
+            return sum;
+        }
+
+        // Returns x minus the closest multiple k of pi/2 (so in the range [-pi/4, pi/4]), and k modulo 4
+        constexpr f64 reduceHalfPi(f64 x, int& quadrant)
+        {
+            f64 k = floor(x / halfPi + 0.5);
+            quadrant = static_cast<int>(k - 4.0 * floor(k / 4.0));
+            return ((x - k * halfPiPart1) - k * halfPiPart2) - k * halfPiPart3;
+        }
+
+        constexpr f64 sin(f64 x)
+        {
+            if (isNaN(x) || abs(x) == infinity) {
+                return quietNaN;
+            }
+            int quadrant = 0;
+            f64 r = reduceHalfPi(x, quadrant);
+            switch (quadrant) {
+            case 0:
+                return sinSeries(r);
+            case 1:
+                return cosSeries(r);
+            case 2:
+                return -sinSeries(r);
+            default:
+                return -cosSeries(r);
+            }
+        }
+
+        constexpr f64 cos(f64 x)
+        {
+            if (isNaN(x) || abs(x) == infinity) {
+                return quietNaN;
+            }
+            int quadrant = 0;
+            f64 r = reduceHalfPi(x, quadrant);
+            switch (quadrant) {
+            case 0:
+                return cosSeries(r);
+            case 1:
+                return -sinSeries(r);
+            case 2:
+                return -cosSeries(r);
+            default:
+                return sinSeries(r);
+            }
+        }
+
+        constexpr f64 tan(f64 x)
+        {
+            int quadrant = 0;
+            f64 r = reduceHalfPi(x, quadrant);
+            return (quadrant % 2 == 0) ? sinSeries(r) / cosSeries(r) : -cosSeries(r) / sinSeries(r);
+        }
+
+        constexpr f64 atan(f64 x)
+        {
+            if (isNaN(x)) {
+                return x;
+            }
+            if (x < 0.0) {
+                return -atan(-x);
+            }
+            if (x > 1.0) {
+                return halfPi - (atan(1.0 / x) - halfPiLow);
+            }
+            if (x > 0.4142135623730950) {
+                // (tan(pi/8), above which it's reduced to the range [-tan(pi/8), 0] using atan(1))
+                return quarterPi + atan((x - 1.0) / (x + 1.0));
+            }
+
+            f64 x2 = x * x;
+            f64 sum = 0.0;
+            for (int n = 30; n >= 0; --n) {
+                sum = 1.0 / (2 * n + 1) - x2 * sum;
+            }
+            return x * sum;
+        }
+
+        constexpr f64 atan2(f64 y, f64 x)
+        {
+            if (isNaN(x) || isNaN(y)) {
+                return quietNaN;
+            }
+            // (signed zeros can't be distinguished in constant expressions, so they are treated as positive)
+            bool negativeX = x < 0.0;
+            f64 sign = (y < 0.0) ? -1.0 : 1.0;
+            if (y == 0.0) {
+                return sign * (negativeX ? 2.0 * halfPi : 0.0);
+            }
+            if (x == 0.0) {
+                return sign * halfPi;
+            }
+            f64 angle = atan(abs(y / x));
+            return sign * (negativeX ? (2.0 * halfPi - angle) + 2.0 * halfPiLow : angle);
+        }
+
+        constexpr f64 asin(f64 x)
+        {
+            if (isNaN(x) || abs(x) > 1.0) {
+                return quietNaN;
+            }
+            return atan2(x, sqrt((1.0 - x) * (1.0 + x)));
+        }
+
+    } // namespace detail
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T abs(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::abs(x)) : std::abs(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T floor(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::floor(x)) : std::floor(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T sqrt(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::sqrt(x)) : std::sqrt(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T exp(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::exp(x)) : std::exp(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T log(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::log(x)) : std::log(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T pow(T x, T y)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::pow(x, y)) : std::pow(x, y);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T sin(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::sin(x)) : std::sin(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T cos(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::cos(x)) : std::cos(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T tan(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::tan(x)) : std::tan(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T atan(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::atan(x)) : std::atan(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T asin(T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::asin(x)) : std::asin(x);
+    }
+
+    template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+    constexpr T atan2(T y, T x)
+    {
+        return isConstantEvaluated() ? static_cast<T>(detail::atan2(y, x)) : std::atan2(y, x);
+    }
+
+} // namespace cx
+
 // Math constants & basic math functions
 
 constexpr Float E = static_cast<Float>(2.718281828459);
@@ -115,7 +534,7 @@ constexpr T lerp(T a, T b, T x)
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
 constexpr T fract(T x)
 {
-    return x - std::floor(x);
+    return x - cx::floor(x);
 }
 
 template<typename T, ENABLE_IF_ARITHMETIC(T)>
@@ -134,4 +553,530 @@ constexpr Float toDegrees(Float radians)
     return radians / PI * static_cast<Float>(180.0);
 }
 
+// Fast approximations of math functions, which (unlike the <cmath> versions) can be evaluated for four values at once
+// with SSE, or eight with AVX2. Each function is written once over a small set of lane-wise primitives, so the scalar,
+// SSE & AVX2 versions give bit-identical results (except rsqrt, see below), and the scalar versions are branch-free and
+// can be auto-vectorized in simple loops. The algorithms & coefficients are from the Cephes math library, as in
+// sse_mathfun by Julien Pommier. Max. errors are in ULP (units in the last place of the correctly rounded f32 result),
+// measured against the f64 <cmath> functions. NaN inputs are not supported, and denormal results are flushed to zero.
+
+namespace fast {
+
+    namespace detail {
+        constexpr f32 fourOverPi = 1.27323954473516f;
+        constexpr f32 sincosMaxArgument = 16777216.0f; // (2^24, beyond which the range reduction breaks down)
+        constexpr f32 piOver4Part1 = 0.78515625f;
+        constexpr f32 piOver4Part2 = 2.4187564849853515625e-4f;
+        constexpr f32 piOver4Part3 = 3.77489497744594108e-8f;
+
+        constexpr f32 sinCoeff0 = -1.9515295891e-4f;
+        constexpr f32 sinCoeff1 = 8.3321608736e-3f;
+        constexpr f32 sinCoeff2 = -1.6666654611e-1f;
+        constexpr f32 cosCoeff0 = 2.443315711809948e-5f;
+        constexpr f32 cosCoeff1 = -1.388731625493765e-3f;
+        constexpr f32 cosCoeff2 = 4.166664568298827e-2f;
+
+        constexpr f32 tan3PiOver8 = 2.414213562373095f;
+        constexpr f32 tanPiOver8 = 0.4142135623730950f;
+        constexpr f32 atanCoeff0 = 8.05374449538e-2f;
+        constexpr f32 atanCoeff1 = -1.38776856032e-1f;
+        constexpr f32 atanCoeff2 = 1.99777106478e-1f;
+        constexpr f32 atanCoeff3 = -3.33329491539e-1f;
+
+        constexpr f32 pi = 3.14159265358979f;
+        constexpr f32 halfPi = 1.57079632679490f;
+        constexpr f32 quarterPi = 0.78539816339745f;
+
+        constexpr f32 log2e = 1.44269504088896341f;
+        constexpr f32 ln2Part1 = 0.693359375f;
+        constexpr f32 ln2Part2 = -2.12194440e-4f;
+        constexpr f32 sqrtHalf = 0.707106781186547524f;
+
+        constexpr f32 expMin = -87.3365447505f; // (ln of the smallest normal f32)
+        constexpr f32 expMax = 89.0f; // (rounds to an exponent of 128, i.e., infinity)
+        constexpr f32 expCoeffs[6] = { 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f };
+        constexpr f32 exp2Coeffs[6] = { 1.535336188319500e-4f, 1.339887440266574e-3f, 9.618437357674640e-3f, 5.550332471162809e-2f, 2.402264791363012e-1f, 6.931472028550421e-1f };
+        constexpr f32 logCoeffs[9] = { 7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f, -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f, 2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f };
+
+        // Lane-wise primitives for a single f32 (with bool masks & i32 integers), and for SSE & AVX2 registers
+
+        template<typename V>
+        V constant(f32 value);
+
+        template<>
+        inline f32 constant<f32>(f32 value) { return value; }
+        inline void setInt(i32& result, i32 value) { result = value; }
+
+        inline f32 asFloat(i32 i)
+        {
+            f32 f;
+            std::memcpy(&f, &i, sizeof(f));
+            return f;
+        }
+
+        inline i32 asInt(f32 f)
+        {
+            i32 i;
+            std::memcpy(&i, &f, sizeof(i));
+            return i;
+        }
+
+        inline f32 add(f32 a, f32 b) { return a + b; }
+        inline f32 sub(f32 a, f32 b) { return a - b; }
+        inline f32 mul(f32 a, f32 b) { return a * b; }
+        inline f32 div(f32 a, f32 b) { return a / b; }
+        inline f32 sqrt(f32 a) { return std::sqrt(a); }
+        inline f32 min(f32 a, f32 b) { return a < b ? a : b; } // (returns b if either is NaN, like _mm_min_ps)
+        inline f32 max(f32 a, f32 b) { return a > b ? a : b; }
+        inline f32 bitAnd(f32 a, f32 b) { return asFloat(asInt(a) & asInt(b)); }
+        inline f32 bitAndNot(f32 a, f32 b) { return asFloat(~asInt(a) & asInt(b)); }
+        inline f32 bitOr(f32 a, f32 b) { return asFloat(asInt(a) | asInt(b)); }
+        inline f32 bitXor(f32 a, f32 b) { return asFloat(asInt(a) ^ asInt(b)); }
+        inline bool less(f32 a, f32 b) { return a < b; }
+        inline bool greater(f32 a, f32 b) { return a > b; }
+        inline bool equal(f32 a, f32 b) { return a == b; }
+        inline bool notGreaterEqual(f32 a, f32 b) { return !(a >= b); }
+        inline bool isNegative(f32 a) { return asInt(a) < 0; }
+        inline bool maskAndNot(bool a, bool b) { return !a && b; }
+        inline f32 select(bool mask, f32 a, f32 b) { return mask ? a : b; }
+        // Out of range values & NaN give INT_MIN (instead of being undefined), like _mm_cvttps_epi32
+        inline i32 truncateToInt(f32 a)
+        {
+            return a > -2147483648.0f && a < 2147483648.0f ? static_cast<i32>(a) : std::numeric_limits<i32>::min();
+        }
+        inline i32 roundToInt(f32 a) { return static_cast<i32>(std::nearbyint(a)); }
+        inline f32 toFloat(i32 i) { return static_cast<f32>(i); }
+        inline i32 iadd(i32 a, i32 b) { return static_cast<i32>(static_cast<u32>(a) + static_cast<u32>(b)); }
+        inline i32 isub(i32 a, i32 b) { return static_cast<i32>(static_cast<u32>(a) - static_cast<u32>(b)); }
+        inline i32 iand(i32 a, i32 b) { return a & b; }
+        inline i32 iandNot(i32 a, i32 b) { return ~a & b; }
+        inline i32 ior(i32 a, i32 b) { return a | b; }
+        inline bool iequal(i32 a, i32 b) { return a == b; }
+        template<int n>
+        inline i32 shiftLeft(i32 a) { return static_cast<i32>(static_cast<u32>(a) << n); }
+        template<int n>
+        inline i32 shiftRight(i32 a) { return static_cast<i32>(static_cast<u32>(a) >> n); }
+        template<int n>
+        inline i32 shiftRightArithmetic(i32 a) { return a >= 0 ? a >> n : ~(~a >> n); }
+
+        inline f32 rsqrtEstimate(f32 a)
+        {
+#ifdef MOOS_SSE
+            return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(a)));
+#else
+            return 1.0f / std::sqrt(a);
+#endif
+        }
+
+#ifdef MOOS_SSE
+
+        template<>
+        inline __m128 constant<__m128>(f32 value) { return _mm_set1_ps(value); }
+        inline void setInt(__m128i& result, i32 value) { result = _mm_set1_epi32(value); }
+
+        inline __m128 asFloat(__m128i i) { return _mm_castsi128_ps(i); }
+        inline __m128i asInt(__m128 f) { return _mm_castps_si128(f); }
+        inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+        inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+        inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+        inline __m128 div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+        inline __m128 sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+        inline __m128 min(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+        inline __m128 max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+        inline __m128 bitAnd(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+        inline __m128 bitAndNot(__m128 a, __m128 b) { return _mm_andnot_ps(a, b); }
+        inline __m128 bitOr(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+        inline __m128 bitXor(__m128 a, __m128 b) { return _mm_xor_ps(a, b); }
+        inline __m128 less(__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }
+        inline __m128 greater(__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); }
+        inline __m128 equal(__m128 a, __m128 b) { return _mm_cmpeq_ps(a, b); }
+        inline __m128 notGreaterEqual(__m128 a, __m128 b) { return _mm_cmpnge_ps(a, b); }
+        inline __m128 isNegative(__m128 a) { return _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(a), 31)); }
+        inline __m128 maskAndNot(__m128 a, __m128 b) { return _mm_andnot_ps(a, b); }
+        inline __m128 select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        inline __m128i truncateToInt(__m128 a) { return _mm_cvttps_epi32(a); }
+        inline __m128i roundToInt(__m128 a) { return _mm_cvtps_epi32(a); }
+        inline __m128 toFloat(__m128i i) { return _mm_cvtepi32_ps(i); }
+        inline __m128i iadd(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+        inline __m128i isub(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+        inline __m128i iand(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+        inline __m128i iandNot(__m128i a, __m128i b) { return _mm_andnot_si128(a, b); }
+        inline __m128i ior(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+        inline __m128 iequal(__m128i a, __m128i b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+        template<int n>
+        inline __m128i shiftLeft(__m128i a) { return _mm_slli_epi32(a, n); }
+        template<int n>
+        inline __m128i shiftRight(__m128i a) { return _mm_srli_epi32(a, n); }
+        template<int n>
+        inline __m128i shiftRightArithmetic(__m128i a) { return _mm_srai_epi32(a, n); }
+        inline __m128 rsqrtEstimate(__m128 a) { return _mm_rsqrt_ps(a); }
+
+#endif
+
+#ifdef MOOS_AVX2
+
+        template<>
+        inline __m256 constant<__m256>(f32 value) { return _mm256_set1_ps(value); }
+        inline void setInt(__m256i& result, i32 value) { result = _mm256_set1_epi32(value); }
+
+        inline __m256 asFloat(__m256i i) { return _mm256_castsi256_ps(i); }
+        inline __m256i asInt(__m256 f) { return _mm256_castps_si256(f); }
+        inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+        inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+        inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+        inline __m256 div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+        inline __m256 sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+        inline __m256 min(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+        inline __m256 max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+        inline __m256 bitAnd(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+        inline __m256 bitAndNot(__m256 a, __m256 b) { return _mm256_andnot_ps(a, b); }
+        inline __m256 bitOr(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+        inline __m256 bitXor(__m256 a, __m256 b) { return _mm256_xor_ps(a, b); }
+        inline __m256 less(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        inline __m256 greater(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        inline __m256 equal(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        inline __m256 notGreaterEqual(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_NGE_UQ); }
+        inline __m256 isNegative(__m256 a) { return _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_castps_si256(a), 31)); }
+        inline __m256 maskAndNot(__m256 a, __m256 b) { return _mm256_andnot_ps(a, b); }
+        inline __m256 select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); }
+        inline __m256i truncateToInt(__m256 a) { return _mm256_cvttps_epi32(a); }
+        inline __m256i roundToInt(__m256 a) { return _mm256_cvtps_epi32(a); }
+        inline __m256 toFloat(__m256i i) { return _mm256_cvtepi32_ps(i); }
+        inline __m256i iadd(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+        inline __m256i isub(__m256i a, __m256i b) { return _mm256_sub_epi32(a, b); }
+        inline __m256i iand(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+        inline __m256i iandNot(__m256i a, __m256i b) { return _mm256_andnot_si256(a, b); }
+        inline __m256i ior(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+        inline __m256 iequal(__m256i a, __m256i b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+        template<int n>
+        inline __m256i shiftLeft(__m256i a) { return _mm256_slli_epi32(a, n); }
+        template<int n>
+        inline __m256i shiftRight(__m256i a) { return _mm256_srli_epi32(a, n); }
+        template<int n>
+        inline __m256i shiftRightArithmetic(__m256i a) { return _mm256_srai_epi32(a, n); }
+        inline __m256 rsqrtEstimate(__m256 a) { return _mm256_rsqrt_ps(a); }
+
+#endif
+
+        // The integer lanes matching the f32 lanes V
+        template<typename V>
+        using IntLanes = decltype(truncateToInt(std::declval<V>()));
+
+        template<typename V>
+        IntLanes<V> constantInt(i32 value)
+        {
+            IntLanes<V> result;
+            setInt(result, value);
+            return result;
+        }
+
+        // The approximations, for any of the lane types above
+
+        template<typename V, size_t N>
+        V polynomial(V x, const f32 (&coeffs)[N])
+        {
+            // (Horner's method, with the coefficient of the highest power first)
+            V p = constant<V>(coeffs[0]);
+            for (size_t i = 1; i < N; ++i) {
+                p = add(mul(p, x), constant<V>(coeffs[i]));
+            }
+            return p;
+        }
+
+        // Returns x * 2^n for n in [-126, 128], constructing the power of two directly as exponent bits. This is done in
+        // two steps, since 2^128 (for results just below the largest f32) can't be represented.
+        template<typename V, typename Int>
+        V scaleByPowerOfTwo(V x, Int n)
+        {
+            Int half = shiftRightArithmetic<1>(n);
+            V scale0 = asFloat(shiftLeft<23>(iadd(half, constantInt<V>(127))));
+            V scale1 = asFloat(shiftLeft<23>(iadd(isub(n, half), constantInt<V>(127))));
+            return mul(mul(x, scale0), scale1);
+        }
+
+        template<typename V>
+        void sincosImpl(V x, V& sinx, V& cosx)
+        {
+            using Int = IntLanes<V>;
+            const V signMask = constant<V>(-0.0f);
+            V sinSign = bitAnd(x, signMask);
+            x = bitAndNot(signMask, x);
+
+            // Out of range arguments (including infinities & NaN) give NaN, and are clamped so that the octant is valid
+            auto outOfRange = notGreaterEqual(constant<V>(sincosMaxArgument), x);
+            x = min(x, constant<V>(sincosMaxArgument));
+
+            // Reduce to the range [-pi/4, pi/4] using the octant j (which is made even)
+            Int j = truncateToInt(mul(x, constant<V>(fourOverPi)));
+            j = iand(iadd(j, constantInt<V>(1)), constantInt<V>(~1));
+            V y = toFloat(j);
+            x = sub(x, mul(y, constant<V>(piOver4Part1)));
+            x = sub(x, mul(y, constant<V>(piOver4Part2)));
+            x = sub(x, mul(y, constant<V>(piOver4Part3)));
+
+            V z = mul(x, x);
+            const f32 cosCoeffs[3] = { cosCoeff0, cosCoeff1, cosCoeff2 };
+            const f32 sinCoeffs[3] = { sinCoeff0, sinCoeff1, sinCoeff2 };
+            V cosPoly = mul(mul(polynomial(z, cosCoeffs), z), z);
+            cosPoly = add(sub(cosPoly, mul(z, constant<V>(0.5f))), constant<V>(1.0f));
+            V sinPoly = add(mul(mul(polynomial(z, sinCoeffs), z), x), x);
+
+            const Int two = constantInt<V>(2);
+            const Int four = constantInt<V>(4);
+            auto swap = iequal(iand(j, two), two);
+            V sinSwapSign = asFloat(shiftLeft<29>(iand(j, four)));
+            V cosSign = asFloat(shiftLeft<29>(iandNot(isub(j, two), four)));
+            sinx = bitXor(select(swap, cosPoly, sinPoly), bitXor(sinSign, sinSwapSign));
+            cosx = bitXor(select(swap, sinPoly, cosPoly), cosSign);
+            const V nan = asFloat(constantInt<V>(0x7fc00000));
+            sinx = select(outOfRange, nan, sinx);
+            cosx = select(outOfRange, nan, cosx);
+        }
+
+        template<typename V>
+        V atan2Impl(V y, V x)
+        {
+            const V signMask = constant<V>(-0.0f);
+            const V zero = constant<V>(0.0f);
+            const V one = constant<V>(1.0f);
+            V ax = bitAndNot(signMask, x);
+            V ay = bitAndNot(signMask, y);
+
+            // Arctangent of t = ay / ax, in the range [0, pi/2], by reducing to the range [0, tan(pi/8)]. For x = y = 0,
+            // t is 0 instead of NaN, so that the result is 0 or pi like for std::atan2.
+            V t = div(ay, select(equal(bitOr(ax, ay), zero), one, ax));
+            auto large = greater(t, constant<V>(tan3PiOver8));
+            auto medium = maskAndNot(large, greater(t, constant<V>(tanPiOver8)));
+            V tLarge = div(constant<V>(-1.0f), t);
+            V tMedium = div(sub(t, one), add(t, one));
+            t = select(large, tLarge, select(medium, tMedium, t));
+            V offset = select(large, constant<V>(halfPi), select(medium, constant<V>(quarterPi), zero));
+
+            V z = mul(t, t);
+            const f32 atanCoeffs[4] = { atanCoeff0, atanCoeff1, atanCoeff2, atanCoeff3 };
+            V res = add(offset, add(mul(mul(polynomial(z, atanCoeffs), z), t), t));
+
+            // Mirror for negative x (including -0) and copy the sign of y
+            res = select(isNegative(x), sub(constant<V>(pi), res), res);
+            return bitOr(res, bitAnd(y, signMask));
+        }
+
+        template<typename V>
+        V exp2Impl(V x)
+        {
+            using Int = IntLanes<V>;
+            auto underflow = less(x, constant<V>(-126.0f));
+            x = max(constant<V>(-126.0f), min(constant<V>(128.0f), x));
+
+            // 2^x = 2^n * 2^f with f in [-1/2, 1/2], where 2^n is constructed directly as the exponent bits
+            Int n = roundToInt(x);
+            V f = sub(x, toFloat(n));
+            V p = add(mul(polynomial(f, exp2Coeffs), f), constant<V>(1.0f));
+            return select(underflow, constant<V>(0.0f), scaleByPowerOfTwo(p, n));
+        }
+
+        template<typename V>
+        V expImpl(V x)
+        {
+            using Int = IntLanes<V>;
+            auto underflow = less(x, constant<V>(expMin));
+            x = max(constant<V>(expMin), min(constant<V>(expMax), x));
+
+            // e^x = 2^n * e^r, with r = x - n * ln(2) in [-ln(2)/2, ln(2)/2], using ln(2) in two parts for precision
+            Int n = roundToInt(mul(x, constant<V>(log2e)));
+            V nf = toFloat(n);
+            V r = sub(sub(x, mul(nf, constant<V>(ln2Part1))), mul(nf, constant<V>(ln2Part2)));
+            V p = add(add(mul(mul(polynomial(r, expCoeffs), r), r), r), constant<V>(1.0f));
+            return select(underflow, constant<V>(0.0f), scaleByPowerOfTwo(p, n));
+        }
+
+        // Splits x into 2^e * (1 + m) with m in [sqrt(1/2) - 1, sqrt(2) - 1], and returns the polynomial part of ln(1 + m)
+        // minus m (to be added last for precision). Denormal inputs are treated as the smallest normal number.
+        template<typename V>
+        V logReduce(V x, V& e, V& m)
+        {
+            using Int = IntLanes<V>;
+            const V one = constant<V>(1.0f);
+            x = max(x, constant<V>(1.17549435e-38f));
+            Int bits = asInt(x);
+            e = toFloat(isub(shiftRight<23>(bits), constantInt<V>(126)));
+            m = asFloat(ior(iand(bits, constantInt<V>(0x007fffff)), constantInt<V>(0x3f000000))); // (in [1/2, 1))
+
+            auto small = less(m, constant<V>(sqrtHalf));
+            e = sub(e, select(small, one, constant<V>(0.0f)));
+            m = add(sub(m, one), select(small, m, constant<V>(0.0f)));
+
+            V z = mul(m, m);
+            V y = mul(mul(polynomial(m, logCoeffs), m), z);
+            return sub(y, mul(z, constant<V>(0.5f)));
+        }
+
+        template<typename V>
+        V logSpecialCases(V x, V res)
+        {
+            const f32 infinity = std::numeric_limits<f32>::infinity();
+            res = select(equal(x, constant<V>(infinity)), constant<V>(infinity), res);
+            res = select(equal(x, constant<V>(0.0f)), constant<V>(-infinity), res);
+            return select(notGreaterEqual(x, constant<V>(0.0f)), constant<V>(std::numeric_limits<f32>::quiet_NaN()), res);
+        }
+
+        template<typename V>
+        V logImpl(V x)
+        {
+            V e, m;
+            V y = logReduce(x, e, m);
+            y = add(y, mul(e, constant<V>(ln2Part2)));
+            V res = add(add(m, y), mul(e, constant<V>(ln2Part1)));
+            return logSpecialCases(x, res);
+        }
+
+        template<typename V>
+        V log2Impl(V x)
+        {
+            V e, m;
+            V y = logReduce(x, e, m);
+            V res = add(e, mul(add(m, y), constant<V>(log2e)));
+            return logSpecialCases(x, res);
+        }
+
+        template<typename V>
+        V powImpl(V x, V y)
+        {
+            // (x^0 = 1 for all x, including 0, which would otherwise be 2^(0 * -inf))
+            V res = exp2Impl(mul(y, log2Impl(x)));
+            return select(equal(y, constant<V>(0.0f)), constant<V>(1.0f), res);
+        }
+
+        template<typename V>
+        V rsqrtImpl(V x)
+        {
+            // One Newton-Raphson step from the hardware estimate (with 12 bits of precision)
+            V y = rsqrtEstimate(x);
+            V halfXYY = mul(mul(constant<V>(0.5f), x), mul(y, y));
+            return mul(y, sub(constant<V>(1.5f), halfXYY));
+        }
+
+        template<typename V>
+        V cbrtImpl(V x)
+        {
+            const V signMask = constant<V>(-0.0f);
+            V sign = bitAnd(x, signMask);
+            V ax = bitAndNot(signMask, x);
+
+            // Initial guess by dividing the exponent (and mantissa) bits by three, then two Halley steps (written as a
+            // correction to y, for precision)
+            V bitsOverThree = mul(toFloat(asInt(ax)), constant<V>(1.0f / 3.0f));
+            V y = asFloat(iadd(truncateToInt(bitsOverThree), constantInt<V>(709921077)));
+            for (int i = 0; i < 2; ++i) {
+                V y3 = mul(mul(y, y), y);
+                y = sub(y, mul(y, div(sub(y3, ax), add(add(y3, y3), ax))));
+            }
+
+            const f32 infinity = std::numeric_limits<f32>::infinity();
+            y = select(equal(ax, constant<V>(0.0f)), constant<V>(0.0f), y);
+            y = select(equal(ax, constant<V>(infinity)), constant<V>(infinity), y);
+            return bitOr(y, sign);
+        }
+
+        template<typename V>
+        V asinImpl(V x)
+        {
+            const V one = constant<V>(1.0f);
+            return atan2Impl(x, sqrt(mul(sub(one, x), add(one, x))));
+        }
+
+        template<typename V>
+        V acosImpl(V x)
+        {
+            const V one = constant<V>(1.0f);
+            return atan2Impl(sqrt(mul(sub(one, x), add(one, x))), x);
+        }
+
+        template<typename V>
+        V tanImpl(V x)
+        {
+            V s, c;
+            sincosImpl(x, s, c);
+            return div(s, c);
+        }
+
+    } // namespace detail
+
+    // Sine & cosine of x. Max. error is 2 ULP for |x| < 8192 where the result isn't close to 0 (the absolute error is
+    // around 1e-7 there), after which precision degrades. For |x| > 2^24, infinities & NaN the results are NaN.
+    inline void sincos(f32 x, f32& sinx, f32& cosx) { detail::sincosImpl(x, sinx, cosx); }
+    inline f32 sin(f32 x) { f32 s, c; detail::sincosImpl(x, s, c); return s; }
+    inline f32 cos(f32 x) { f32 s, c; detail::sincosImpl(x, s, c); return c; }
+
+    // Tangent of x, as sin(x) / cos(x). Max. error is 3 ULP for |x| < 1.5 where the result isn't close to 0.
+    inline f32 tan(f32 x) { return detail::tanImpl(x); }
+
+    // Arctangent of y/x in the range [-pi, pi], like std::atan2 (including signed zeros). Max. error is 4 ULP.
+    inline f32 atan2(f32 y, f32 x) { return detail::atan2Impl(y, x); }
+
+    // Arcsine & arccosine of x in [-1, 1], via atan2. Max. error is 4 ULP.
+    inline f32 asin(f32 x) { return detail::asinImpl(x); }
+    inline f32 acos(f32 x) { return detail::acosImpl(x); }
+
+    // e^x and 2^x. Max. error is 2 ULP (exp) and 1.25 ULP (exp2), and results which would be denormal are flushed to zero.
+    inline f32 exp(f32 x) { return detail::expImpl(x); }
+    inline f32 exp2(f32 x) { return detail::exp2Impl(x); }
+
+    // Natural & base-2 logarithms of x, with -inf for 0 and NaN for x < 0. Max. error is 1 ULP (log) and 2 ULP (log2)
+    // where the result isn't close to 0 (the absolute error is around 1e-7 there).
+    inline f32 log(f32 x) { return detail::logImpl(x); }
+    inline f32 log2(f32 x) { return detail::log2Impl(x); }
+
+    // x^y for x >= 0, as 2^(y * log2(x)), so the error grows with the magnitude of the exponent: max. error is around
+    // 4 + 1.2 * |y * log2(x)| ULP, e.g. 6 ULP for x^(1/2.4) but 45 ULP for 0.00003^2.4. Unlike std::pow, x^0 = 1 is the
+    // only special case.
+    inline f32 pow(f32 x, f32 y) { return detail::powImpl(x, y); }
+
+    // 1 / sqrt(x) for x > 0. Max. error is 4 ULP with SSE & AVX2, where it's refined from the hardware estimate (so the
+    // results can differ between CPUs), and 2 ULP without intrinsics.
+    inline f32 rsqrt(f32 x) { return detail::rsqrtImpl(x); }
+
+    // Cube root of x. Max. error is 1 ULP for normal x.
+    inline f32 cbrt(f32 x) { return detail::cbrtImpl(x); }
+
+#ifdef MOOS_SSE
+
+    inline void sincos(__m128 x, __m128& sinx, __m128& cosx) { detail::sincosImpl(x, sinx, cosx); }
+    inline __m128 sin(__m128 x) { __m128 s, c; detail::sincosImpl(x, s, c); return s; }
+    inline __m128 cos(__m128 x) { __m128 s, c; detail::sincosImpl(x, s, c); return c; }
+    inline __m128 tan(__m128 x) { return detail::tanImpl(x); }
+    inline __m128 atan2(__m128 y, __m128 x) { return detail::atan2Impl(y, x); }
+    inline __m128 asin(__m128 x) { return detail::asinImpl(x); }
+    inline __m128 acos(__m128 x) { return detail::acosImpl(x); }
+    inline __m128 exp(__m128 x) { return detail::expImpl(x); }
+    inline __m128 exp2(__m128 x) { return detail::exp2Impl(x); }
+    inline __m128 log(__m128 x) { return detail::logImpl(x); }
+    inline __m128 log2(__m128 x) { return detail::log2Impl(x); }
+    inline __m128 pow(__m128 x, __m128 y) { return detail::powImpl(x, y); }
+    inline __m128 rsqrt(__m128 x) { return detail::rsqrtImpl(x); }
+    inline __m128 cbrt(__m128 x) { return detail::cbrtImpl(x); }
+
+#endif
+
+#ifdef MOOS_AVX2
+
+    inline void sincos(__m256 x, __m256& sinx, __m256& cosx) { detail::sincosImpl(x, sinx, cosx); }
+    inline __m256 sin(__m256 x) { __m256 s, c; detail::sincosImpl(x, s, c); return s; }
+    inline __m256 cos(__m256 x) { __m256 s, c; detail::sincosImpl(x, s, c); return c; }
+    inline __m256 tan(__m256 x) { return detail::tanImpl(x); }
+    inline __m256 atan2(__m256 y, __m256 x) { return detail::atan2Impl(y, x); }
+    inline __m256 asin(__m256 x) { return detail::asinImpl(x); }
+    inline __m256 acos(__m256 x) { return detail::acosImpl(x); }
+    inline __m256 exp(__m256 x) { return detail::expImpl(x); }
+    inline __m256 exp2(__m256 x) { return detail::exp2Impl(x); }
+    inline __m256 log(__m256 x) { return detail::logImpl(x); }
+    inline __m256 log2(__m256 x) { return detail::log2Impl(x); }
+    inline __m256 pow(__m256 x, __m256 y) { return detail::powImpl(x, y); }
+    inline __m256 rsqrt(__m256 x) { return detail::rsqrtImpl(x); }
+    inline __m256 cbrt(__m256 x) { return detail::cbrtImpl(x); }
+
+#endif
+
+} // namespace fast
+
 } // namespace moos
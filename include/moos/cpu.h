@@ -0,0 +1,242 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "core.h"
+
+#include <atomic> // for std::atomic
+#include <cstdlib> // for std::getenv
+#include <initializer_list> // for std::initializer_list
+
+// Runtime CPU feature detection & dispatching of batch kernels to the best implementation for the CPU. Kernels for SIMD
+// levels above the compilation target are compiled with per-function target attributes (GCC & Clang only, like
+// MOOS_SSE), so a single binary built for SSE2 can still use e.g. AVX2 where it's available. Define MOOS_NO_DISPATCH
+// to disable this, in which case only the scalar & SSE2 kernels are used.
+#if defined(MOOS_SSE) && !defined(MOOS_NO_DISPATCH) && defined(__GNUC__)
+#define MOOS_DISPATCH
+#include <cpuid.h>
+#define MOOS_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MOOS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define MOOS_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#if defined(__clang__)
+#define MOOS_BEGIN_AVX512_KERNELS
+#define MOOS_END_AVX512_KERNELS
+#else
+// GCC 12 warns about the deliberately uninitialized vectors in its own AVX-512 intrinsics (GCC bug 105593)
+#define MOOS_BEGIN_AVX512_KERNELS _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define MOOS_END_AVX512_KERNELS _Pragma("GCC diagnostic pop")
+#endif
+#endif
+
+namespace moos {
+
+// The SIMD levels kernels can be written for, where each level includes the ones below it
+enum class SimdLevel : int {
+    Scalar = 0,
+    SSE2,
+    SSE41,
+    AVX2, // (AVX2 & FMA)
+    AVX512, // (AVX-512F)
+    Count
+};
+
+struct CpuFeatures {
+    bool sse2 { false };
+    bool sse41 { false };
+    bool avx { false };
+    bool avx2 { false };
+    bool fma { false };
+    bool avx512f { false };
+};
+
+namespace detail {
+
+#ifdef MOOS_DISPATCH
+
+    inline void cpuid(u32 leaf, u32 subleaf, u32 registers[4])
+    {
+        __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+    }
+
+    // Returns the XCR0 register, which tells which register states the OS saves on context switches
+    inline u64 extendedControlRegister()
+    {
+        u32 low, high;
+        __asm__("xgetbv"
+                : "=a"(low), "=d"(high)
+                : "c"(0));
+        return (static_cast<u64>(high) << 32) | low;
+    }
+
+#endif
+
+    inline CpuFeatures detectCpuFeatures()
+    {
+        CpuFeatures features;
+#ifdef MOOS_DISPATCH
+        u32 r[4];
+        cpuid(0, 0, r);
+        u32 maxLeaf = r[0];
+
+        cpuid(1, 0, r);
+        features.sse2 = (r[3] & (1u << 26)) != 0;
+        features.sse41 = (r[2] & (1u << 19)) != 0;
+        bool osxsave = (r[2] & (1u << 27)) != 0;
+        bool avx = (r[2] & (1u << 28)) != 0;
+        bool fma = (r[2] & (1u << 12)) != 0;
+
+        // AVX (and AVX-512) also require that the OS saves the YMM (and opmask & ZMM) registers
+        u64 xcr0 = osxsave ? extendedControlRegister() : 0;
+        bool ymmState = (xcr0 & 0x06) == 0x06;
+        bool zmmState = (xcr0 & 0xe6) == 0xe6;
+        features.avx = avx && ymmState;
+        features.fma = fma && features.avx;
+
+        if (maxLeaf >= 7) {
+            cpuid(7, 0, r);
+            features.avx2 = features.avx && (r[1] & (1u << 5)) != 0;
+            features.avx512f = features.avx && zmmState && (r[1] & (1u << 16)) != 0;
+        }
+#elif defined(MOOS_SSE)
+        features.sse2 = true;
+#endif
+        return features;
+    }
+
+    inline SimdLevel simdLevelFromFeatures(const CpuFeatures& features)
+    {
+        if (features.avx512f && features.avx2 && features.fma) {
+            return SimdLevel::AVX512;
+        }
+        if (features.avx2 && features.fma) {
+            return SimdLevel::AVX2;
+        }
+        if (features.sse41) {
+            return SimdLevel::SSE41;
+        }
+        return features.sse2 ? SimdLevel::SSE2 : SimdLevel::Scalar;
+    }
+
+    inline bool parseSimdLevel(const char* name, SimdLevel& level)
+    {
+        const char* names[] = { "scalar", "sse2", "sse4.1", "avx2", "avx512" };
+        for (int i = 0; i < static_cast<int>(SimdLevel::Count); ++i) {
+            if (std::strcmp(name, names[i]) == 0) {
+                level = static_cast<SimdLevel>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace detail
+
+// Features of the CPU the program is running on (only the ones which moos has kernels for). These are detected once.
+inline const CpuFeatures& cpuFeatures()
+{
+    static const CpuFeatures features = detail::detectCpuFeatures();
+    return features;
+}
+
+inline SimdLevel detectedSimdLevel()
+{
+    static const SimdLevel level = detail::simdLevelFromFeatures(cpuFeatures());
+    return level;
+}
+
+inline const char* simdLevelName(SimdLevel level)
+{
+    const char* names[] = { "scalar", "sse2", "sse4.1", "avx2", "avx512" };
+    int index = static_cast<int>(level);
+    return (index >= 0 && index < static_cast<int>(SimdLevel::Count)) ? names[index] : "unknown";
+}
+
+namespace detail {
+
+    inline std::atomic<int>& currentSimdLevel()
+    {
+        static std::atomic<int> level { [] {
+            SimdLevel detected = detectedSimdLevel();
+            SimdLevel requested = detected;
+            const char* variable = std::getenv("MOOS_SIMD_LEVEL");
+            if (variable && parseSimdLevel(variable, requested) && requested < detected) {
+                return static_cast<int>(requested);
+            }
+            return static_cast<int>(detected);
+        }() };
+        return level;
+    }
+
+} // namespace detail
+
+// The SIMD level which batch kernels are dispatched for. This is the detected level, unless lowered (e.g. for
+// benchmarking) by the MOOS_SIMD_LEVEL environment variable (scalar, sse2, sse4.1, avx2 or avx512) or by setSimdLevel.
+inline SimdLevel simdLevel()
+{
+    return static_cast<SimdLevel>(detail::currentSimdLevel().load(std::memory_order_relaxed));
+}
+
+// Sets the SIMD level for dispatching, which is clamped to the detected level. Returns the level which is then used.
+inline SimdLevel setSimdLevel(SimdLevel level)
+{
+    SimdLevel detected = detectedSimdLevel();
+    SimdLevel clamped = (level < detected) ? level : detected;
+    detail::currentSimdLevel().store(static_cast<int>(clamped), std::memory_order_relaxed);
+    return clamped;
+}
+
+// A table of implementations of a kernel (function pointers of type Fn) for different SIMD levels, of which select()
+// returns the one for the highest level which is not above the current one. There must be a scalar implementation.
+template<typename Fn>
+class KernelTable {
+public:
+    struct Entry {
+        SimdLevel level;
+        Fn kernel;
+    };
+
+    KernelTable(std::initializer_list<Entry> entries)
+    {
+        for (const Entry& entry : entries) {
+            m_kernels[static_cast<int>(entry.level)] = entry.kernel;
+        }
+        MOOS_ASSERT(m_kernels[static_cast<int>(SimdLevel::Scalar)] != nullptr);
+    }
+
+    Fn select(SimdLevel level = simdLevel()) const
+    {
+        for (int i = static_cast<int>(level); i > 0; --i) {
+            if (m_kernels[i] != nullptr) {
+                return m_kernels[i];
+            }
+        }
+        return m_kernels[0];
+    }
+
+private:
+    Fn m_kernels[static_cast<int>(SimdLevel::Count)] {};
+};
+
+} // namespace moos
@@ -0,0 +1,218 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "core.h"
+#include "vector.h"
+
+#include <cstring> // for std::memcpy
+
+namespace moos {
+
+// Double-float (df64) numbers, i.e., an unevaluated sum hi + lo of two f32 values with |lo| <= ulp(hi) / 2, which gives
+// around 48 bits of mantissa using only f32 arithmetic. This is the representation used for emulated double precision
+// on GPUs, so e.g. world positions split on the CPU can be subtracted in shaders without losing precision far away from
+// the origin. The arithmetic is based on the error-free transformations from "Extended-Precision Floating-Point Numbers
+// for GPU Computation" by Andrew Thall, and must not be compiled with flags that allow reassociation (e.g. -ffast-math).
+// The exponent range is still that of f32: the extra precision is only there while both parts are normal f32 values, so
+// e.g. products beyond ~3.4e38 overflow and results below ~1e-31 gradually lose their low part.
+
+struct df64 {
+    f32 hi;
+    f32 lo;
+
+    explicit constexpr df64(f32 hi = 0.0f, f32 lo = 0.0f) noexcept
+        : hi(hi)
+        , lo(lo)
+    {
+    }
+
+    explicit df64(f64 value) noexcept;
+
+    // (without this df64(3) would be ambiguous between the f32 & f64 constructors; every i32 is exact in f64)
+    explicit df64(i32 value) noexcept
+        : df64(static_cast<f64>(value))
+    {
+    }
+
+    explicit constexpr operator f64() const
+    {
+        return static_cast<f64>(hi) + static_cast<f64>(lo);
+    }
+};
+
+namespace detail {
+
+    // a + b = s.hi + s.lo exactly, for any a & b
+    constexpr df64 twoSum(f32 a, f32 b)
+    {
+        f32 s = a + b;
+        f32 v = s - a;
+        f32 e = (a - (s - v)) + (b - v);
+        return df64(s, e);
+    }
+
+    // a + b = s.hi + s.lo exactly, assuming |a| >= |b|
+    constexpr df64 quickTwoSum(f32 a, f32 b)
+    {
+        f32 s = a + b;
+        f32 e = b - (s - a);
+        return df64(s, e);
+    }
+
+    // Truncates the mantissa of an f64 to the 24 bits of an f32, so that high is exactly representable as an f32 and
+    // value - high is exact in f64. The low part is that remainder rounded to f32 (it can have up to 29 significant bits).
+    // This avoids both a round trip through f32 (which e.g. GCC 12 incorrectly folds away when vectorizing) and a
+    // Veltkamp split (which breaks if the compiler contracts it into an FMA).
+    inline f64 truncateToFloatPrecision(f64 value)
+    {
+        u64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits &= ~((u64(1) << 29) - 1);
+        f64 high;
+        std::memcpy(&high, &bits, sizeof(high));
+        return high;
+    }
+
+    // a * b = p.hi + p.lo exactly, as long as the product stays within the normal f32 range. The product of two f32
+    // values is exact in f64, so there is no need for a Dekker split or an FMA on the CPU (and the result is the same,
+    // since both are exact). Outside of that range it is not exact: above FLT_MAX hi overflows to infinity, and below
+    // ~2^-102 the low part is rounded to a subnormal (or flushed to zero), just like the GPU version would.
+    inline df64 twoProduct(f32 a, f32 b)
+    {
+        f64 p = static_cast<f64>(a) * static_cast<f64>(b);
+        f64 high = truncateToFloatPrecision(p);
+        return quickTwoSum(static_cast<f32>(high), static_cast<f32>(p - high));
+    }
+
+} // namespace detail
+
+inline df64::df64(f64 value) noexcept
+{
+    f64 high = detail::truncateToFloatPrecision(value);
+    *this = detail::quickTwoSum(static_cast<f32>(high), static_cast<f32>(value - high));
+}
+
+constexpr df64 operator+(const df64& a, const df64& b)
+{
+    df64 s = detail::twoSum(a.hi, b.hi);
+    df64 t = detail::twoSum(a.lo, b.lo);
+    s = detail::quickTwoSum(s.hi, s.lo + t.hi);
+    return detail::quickTwoSum(s.hi, s.lo + t.lo);
+}
+
+constexpr df64 operator-(const df64& a)
+{
+    return df64(-a.hi, -a.lo);
+}
+
+constexpr df64 operator-(const df64& a, const df64& b)
+{
+    return a + (-b);
+}
+
+inline df64 operator*(const df64& a, const df64& b)
+{
+    df64 p = detail::twoProduct(a.hi, b.hi);
+    return detail::quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+inline df64 operator/(const df64& a, const df64& b)
+{
+    // (long division: one f32 quotient and one correction from the remainder)
+    f32 q1 = a.hi / b.hi;
+    df64 r = a - b * df64(q1);
+    f32 q2 = r.hi / b.hi;
+    return detail::quickTwoSum(q1, q2);
+}
+
+constexpr bool operator==(const df64& a, const df64& b)
+{
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+constexpr bool operator!=(const df64& a, const df64& b)
+{
+    return !(a == b);
+}
+
+constexpr bool operator<(const df64& a, const df64& b)
+{
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+inline df64 sqrt(const df64& a)
+{
+    // (one Newton step from the f32 square root, as in Karp & Markstein)
+    if (a.hi <= 0.0f) {
+        return df64(0.0f);
+    }
+    f32 x = 1.0f / std::sqrt(a.hi);
+    f32 y = a.hi * x;
+    df64 residual = a - detail::twoProduct(y, y);
+    return detail::quickTwoSum(y, residual.hi * (x * 0.5f));
+}
+
+// Splits count f64 vectors into the high and low f32 parts of their df64 representations, e.g. for uploading world
+// positions to the GPU. Both the high and low parts are required.
+inline void splitDf64Batch(const dvec3* values, fvec3* high, fvec3* low, size_t count)
+{
+    size_t i = 0;
+
+#ifdef MOOS_SSE
+    // (two vectors per iteration, as three registers of two doubles, truncated as in truncateToFloatPrecision)
+    const __m128d mantissaMask = _mm_castsi128_pd(_mm_set1_epi64x(~((i64(1) << 29) - 1)));
+    for (; i + 2 <= count; i += 2) {
+        const f64* src = &values[i].x;
+        __m128d a = _mm_loadu_pd(src + 0), b = _mm_loadu_pd(src + 2), c = _mm_loadu_pd(src + 4);
+        __m128d aHigh = _mm_and_pd(a, mantissaMask), bHigh = _mm_and_pd(b, mantissaMask), cHigh = _mm_and_pd(c, mantissaMask);
+        __m128 truncated = _mm_movelh_ps(_mm_cvtpd_ps(aHigh), _mm_cvtpd_ps(bHigh));
+        __m128 truncatedTail = _mm_cvtpd_ps(cHigh);
+        __m128 remainder = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(a, aHigh)), _mm_cvtpd_ps(_mm_sub_pd(b, bHigh)));
+        __m128 remainderTail = _mm_cvtpd_ps(_mm_sub_pd(c, cHigh));
+
+        // (renormalize as in quickTwoSum)
+        __m128 hi = _mm_add_ps(truncated, remainder);
+        __m128 lo = _mm_sub_ps(remainder, _mm_sub_ps(hi, truncated));
+        __m128 hiTail = _mm_add_ps(truncatedTail, remainderTail);
+        __m128 loTail = _mm_sub_ps(remainderTail, _mm_sub_ps(hiTail, truncatedTail));
+
+        f32* highDst = &high[i].x;
+        f32* lowDst = &low[i].x;
+        _mm_storeu_ps(highDst, hi);
+        _mm_storel_pi(reinterpret_cast<__m64*>(highDst + 4), hiTail);
+        _mm_storeu_ps(lowDst, lo);
+        _mm_storel_pi(reinterpret_cast<__m64*>(lowDst + 4), loTail);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        df64 x = df64(values[i].x), y = df64(values[i].y), z = df64(values[i].z);
+        high[i] = { x.hi, y.hi, z.hi };
+        low[i] = { x.lo, y.lo, z.lo };
+    }
+}
+
+} // namespace moos
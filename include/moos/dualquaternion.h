@@ -0,0 +1,327 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "core.h"
+#include "matrix.h"
+#include "quaternion.h"
+#include "vector.h"
+
+namespace moos {
+
+// A dual quaternion real + ε dual, representing a rigid transformation (rotation & translation). For unit dual
+// quaternions the real part is the rotation, and the dual part is 0.5 * translation * real.
+template<typename T, typename _ = void>
+struct tdualquat {
+};
+
+template<typename T>
+struct tdualquat<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
+    tquat<T> real;
+    tquat<T> dual;
+
+    constexpr tdualquat(const tquat<T>& real, const tquat<T>& dual) noexcept
+        : real(real)
+        , dual(dual)
+    {
+    }
+
+    constexpr tdualquat() noexcept
+        : tdualquat(tquat<T>(), tquat<T>(tvec3<T>(static_cast<T>(0)), static_cast<T>(0)))
+    {
+    }
+
+    constexpr tdualquat<T> operator*(const tdualquat<T>& other) const
+    {
+        return { real * other.real, real * other.dual + dual * other.real };
+    }
+
+    constexpr tdualquat<T> operator+(const tdualquat<T>& other) const
+    {
+        return { real + other.real, dual + other.dual };
+    }
+
+    constexpr tdualquat<T> operator*(T f) const
+    {
+        return { real * f, dual * f };
+    }
+};
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tdualquat<T> dualQuatFromRotationTranslation(const tquat<T>& rotation, const tvec3<T>& translation)
+{
+    tquat<T> translationQuat = tquat<T>(translation, static_cast<T>(0));
+    return { rotation, static_cast<T>(0.5) * (translationQuat * rotation) };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tdualquat<T> dualQuatFromMatrix(const tmat4<T>& m)
+{
+    // (assumes the matrix is a rigid transformation, i.e., only rotation & translation)
+    return dualQuatFromRotationTranslation(quatFromMatrix(m), m.w.xyz());
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec3<T> dualQuatTranslation(const tdualquat<T>& dq)
+{
+    // i.e. the vector part of 2 * dual * conjugate(real)
+    const tquat<T>& r = dq.real;
+    const tquat<T>& d = dq.dual;
+    return static_cast<T>(2) * (r.w * d.vec - d.w * r.vec + cross(r.vec, d.vec));
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> dualQuatToMatrix(const tdualquat<T>& dq)
+{
+    tmat4<T> m = quatToMatrix(dq.real);
+    m.w = tvec4<T>(dualQuatTranslation(dq), static_cast<T>(1));
+    return m;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tdualquat<T> normalize(const tdualquat<T>& dq)
+{
+    // Scales to unit length and removes any part of the dual which is not orthogonal to the real part
+    T invLength = static_cast<T>(1) / length(dq.real);
+    tquat<T> real = dq.real * invLength;
+    tquat<T> dual = dq.dual * invLength;
+    dual = dual - real * dot(real, dual);
+    return { real, dual };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tdualquat<T> inverse(const tdualquat<T>& dq)
+{
+    // (assumes a unit dual quaternion)
+    return { conjugate(dq.real), conjugate(dq.dual) };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec3<T> transformPoint(const tdualquat<T>& dq, const tvec3<T>& point)
+{
+    return dq.real * point + dualQuatTranslation(dq);
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec3<T> transformDirection(const tdualquat<T>& dq, const tvec3<T>& direction)
+{
+    return dq.real * direction;
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline tvec3<f32> transformPoint(const tdualquat<f32>& dq, const tvec3<f32>& point)
+{
+    __m128 r = dq.real.simd();
+    __m128 d = dq.dual.simd();
+    __m128 rw = simd::splat<3>(r);
+    __m128 dw = simd::splat<3>(d);
+    __m128 p = simd::load(point);
+
+    // Rotation (see tquat<f32>::operator*) and translation (see dualQuatTranslation)
+    __m128 t = simd::cross3(r, p);
+    t = _mm_add_ps(t, t);
+    __m128 res = _mm_add_ps(p, _mm_mul_ps(rw, t));
+    res = _mm_add_ps(res, simd::cross3(r, t));
+
+    __m128 translation = _mm_sub_ps(_mm_mul_ps(rw, d), _mm_mul_ps(dw, r));
+    translation = _mm_add_ps(translation, simd::cross3(r, d));
+    res = _mm_add_ps(res, _mm_add_ps(translation, translation));
+
+    return simd::storeVec3(res);
+}
+
+#endif
+
+using dualquat = tdualquat<Float>;
+using fdualquat = tdualquat<f32>;
+using ddualquat = tdualquat<f64>;
+
+// Dual quaternion linear blend skinning ("Skinning with Dual Quaternions" by Kavan et al.). For each vertex the bone
+// transforms are blended with the given weights, in the same hemisphere as the first influence, and normalized. The
+// bone indices and weights are arrays with influenceCount values per vertex. Normals are optional (may be nullptr).
+// For f32 with SSE, four vertices are skinned at a time.
+
+namespace detail {
+
+    template<typename T>
+    void skinDualQuatVertices(const tdualquat<T>* bones, const u16* boneIndices, const T* boneWeights, int influenceCount,
+                              const tvec3<T>* positions, const tvec3<T>* normals, size_t vertexCount,
+                              tvec3<T>* skinnedPositions, tvec3<T>* skinnedNormals)
+    {
+        for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+            const u16* indices = boneIndices + vertex * influenceCount;
+            const T* weights = boneWeights + vertex * influenceCount;
+
+            const tdualquat<T>& first = bones[indices[0]];
+            tdualquat<T> blended = first * weights[0];
+            for (int i = 1; i < influenceCount; ++i) {
+                const tdualquat<T>& bone = bones[indices[i]];
+                T weight = (dot(first.real, bone.real) < static_cast<T>(0)) ? -weights[i] : weights[i];
+                blended = blended + bone * weight;
+            }
+
+            // (the translation only depends on the vector part of 2 * dual * conjugate(real), so we can skip
+            // the orthogonalization step of the full normalization and only scale to unit length here)
+            blended = blended * (static_cast<T>(1) / length(blended.real));
+
+            skinnedPositions[vertex] = transformPoint(blended, positions[vertex]);
+            if (normals && skinnedNormals) {
+                skinnedNormals[vertex] = transformDirection(blended, normals[vertex]);
+            }
+        }
+    }
+
+} // namespace detail
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void skinDualQuatBatch(const tdualquat<T>* bones, const u16* boneIndices, const T* boneWeights, int influenceCount,
+                       const tvec3<T>* positions, const tvec3<T>* normals, size_t vertexCount,
+                       tvec3<T>* skinnedPositions, tvec3<T>* skinnedNormals)
+{
+    MOOS_ASSERT(influenceCount >= 1 && influenceCount <= 8);
+    detail::skinDualQuatVertices(bones, boneIndices, boneWeights, influenceCount, positions, normals, vertexCount, skinnedPositions, skinnedNormals);
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    // Rotates four vectors by four unit quaternions (with the vector part q and real part w), like tquat<f32>::operator*
+    inline void rotateVec3x4(const __m128 q[3], __m128 w, __m128& x, __m128& y, __m128& z)
+    {
+        __m128 tx, ty, tz, cx, cy, cz;
+        cross3x4(q[0], q[1], q[2], x, y, z, tx, ty, tz);
+        tx = _mm_add_ps(tx, tx);
+        ty = _mm_add_ps(ty, ty);
+        tz = _mm_add_ps(tz, tz);
+        cross3x4(q[0], q[1], q[2], tx, ty, tz, cx, cy, cz);
+        x = _mm_add_ps(_mm_add_ps(x, _mm_mul_ps(w, tx)), cx);
+        y = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(w, ty)), cy);
+        z = _mm_add_ps(_mm_add_ps(z, _mm_mul_ps(w, tz)), cz);
+    }
+
+    inline void storeVec3x4(__m128 x, __m128 y, __m128 z, tvec3<f32>* result)
+    {
+        alignas(16) f32 xs[4], ys[4], zs[4];
+        _mm_store_ps(xs, x);
+        _mm_store_ps(ys, y);
+        _mm_store_ps(zs, z);
+        for (int i = 0; i < 4; ++i) {
+            result[i] = tvec3<f32>(xs[i], ys[i], zs[i]);
+        }
+    }
+
+} // namespace detail
+
+template<>
+inline void skinDualQuatBatch(const tdualquat<f32>* bones, const u16* boneIndices, const f32* boneWeights, int influenceCount,
+                              const tvec3<f32>* positions, const tvec3<f32>* normals, size_t vertexCount,
+                              tvec3<f32>* skinnedPositions, tvec3<f32>* skinnedNormals)
+{
+    MOOS_ASSERT(influenceCount >= 1 && influenceCount <= 8);
+
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    size_t vertex = 0;
+    for (; vertex + 4 <= vertexCount; vertex += 4) {
+        const u16* indices = boneIndices + vertex * influenceCount;
+        const f32* weights = boneWeights + vertex * influenceCount;
+
+        // Blend one influence of the four vertices at a time, with the bones transposed to structure-of-arrays (x, y, z, w)
+        __m128 firstReal[4], real[4], dual[4];
+        for (int i = 0; i < influenceCount; ++i) {
+            __m128 r[4], d[4];
+            for (int lane = 0; lane < 4; ++lane) {
+                const tdualquat<f32>& bone = bones[indices[lane * influenceCount + i]];
+                r[lane] = bone.real.simd();
+                d[lane] = bone.dual.simd();
+            }
+            _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+            _MM_TRANSPOSE4_PS(d[0], d[1], d[2], d[3]);
+
+            __m128 weight = _mm_setr_ps(weights[i], weights[influenceCount + i], weights[2 * influenceCount + i], weights[3 * influenceCount + i]);
+            if (i == 0) {
+                for (int c = 0; c < 4; ++c) {
+                    firstReal[c] = r[c];
+                    real[c] = _mm_mul_ps(r[c], weight);
+                    dual[c] = _mm_mul_ps(d[c], weight);
+                }
+                continue;
+            }
+
+            __m128 dotFirst = _mm_add_ps(_mm_add_ps(_mm_mul_ps(firstReal[0], r[0]), _mm_mul_ps(firstReal[1], r[1])),
+                                         _mm_add_ps(_mm_mul_ps(firstReal[2], r[2]), _mm_mul_ps(firstReal[3], r[3])));
+            weight = _mm_xor_ps(weight, _mm_and_ps(_mm_cmplt_ps(dotFirst, _mm_setzero_ps()), signMask));
+            for (int c = 0; c < 4; ++c) {
+                real[c] = _mm_add_ps(real[c], _mm_mul_ps(r[c], weight));
+                dual[c] = _mm_add_ps(dual[c], _mm_mul_ps(d[c], weight));
+            }
+        }
+
+        // Scale to unit length (see the scalar version)
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(real[0], real[0]), _mm_mul_ps(real[1], real[1])),
+                                    _mm_add_ps(_mm_mul_ps(real[2], real[2]), _mm_mul_ps(real[3], real[3])));
+        __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+        for (int c = 0; c < 4; ++c) {
+            real[c] = _mm_mul_ps(real[c], invLength);
+            dual[c] = _mm_mul_ps(dual[c], invLength);
+        }
+
+        // The translation is 2 * (w_r * v_d - w_d * v_r + cross(v_r, v_d)), see dualQuatTranslation
+        __m128 tx, ty, tz;
+        detail::cross3x4(real[0], real[1], real[2], dual[0], dual[1], dual[2], tx, ty, tz);
+        tx = _mm_add_ps(tx, _mm_sub_ps(_mm_mul_ps(real[3], dual[0]), _mm_mul_ps(dual[3], real[0])));
+        ty = _mm_add_ps(ty, _mm_sub_ps(_mm_mul_ps(real[3], dual[1]), _mm_mul_ps(dual[3], real[1])));
+        tz = _mm_add_ps(tz, _mm_sub_ps(_mm_mul_ps(real[3], dual[2]), _mm_mul_ps(dual[3], real[2])));
+
+        __m128 x, y, z;
+        detail::loadVec3x4(positions + vertex, x, y, z);
+        detail::rotateVec3x4(real, real[3], x, y, z);
+        x = _mm_add_ps(x, _mm_add_ps(tx, tx));
+        y = _mm_add_ps(y, _mm_add_ps(ty, ty));
+        z = _mm_add_ps(z, _mm_add_ps(tz, tz));
+        detail::storeVec3x4(x, y, z, skinnedPositions + vertex);
+
+        if (normals && skinnedNormals) {
+            detail::loadVec3x4(normals + vertex, x, y, z);
+            detail::rotateVec3x4(real, real[3], x, y, z);
+            detail::storeVec3x4(x, y, z, skinnedNormals + vertex);
+        }
+    }
+
+    detail::skinDualQuatVertices(bones, boneIndices + vertex * influenceCount, boneWeights + vertex * influenceCount, influenceCount,
+                                 positions + vertex, normals ? normals + vertex : nullptr, vertexCount - vertex,
+                                 skinnedPositions + vertex, skinnedNormals ? skinnedNormals + vertex : nullptr);
+}
+
+#endif
+
+} // namespace moos
+
+#ifndef MOOS_DONT_EXPOSE_COMMON_MATH_TYPES
+using dualquat = moos::dualquat;
+#endif
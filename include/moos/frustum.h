@@ -0,0 +1,421 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "aabb.h"
+#include "core.h"
+#include "cpu.h"
+#include "matrix.h"
+#include "transform.h"
+#include "vector.h"
+
+#include <limits> // for std::numeric_limits
+
+namespace moos {
+
+// The plane of all points p where dot(normal, p) + distance = 0. For a unit length normal, distance is the signed
+// distance from the plane to the origin, and the signed distance of a point is positive on the side the normal points to.
+struct plane3 {
+    vec3 normal;
+    Float distance;
+
+    explicit plane3(vec3 normal = vec3(0, 1, 0), Float distance = static_cast<Float>(0))
+        : normal(normal)
+        , distance(distance)
+    {
+    }
+
+    // From the plane equation coefficients (a, b, c, d), i.e., ax + by + cz + d = 0
+    explicit plane3(const vec4& coefficients)
+        : normal(coefficients.xyz())
+        , distance(coefficients.w)
+    {
+    }
+
+    Float signedDistance(const vec3& point) const
+    {
+        return dot(normal, point) + distance;
+    }
+};
+
+inline plane3 planeFromPointAndNormal(const vec3& point, const vec3& normal)
+{
+    return plane3(normal, -dot(normal, point));
+}
+
+inline plane3 normalize(const plane3& plane)
+{
+    // A plane with a zero normal, e.g. the far plane of an infinite far projection, can't be normalized. It contains
+    // either all points or no points depending on the sign of distance, so just keep that.
+    Float length2 = dot(plane.normal, plane.normal);
+    if (length2 <= static_cast<Float>(0)) {
+        return plane3(vec3(static_cast<Float>(0)), (plane.distance >= static_cast<Float>(0)) ? static_cast<Float>(1) : static_cast<Float>(-1));
+    }
+    Float invLength = static_cast<Float>(1) / std::sqrt(length2);
+    return plane3(plane.normal * invLength, plane.distance * invLength);
+}
+
+// Intersection point of three planes, which must not be parallel
+inline vec3 intersectPlanes(const plane3& a, const plane3& b, const plane3& c)
+{
+    vec3 bc = cross(b.normal, c.normal);
+    vec3 ca = cross(c.normal, a.normal);
+    vec3 ab = cross(a.normal, b.normal);
+    Float denominator = dot(a.normal, bc);
+    return -(bc * a.distance + ca * b.distance + ab * c.distance) / denominator;
+}
+
+enum class Containment {
+    Outside,
+    Intersecting,
+    Inside
+};
+
+// A convex volume bounded by six planes with normals pointing inwards, e.g. the view volume of a camera. The planes are
+// stored as structure-of-arrays and padded to eight planes (which contain everything), so that all the tests are a few
+// SIMD operations for f32. The tests are conservative, i.e., volumes which are classified as Intersecting can be outside
+// the frustum if they are close to one of its corners (which is fine for culling).
+struct frustum {
+    enum PlaneIndex {
+        Left = 0,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        PlaneCount
+    };
+
+    alignas(16) Float normalX[8];
+    alignas(16) Float normalY[8];
+    alignas(16) Float normalZ[8];
+    alignas(16) Float distance[8];
+
+    // World space corners, in the order near (bottom left, bottom right, top left, top right) and then far, where left,
+    // bottom etc. refer to clip space (so e.g. bottom is up for the Vulkan projections, which flip y). The far corners are
+    // not defined (NaN) for projections with an infinite far plane.
+    vec3 corners[8];
+
+    // Frustum of a view-projection matrix (or the view space frustum of a projection matrix). Use ZeroToOne for all of
+    // the Vulkan projections in transform.h, including reverse-Z (where the near & far planes are swapped).
+    explicit frustum(const mat4& viewProjection, OrthographicProjectionDepthMode depthMode = OrthographicProjectionDepthMode::ZeroToOne)
+    {
+        // The planes are combinations of the rows of the matrix (Gribb & Hartmann)
+        mat4 rows = transpose(viewProjection);
+        vec4 coefficients[PlaneCount] = {
+            rows.w + rows.x,
+            rows.w - rows.x,
+            rows.w + rows.y,
+            rows.w - rows.y,
+            (depthMode == OrthographicProjectionDepthMode::ZeroToOne) ? rows.z : rows.w + rows.z,
+            rows.w - rows.z
+        };
+
+        plane3 planes[PlaneCount];
+        for (int i = 0; i < PlaneCount; ++i) {
+            planes[i] = normalize(plane3(coefficients[i]));
+            setPlane(i, planes[i]);
+        }
+        // Pad the SIMD lanes with planes that everything is far inside of, so they never make a sphere intersecting
+        for (int i = PlaneCount; i < 8; ++i) {
+            setPlane(i, plane3(vec3(static_cast<Float>(0)), std::numeric_limits<Float>::max()));
+        }
+
+        for (int i = 0; i < 8; ++i) {
+            const plane3& x = planes[(i & 1) ? Right : Left];
+            const plane3& y = planes[(i & 2) ? Top : Bottom];
+            const plane3& z = planes[(i & 4) ? Far : Near];
+            corners[i] = intersectPlanes(x, y, z);
+        }
+    }
+
+    plane3 plane(int index) const
+    {
+        MOOS_ASSERT(index >= 0 && index < PlaneCount);
+        return plane3(vec3(normalX[index], normalY[index], normalZ[index]), distance[index]);
+    }
+
+    void setPlane(int index, const plane3& plane)
+    {
+        normalX[index] = plane.normal.x;
+        normalY[index] = plane.normal.y;
+        normalZ[index] = plane.normal.z;
+        distance[index] = plane.distance;
+    }
+
+    bool contains(const vec3& point) const
+    {
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+        __m128 outside = _mm_setzero_ps();
+        for (int i = 0; i < 8; i += 4) {
+            __m128 d = signedDistances4(i, _mm_set1_ps(point.x), _mm_set1_ps(point.y), _mm_set1_ps(point.z));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+        }
+        return _mm_movemask_ps(outside) == 0;
+#else
+        for (int i = 0; i < PlaneCount; ++i) {
+            if (plane(i).signedDistance(point) < static_cast<Float>(0)) {
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+    Containment classify(const vec3& sphereCenter, Float sphereRadius) const
+    {
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+        __m128 radius = _mm_set1_ps(sphereRadius);
+        __m128 outside = _mm_setzero_ps();
+        __m128 intersecting = _mm_setzero_ps();
+        for (int i = 0; i < 8; i += 4) {
+            __m128 d = signedDistances4(i, _mm_set1_ps(sphereCenter.x), _mm_set1_ps(sphereCenter.y), _mm_set1_ps(sphereCenter.z));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_sub_ps(_mm_setzero_ps(), radius)));
+            intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(d, radius));
+        }
+        return classification(_mm_movemask_ps(outside), _mm_movemask_ps(intersecting));
+#else
+        bool intersecting = false;
+        for (int i = 0; i < PlaneCount; ++i) {
+            Float d = plane(i).signedDistance(sphereCenter);
+            if (d < -sphereRadius) {
+                return Containment::Outside;
+            }
+            intersecting |= d < sphereRadius;
+        }
+        return intersecting ? Containment::Intersecting : Containment::Inside;
+#endif
+    }
+
+    Containment classify(const aabb3& box) const
+    {
+        // Compare the distance of the center to how far the box reaches in the direction of the plane normal
+        vec3 center = (box.min + box.max) * static_cast<Float>(0.5);
+        vec3 extent = (box.max - box.min) * static_cast<Float>(0.5);
+
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 outside = _mm_setzero_ps();
+        __m128 intersecting = _mm_setzero_ps();
+        for (int i = 0; i < 8; i += 4) {
+            __m128 d = signedDistances4(i, _mm_set1_ps(center.x), _mm_set1_ps(center.y), _mm_set1_ps(center.z));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, _mm_load_ps(normalX + i)), _mm_set1_ps(extent.x)),
+                                                 _mm_mul_ps(_mm_andnot_ps(signMask, _mm_load_ps(normalY + i)), _mm_set1_ps(extent.y))),
+                                      _mm_mul_ps(_mm_andnot_ps(signMask, _mm_load_ps(normalZ + i)), _mm_set1_ps(extent.z)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_sub_ps(_mm_setzero_ps(), reach)));
+            intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(d, reach));
+        }
+        return classification(_mm_movemask_ps(outside), _mm_movemask_ps(intersecting));
+#else
+        bool intersecting = false;
+        for (int i = 0; i < PlaneCount; ++i) {
+            Float d = normalX[i] * center.x + normalY[i] * center.y + normalZ[i] * center.z + distance[i];
+            Float reach = std::abs(normalX[i]) * extent.x + std::abs(normalY[i]) * extent.y + std::abs(normalZ[i]) * extent.z;
+            if (d < -reach) {
+                return Containment::Outside;
+            }
+            intersecting |= d < reach;
+        }
+        return intersecting ? Containment::Intersecting : Containment::Inside;
+#endif
+    }
+
+    // Classifies count spheres, the same as classify(sphereCenters[i], sphereRadii[i]) but with the f32 version dispatched
+    // to the best kernel for the CPU (see cpu.h), e.g. eight spheres at a time with AVX2. The kernels use fused multiply-adds
+    // where available, so spheres touching a plane (to within rounding) may be classified differently between CPUs.
+    void classifyBatch(const vec3* sphereCenters, const Float* sphereRadii, Containment* result, size_t count) const;
+
+    // Classifies the other frustum using its corners, so it must have a finite far plane
+    Containment classify(const frustum& other) const
+    {
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+        // For each plane, track if all corners are outside & if any corner is outside
+        __m128 allOutside[2] = { _mm_castsi128_ps(_mm_set1_epi32(-1)), _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+        __m128 anyOutside = _mm_setzero_ps();
+        for (const vec3& corner : other.corners) {
+            for (int i = 0; i < 8; i += 4) {
+                __m128 d = signedDistances4(i, _mm_set1_ps(corner.x), _mm_set1_ps(corner.y), _mm_set1_ps(corner.z));
+                __m128 isOutside = _mm_cmplt_ps(d, _mm_setzero_ps());
+                allOutside[i / 4] = _mm_and_ps(allOutside[i / 4], isOutside);
+                anyOutside = _mm_or_ps(anyOutside, isOutside);
+            }
+        }
+        return classification(_mm_movemask_ps(_mm_or_ps(allOutside[0], allOutside[1])), _mm_movemask_ps(anyOutside));
+#else
+        bool intersecting = false;
+        for (int i = 0; i < PlaneCount; ++i) {
+            int outsideCount = 0;
+            for (const vec3& corner : other.corners) {
+                outsideCount += plane(i).signedDistance(corner) < static_cast<Float>(0) ? 1 : 0;
+            }
+            if (outsideCount == 8) {
+                return Containment::Outside;
+            }
+            intersecting |= outsideCount > 0;
+        }
+        return intersecting ? Containment::Intersecting : Containment::Inside;
+#endif
+    }
+
+private:
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+    __m128 signedDistances4(int firstPlane, __m128 x, __m128 y, __m128 z) const
+    {
+        __m128 d = _mm_add_ps(_mm_mul_ps(_mm_load_ps(normalX + firstPlane), x), _mm_mul_ps(_mm_load_ps(normalY + firstPlane), y));
+        return _mm_add_ps(_mm_add_ps(d, _mm_mul_ps(_mm_load_ps(normalZ + firstPlane), z)), _mm_load_ps(distance + firstPlane));
+    }
+
+    static Containment classification(int outsideMask, int intersectingMask)
+    {
+        if (outsideMask != 0) {
+            return Containment::Outside;
+        }
+        return (intersectingMask != 0) ? Containment::Intersecting : Containment::Inside;
+    }
+#endif
+};
+
+namespace detail {
+
+    inline void classifySpheresScalar(const frustum& f, const vec3* centers, const Float* radii, Containment* result, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            Containment containment = Containment::Inside;
+            for (int p = 0; p < frustum::PlaneCount; ++p) {
+                Float d = f.normalX[p] * centers[i].x + f.normalY[p] * centers[i].y + f.normalZ[p] * centers[i].z + f.distance[p];
+                if (d < -radii[i]) {
+                    containment = Containment::Outside;
+                    break;
+                }
+                if (d < radii[i]) {
+                    containment = Containment::Intersecting;
+                }
+            }
+            result[i] = containment;
+        }
+    }
+
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+
+    inline void storeContainments(unsigned outsideMask, unsigned intersectingMask, int count, Containment* result)
+    {
+        for (int i = 0; i < count; ++i) {
+            result[i] = ((outsideMask >> i) & 1u) ? Containment::Outside
+                : ((intersectingMask >> i) & 1u)  ? Containment::Intersecting
+                                                  : Containment::Inside;
+        }
+    }
+
+    inline void classifySpheresSSE2(const frustum& f, const vec3* centers, const Float* radii, Containment* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 x, y, z;
+            deinterleaveVec3x4(centers + i, x, y, z);
+            __m128 radius = _mm_loadu_ps(radii + i);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+            __m128 outside = _mm_setzero_ps();
+            __m128 intersecting = _mm_setzero_ps();
+            for (int p = 0; p < frustum::PlaneCount; ++p) {
+                __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f.normalX[p]), x), _mm_mul_ps(_mm_set1_ps(f.normalY[p]), y));
+                d = _mm_add_ps(_mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(f.normalZ[p]), z)), _mm_set1_ps(f.distance[p]));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negativeRadius));
+                intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(d, radius));
+            }
+            storeContainments(_mm_movemask_ps(outside), _mm_movemask_ps(intersecting), 4, result + i);
+        }
+        classifySpheresScalar(f, centers + i, radii + i, result + i, count - i);
+    }
+
+#endif
+
+#if defined(MOOS_DISPATCH) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+
+    MOOS_TARGET_AVX2 inline void classifySpheresAVX2(const frustum& f, const vec3* centers, const Float* radii, Containment* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 x, y, z;
+            deinterleaveVec3x8(centers + i, x, y, z);
+            __m256 radius = _mm256_loadu_ps(radii + i);
+            __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+            __m256 outside = _mm256_setzero_ps();
+            __m256 intersecting = _mm256_setzero_ps();
+            for (int p = 0; p < frustum::PlaneCount; ++p) {
+                __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(f.normalX[p]), x, _mm256_set1_ps(f.distance[p]));
+                d = _mm256_fmadd_ps(_mm256_set1_ps(f.normalY[p]), y, d);
+                d = _mm256_fmadd_ps(_mm256_set1_ps(f.normalZ[p]), z, d);
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, negativeRadius, _CMP_LT_OQ));
+                intersecting = _mm256_or_ps(intersecting, _mm256_cmp_ps(d, radius, _CMP_LT_OQ));
+            }
+            storeContainments(_mm256_movemask_ps(outside), _mm256_movemask_ps(intersecting), 8, result + i);
+        }
+        classifySpheresSSE2(f, centers + i, radii + i, result + i, count - i);
+    }
+
+    MOOS_TARGET_AVX512 inline void classifySpheresAVX512(const frustum& f, const vec3* centers, const Float* radii, Containment* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m512 x, y, z;
+            deinterleaveVec3x16(centers + i, x, y, z);
+            __m512 radius = _mm512_loadu_ps(radii + i);
+            __m512 negativeRadius = _mm512_sub_ps(_mm512_setzero_ps(), radius);
+            __mmask16 outside = 0;
+            __mmask16 intersecting = 0;
+            for (int p = 0; p < frustum::PlaneCount; ++p) {
+                __m512 d = _mm512_fmadd_ps(_mm512_set1_ps(f.normalX[p]), x, _mm512_set1_ps(f.distance[p]));
+                d = _mm512_fmadd_ps(_mm512_set1_ps(f.normalY[p]), y, d);
+                d = _mm512_fmadd_ps(_mm512_set1_ps(f.normalZ[p]), z, d);
+                outside |= _mm512_cmp_ps_mask(d, negativeRadius, _CMP_LT_OQ);
+                intersecting |= _mm512_cmp_ps_mask(d, radius, _CMP_LT_OQ);
+            }
+            storeContainments(outside, intersecting, 16, result + i);
+        }
+        classifySpheresAVX2(f, centers + i, radii + i, result + i, count - i);
+    }
+
+#endif
+
+} // namespace detail
+
+inline void frustum::classifyBatch(const vec3* sphereCenters, const Float* sphereRadii, Containment* result, size_t count) const
+{
+    using Kernel = void (*)(const frustum&, const vec3*, const Float*, Containment*, size_t);
+    static const KernelTable<Kernel> kernels = {
+        { SimdLevel::Scalar, detail::classifySpheresScalar },
+#if defined(MOOS_SSE) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+        { SimdLevel::SSE2, detail::classifySpheresSSE2 },
+#endif
+#if defined(MOOS_DISPATCH) && !defined(MOOS_USE_DOUBLE_BY_DEFAULT)
+        { SimdLevel::AVX2, detail::classifySpheresAVX2 },
+        { SimdLevel::AVX512, detail::classifySpheresAVX512 },
+#endif
+    };
+    kernels.select()(*this, sphereCenters, sphereRadii, result, count);
+}
+
+} // namespace moos
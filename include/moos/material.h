@@ -35,7 +35,11 @@ namespace material {
 
     Float schlickFresnel(Float F0, Float theta)
     {
+#ifdef MOOS_USE_DOUBLE_BY_DEFAULT
         Float p = 1.0 - std::cos(theta);
+#else
+        Float p = 1.0f - fast::cos(theta);
+#endif
         return F0 + (1.0 - F0) * (p * p * p * p * p);
     }
 
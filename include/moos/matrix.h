@@ -67,28 +67,28 @@ template<typename T>
 struct tmat3<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     tvec3<T> x, y, z;
 
-    explicit tmat3(T d = static_cast<T>(1.0)) noexcept
+    explicit constexpr tmat3(T d = static_cast<T>(1.0)) noexcept
         : x(d, static_cast<T>(0), static_cast<T>(0))
         , y(static_cast<T>(0), d, static_cast<T>(0))
         , z(static_cast<T>(0), static_cast<T>(0), d)
     {
     }
 
-    tmat3(tvec3<T> x, tvec3<T> y, tvec3<T> z) noexcept
+    constexpr tmat3(tvec3<T> x, tvec3<T> y, tvec3<T> z) noexcept
         : x(x)
         , y(y)
         , z(z)
     {
     }
 
-    explicit tmat3(const tmat4<T>& m) noexcept
+    explicit constexpr tmat3(const tmat4<T>& m) noexcept
         : x(m.x.xyz())
         , y(m.y.xyz())
         , z(m.z.xyz())
     {
     }
 
-    tvec3<T>& operator[](int index)
+    constexpr tvec3<T>& operator[](int index)
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 3);
@@ -96,7 +96,7 @@ struct tmat3<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *v[index];
     }
 
-    const tvec3<T>& operator[](int index) const
+    constexpr const tvec3<T>& operator[](int index) const
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 3);
@@ -160,7 +160,7 @@ constexpr tmat3<T> inverse(const tmat3<T>& m)
     // This function is a rewritten version of  https://stackoverflow.com/a/18504573
 
     T det = determinant(m);
-    if (std::abs(det) < std::numeric_limits<T>::epsilon()) {
+    if (cx::abs(det) < std::numeric_limits<T>::epsilon()) {
         MOOS_ON_BAD_DETERMINANT_IN_MATRIX_INVERSE();
     }
     T invDet = static_cast<T>(1) / det;
@@ -190,7 +190,7 @@ template<typename T>
 struct tmat4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     tvec4<T> x, y, z, w;
 
-    explicit tmat4(T d = static_cast<T>(1)) noexcept
+    explicit constexpr tmat4(T d = static_cast<T>(1)) noexcept
         : x(d, static_cast<T>(0), static_cast<T>(0), static_cast<T>(0))
         , y(static_cast<T>(0), d, static_cast<T>(0), static_cast<T>(0))
         , z(static_cast<T>(0), static_cast<T>(0), d, static_cast<T>(0))
@@ -198,7 +198,7 @@ struct tmat4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     {
     }
 
-    tmat4(tvec4<T> x, tvec4<T> y, tvec4<T> z, tvec4<T> w) noexcept
+    constexpr tmat4(tvec4<T> x, tvec4<T> y, tvec4<T> z, tvec4<T> w) noexcept
         : x(x)
         , y(y)
         , z(z)
@@ -206,7 +206,7 @@ struct tmat4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     {
     }
 
-    explicit tmat4(const tmat3<T>& m) noexcept
+    explicit constexpr tmat4(const tmat3<T>& m) noexcept
         : x(m.x, 0)
         , y(m.y, 0)
         , z(m.z, 0)
@@ -214,7 +214,7 @@ struct tmat4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     {
     }
 
-    tvec4<T>& operator[](int index)
+    constexpr tvec4<T>& operator[](int index)
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 4);
@@ -222,7 +222,7 @@ struct tmat4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *v[index];
     }
 
-    const tvec4<T>& operator[](int index) const
+    constexpr const tvec4<T>& operator[](int index) const
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 4);
@@ -280,8 +280,8 @@ constexpr tmat4<T> inverse(const tmat4<T>& m)
 {
     // This function is a rewritten version of mat4x4_invert https://github.com/datenwolf/linmath.h
 
-    T s[6];
-    T c[6];
+    T s[6] {};
+    T c[6] {};
 
     s[0] = m.x.x * m.y.y - m.y.x * m.x.y;
     s[1] = m.x.x * m.y.z - m.y.x * m.x.z;
@@ -298,7 +298,7 @@ constexpr tmat4<T> inverse(const tmat4<T>& m)
     c[5] = m.z.z * m.w.w - m.w.z * m.z.w;
 
     T det = s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
-    if (std::abs(det) < std::numeric_limits<T>::epsilon()) {
+    if (cx::abs(det) < std::numeric_limits<T>::epsilon()) {
         MOOS_ON_BAD_DETERMINANT_IN_MATRIX_INVERSE();
     }
     T invDet = static_cast<T>(1) / det;
@@ -336,14 +336,14 @@ template<typename T>
 struct tmat3x4 {
     tvec4<T> x, y, z;
 
-    tmat3x4() noexcept
+    constexpr tmat3x4() noexcept
         : x()
         , y()
         , z()
     {
     }
 
-    tmat3x4(const tmat4<T>& m) noexcept
+    constexpr tmat3x4(const tmat4<T>& m) noexcept
         : x(m.x)
         , y(m.y)
         , z(m.z)
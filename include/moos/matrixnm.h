@@ -0,0 +1,460 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "core.h"
+#include "matrix.h"
+#include "vector.h"
+
+namespace moos {
+
+// Matrices of any small size, with N rows and M columns, stored column-major (like tmat3 & tmat4) as tvecN columns, so
+// that the column operations auto-vectorize. Larger systems (up to ~64x64) are fine, but keep in mind that the whole
+// matrix is stored inline. For square systems of a size only known at runtime, use the in-place solvers further down.
+template<size_t N, size_t M, typename T>
+struct tmatNM {
+    static_assert(std::is_arithmetic<T>::value, "tmatNM is only defined for arithmetic types");
+
+    static constexpr size_t rowCount = N;
+    static constexpr size_t columnCount = M;
+    tvecN<N, T> columns[M];
+
+    // The identity by default, like tmat3 & tmat4 (also for non-square matrices)
+    constexpr tmatNM() noexcept
+        : tmatNM(static_cast<T>(1))
+    {
+    }
+
+    // Diagonal matrix
+    explicit constexpr tmatNM(T d) noexcept
+        : columns {}
+    {
+        for (size_t i = 0; i < N && i < M; ++i) {
+            columns[i].elements[i] = d;
+        }
+    }
+
+    template<size_t R = N, size_t C = M, typename = typename std::enable_if<R == 3 && C == 3>::type>
+    explicit constexpr tmatNM(const tmat3<T>& m) noexcept
+        : columns { tvecN<3, T>(m.x), tvecN<3, T>(m.y), tvecN<3, T>(m.z) }
+    {
+    }
+
+    template<size_t R = N, size_t C = M, typename = typename std::enable_if<R == 4 && C == 4>::type>
+    explicit constexpr tmatNM(const tmat4<T>& m) noexcept
+        : columns { tvecN<4, T>(m.x), tvecN<4, T>(m.y), tvecN<4, T>(m.z), tvecN<4, T>(m.w) }
+    {
+    }
+
+    // (tmat3x4 stores the first three columns of a tmat4, so it's a 4x3 matrix)
+    template<size_t R = N, size_t C = M, typename = typename std::enable_if<R == 4 && C == 3>::type>
+    explicit constexpr tmatNM(const tmat3x4<T>& m) noexcept
+        : columns { tvecN<4, T>(m.x), tvecN<4, T>(m.y), tvecN<4, T>(m.z) }
+    {
+    }
+
+    // Loads the matrix from N * M column-major values
+    static tmatNM load(const T* values)
+    {
+        tmatNM m;
+        for (size_t j = 0; j < M; ++j) {
+            m.columns[j] = tvecN<N, T>::load(values + j * N);
+        }
+        return m;
+    }
+
+    void store(T* values) const
+    {
+        for (size_t j = 0; j < M; ++j) {
+            columns[j].store(values + j * N);
+        }
+    }
+
+    // All N * M values in column-major order, e.g. for the in-place solvers
+    T* data()
+    {
+        static_assert(sizeof(tmatNM) == N * M * sizeof(T), "the columns must be contiguous");
+        return reinterpret_cast<T*>(this);
+    }
+
+    const T* data() const
+    {
+        static_assert(sizeof(tmatNM) == N * M * sizeof(T), "the columns must be contiguous");
+        return reinterpret_cast<const T*>(this);
+    }
+
+    constexpr tvecN<N, T>& operator[](int column)
+    {
+        MOOS_ASSERT(column >= 0);
+        MOOS_ASSERT(column < static_cast<int>(M));
+        return columns[column];
+    }
+
+    constexpr const tvecN<N, T>& operator[](int column) const
+    {
+        MOOS_ASSERT(column >= 0);
+        MOOS_ASSERT(column < static_cast<int>(M));
+        return columns[column];
+    }
+
+    constexpr T& operator()(size_t row, size_t column)
+    {
+        MOOS_ASSERT(row < N && column < M);
+        return columns[column].elements[row];
+    }
+
+    constexpr const T& operator()(size_t row, size_t column) const
+    {
+        MOOS_ASSERT(row < N && column < M);
+        return columns[column].elements[row];
+    }
+
+    constexpr bool operator==(const tmatNM& other) const
+    {
+        for (size_t j = 0; j < M; ++j) {
+            if (columns[j] != other.columns[j]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator!=(const tmatNM& other) const { return !(*this == other); }
+
+    constexpr tmatNM operator+(const tmatNM& other) const
+    {
+        tmatNM res;
+        for (size_t j = 0; j < M; ++j) {
+            res.columns[j] = columns[j] + other.columns[j];
+        }
+        return res;
+    }
+
+    constexpr tmatNM operator-(const tmatNM& other) const
+    {
+        tmatNM res;
+        for (size_t j = 0; j < M; ++j) {
+            res.columns[j] = columns[j] - other.columns[j];
+        }
+        return res;
+    }
+
+    constexpr tmatNM operator*(T f) const
+    {
+        tmatNM res;
+        for (size_t j = 0; j < M; ++j) {
+            res.columns[j] = columns[j] * f;
+        }
+        return res;
+    }
+};
+
+template<size_t N, size_t M, typename T>
+constexpr tmatNM<N, M, T> operator*(T lhs, const tmatNM<N, M, T>& rhs)
+{
+    return rhs * lhs;
+}
+
+template<size_t N, size_t M, typename T>
+constexpr tvecN<N, T> operator*(const tmatNM<N, M, T>& m, const tvecN<M, T>& v)
+{
+    tvecN<N, T> res = m.columns[0] * v.elements[0];
+    for (size_t k = 1; k < M; ++k) {
+        res += m.columns[k] * v.elements[k];
+    }
+    return res;
+}
+
+// Each result column is a combination of the columns of lhs, computed four result columns at a time so that each column
+// of lhs is loaded once per block and the accumulators stay in registers (for up to 8x8 f32 with AVX, or 16x16 with
+// AVX-512), with the row dimension vectorized
+template<size_t N, size_t K, size_t M, typename T>
+constexpr tmatNM<N, M, T> operator*(const tmatNM<N, K, T>& lhs, const tmatNM<K, M, T>& rhs)
+{
+    tmatNM<N, M, T> res { static_cast<T>(0) };
+    size_t j = 0;
+    for (; j + 4 <= M; j += 4) {
+        tvecN<N, T> acc0 = lhs.columns[0] * rhs.columns[j + 0].elements[0];
+        tvecN<N, T> acc1 = lhs.columns[0] * rhs.columns[j + 1].elements[0];
+        tvecN<N, T> acc2 = lhs.columns[0] * rhs.columns[j + 2].elements[0];
+        tvecN<N, T> acc3 = lhs.columns[0] * rhs.columns[j + 3].elements[0];
+        for (size_t k = 1; k < K; ++k) {
+            const tvecN<N, T>& column = lhs.columns[k];
+            acc0 += column * rhs.columns[j + 0].elements[k];
+            acc1 += column * rhs.columns[j + 1].elements[k];
+            acc2 += column * rhs.columns[j + 2].elements[k];
+            acc3 += column * rhs.columns[j + 3].elements[k];
+        }
+        res.columns[j + 0] = acc0;
+        res.columns[j + 1] = acc1;
+        res.columns[j + 2] = acc2;
+        res.columns[j + 3] = acc3;
+    }
+    for (; j < M; ++j) {
+        res.columns[j] = lhs * rhs.columns[j];
+    }
+    return res;
+}
+
+template<size_t N, size_t M, typename T>
+constexpr tmatNM<M, N, T> transpose(const tmatNM<N, M, T>& m)
+{
+    tmatNM<M, N, T> res { static_cast<T>(0) };
+    for (size_t j = 0; j < M; ++j) {
+        for (size_t i = 0; i < N; ++i) {
+            res.columns[i].elements[j] = m.columns[j].elements[i];
+        }
+    }
+    return res;
+}
+
+// In-place solvers for square systems, on column-major n x n matrices of any (runtime) size. These are what the tmatNM
+// decompositions below use, and they don't allocate.
+
+// LU decomposition with partial pivoting, where row i was swapped with row pivots[i] at step i. The unit lower and upper
+// triangular factors are stored in place of the matrix. Returns false if the matrix is singular (i.e. a zero pivot).
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+bool luDecomposeInPlace(T* matrix, size_t n, size_t* pivots)
+{
+    bool nonSingular = true;
+    for (size_t k = 0; k < n; ++k) {
+        T* columnK = matrix + k * n;
+
+        size_t pivot = k;
+        for (size_t i = k + 1; i < n; ++i) {
+            if (cx::abs(columnK[i]) > cx::abs(columnK[pivot])) {
+                pivot = i;
+            }
+        }
+        pivots[k] = pivot;
+        if (pivot != k) {
+            for (size_t j = 0; j < n; ++j) {
+                std::swap(matrix[j * n + k], matrix[j * n + pivot]);
+            }
+        }
+
+        if (columnK[k] == static_cast<T>(0)) {
+            nonSingular = false;
+            continue;
+        }
+
+        T invPivot = static_cast<T>(1) / columnK[k];
+        for (size_t i = k + 1; i < n; ++i) {
+            columnK[i] *= invPivot;
+        }
+
+        // Update the trailing submatrix one column at a time (contiguous, so it vectorizes)
+        for (size_t j = k + 1; j < n; ++j) {
+            T* columnJ = matrix + j * n;
+            T factor = columnJ[k];
+            for (size_t i = k + 1; i < n; ++i) {
+                columnJ[i] -= columnK[i] * factor;
+            }
+        }
+    }
+    return nonSingular;
+}
+
+// Solves A x = b given the LU decomposition of A, overwriting b with x
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void luSolveInPlace(const T* lu, size_t n, const size_t* pivots, T* b)
+{
+    for (size_t k = 0; k < n; ++k) {
+        std::swap(b[k], b[pivots[k]]);
+    }
+
+    // Forward substitution with the unit lower triangle, and then backward substitution with the upper triangle, both
+    // column-oriented so the inner loops are contiguous
+    for (size_t k = 0; k < n; ++k) {
+        const T* column = lu + k * n;
+        for (size_t i = k + 1; i < n; ++i) {
+            b[i] -= column[i] * b[k];
+        }
+    }
+    for (size_t k = n; k-- > 0;) {
+        const T* column = lu + k * n;
+        b[k] /= column[k];
+        for (size_t i = 0; i < k; ++i) {
+            b[i] -= column[i] * b[k];
+        }
+    }
+}
+
+// Cholesky decomposition A = L L^T of a symmetric positive definite matrix, where L is stored in the lower triangle (and
+// the upper triangle is left as is). Only the lower triangle of the input is read. Returns false if the matrix isn't
+// positive definite.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+bool choleskyDecomposeInPlace(T* matrix, size_t n)
+{
+    for (size_t j = 0; j < n; ++j) {
+        T* columnJ = matrix + j * n;
+
+        // Subtract the contributions of the previous columns (left-looking)
+        for (size_t k = 0; k < j; ++k) {
+            const T* columnK = matrix + k * n;
+            T factor = columnK[j];
+            for (size_t i = j; i < n; ++i) {
+                columnJ[i] -= columnK[i] * factor;
+            }
+        }
+
+        if (!(columnJ[j] > static_cast<T>(0))) {
+            return false;
+        }
+        T diagonal = std::sqrt(columnJ[j]);
+        T invDiagonal = static_cast<T>(1) / diagonal;
+        columnJ[j] = diagonal;
+        for (size_t i = j + 1; i < n; ++i) {
+            columnJ[i] *= invDiagonal;
+        }
+    }
+    return true;
+}
+
+// Solves A x = b given the Cholesky decomposition of A, overwriting b with x
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void choleskySolveInPlace(const T* l, size_t n, T* b)
+{
+    // L y = b, column-oriented
+    for (size_t k = 0; k < n; ++k) {
+        const T* column = l + k * n;
+        b[k] /= column[k];
+        for (size_t i = k + 1; i < n; ++i) {
+            b[i] -= column[i] * b[k];
+        }
+    }
+    // L^T x = y, where the rows of L^T are the columns of L
+    for (size_t k = n; k-- > 0;) {
+        const T* column = l + k * n;
+        T sum = b[k];
+        for (size_t i = k + 1; i < n; ++i) {
+            sum -= column[i] * b[i];
+        }
+        b[k] = sum / column[k];
+    }
+}
+
+template<size_t N, typename T>
+struct tLUDecomposition {
+    tmatNM<N, N, T> lu { static_cast<T>(0) };
+    size_t pivots[N] {};
+    bool valid { false };
+
+    tvecN<N, T> solve(tvecN<N, T> b) const
+    {
+        MOOS_ASSERT(valid);
+        luSolveInPlace(lu.data(), N, pivots, b.elements);
+        return b;
+    }
+
+    T determinant() const
+    {
+        T det = static_cast<T>(1);
+        for (size_t i = 0; i < N; ++i) {
+            det *= (pivots[i] != i) ? -lu(i, i) : lu(i, i);
+        }
+        return det;
+    }
+};
+
+template<size_t N, typename T>
+struct tCholeskyDecomposition {
+    tmatNM<N, N, T> l { static_cast<T>(0) };
+    bool valid { false };
+
+    tvecN<N, T> solve(tvecN<N, T> b) const
+    {
+        MOOS_ASSERT(valid);
+        choleskySolveInPlace(l.data(), N, b.elements);
+        return b;
+    }
+};
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+tLUDecomposition<N, T> luDecompose(const tmatNM<N, N, T>& m)
+{
+    tLUDecomposition<N, T> res;
+    res.lu = m;
+    res.valid = luDecomposeInPlace(res.lu.data(), N, res.pivots);
+    return res;
+}
+
+// For symmetric positive definite matrices (e.g. inertia tensors or normal equations), only reading the lower triangle
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+tCholeskyDecomposition<N, T> choleskyDecompose(const tmatNM<N, N, T>& m)
+{
+    tCholeskyDecomposition<N, T> res;
+    res.l = m;
+    res.valid = choleskyDecomposeInPlace(res.l.data(), N);
+    for (size_t j = 1; j < N; ++j) {
+        for (size_t i = 0; i < j; ++i) {
+            res.l(i, j) = static_cast<T>(0);
+        }
+    }
+    return res;
+}
+
+// Solves m x = b, using LU decomposition with partial pivoting (or see luDecompose, to solve for several b)
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+tvecN<N, T> solve(const tmatNM<N, N, T>& m, const tvecN<N, T>& b)
+{
+    tLUDecomposition<N, T> lu = luDecompose(m);
+    if (!lu.valid) {
+        MOOS_ON_BAD_DETERMINANT_IN_MATRIX_INVERSE();
+    }
+    return lu.solve(b);
+}
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+T determinant(const tmatNM<N, N, T>& m)
+{
+    return luDecompose(m).determinant();
+}
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+tmatNM<N, N, T> inverse(const tmatNM<N, N, T>& m)
+{
+    tLUDecomposition<N, T> lu = luDecompose(m);
+    if (!lu.valid) {
+        MOOS_ON_BAD_DETERMINANT_IN_MATRIX_INVERSE();
+    }
+    tmatNM<N, N, T> res;
+    for (size_t j = 0; j < N; ++j) {
+        res.columns[j] = lu.solve(res.columns[j]);
+    }
+    return res;
+}
+
+template<size_t N, size_t M>
+using matNM = tmatNM<N, M, Float>;
+
+using mat2 = tmatNM<2, 2, Float>;
+using fmat2 = tmatNM<2, 2, f32>;
+using dmat2 = tmatNM<2, 2, f64>;
+using mat6 = tmatNM<6, 6, Float>;
+using fmat6 = tmatNM<6, 6, f32>;
+using dmat6 = tmatNM<6, 6, f64>;
+
+} // namespace moos
@@ -0,0 +1,363 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "aabb.h"
+#include "allocators.h"
+#include "core.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "vector.h"
+
+#include <utility> // for std::swap
+#include <vector> // for std::vector
+
+namespace moos {
+
+// A small software depth rasterizer for CPU occlusion culling. Occluder triangles are binned into screen tiles and then
+// rasterized per tile into a low-resolution depth buffer, with a max depth per 8x8 block as a second hierarchy level.
+// Occludees (i.e. bounding boxes) are then tested against it, first against the blocks and then per pixel if needed.
+//
+// Usage per frame: clear(), addOccluders(...) for all occluders, rasterizeTile(i) for all tiles (or just rasterize()),
+// and then isVisible(...) for all occludees. The tiles write to disjoint parts of the buffers, so rasterizeTile can be
+// called for different tiles in parallel, and isVisible can be called in parallel once all tiles are rasterized.
+//
+// The projections must have depth in range [0, 1], i.e. the Vulkan projections in transform.h, optionally reverse-Z.
+// All tests are conservative in the sense that an occludee is only reported as not visible if it really is occluded by
+// the rasterized occluders (up to depth precision and the pixel-center sampling of the occluders).
+class OcclusionBuffer {
+public:
+    static constexpr int TileSize = 32;
+    static constexpr int BlockSize = 8;
+
+    OcclusionBuffer(int width, int height, bool reverseZ = false)
+        : m_width(width)
+        , m_height(height)
+        , m_tilesX(width / TileSize)
+        , m_tilesY(height / TileSize)
+        , m_reverseZ(reverseZ)
+    {
+        MOOS_ASSERT(width > 0 && height > 0 && width % TileSize == 0 && height % TileSize == 0);
+        m_depth.resize(static_cast<size_t>(width) * height);
+        m_blockMaxDepth.resize(static_cast<size_t>(width / BlockSize) * (height / BlockSize));
+        m_tileBins.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+        clear();
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int tileCount() const { return m_tilesX * m_tilesY; }
+
+    // Depth of the rasterized occluders at the pixel, in range [0, 1] where 0 is nearest (also for reverse-Z)
+    f32 depthAt(int x, int y) const
+    {
+        return m_depth[static_cast<size_t>(y) * m_width + x];
+    }
+
+    void clear()
+    {
+        std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+        std::fill(m_blockMaxDepth.begin(), m_blockMaxDepth.end(), 1.0f);
+        for (std::vector<u32>& bin : m_tileBins) {
+            bin.clear();
+        }
+        m_triangles.clear();
+    }
+
+    // Transforms, clips (against the near plane), and bins the indexed occluder triangles. Both windings are rasterized,
+    // since which one is front-facing depends on the projection. Not thread-safe.
+    void addOccluders(const vec3* vertices, const u32* indices, size_t triangleCount, const mat4& modelViewProjection)
+    {
+        for (size_t t = 0; t < triangleCount; ++t) {
+            ClipVertex clipVertices[3];
+            for (int i = 0; i < 3; ++i) {
+                vec4 clip = modelViewProjection * vec4(vertices[indices[3 * t + i]], static_cast<Float>(1));
+                clipVertices[i] = { static_cast<f32>(clip.x), static_cast<f32>(clip.y), static_cast<f32>(clip.z), static_cast<f32>(clip.w) };
+            }
+            addClippedTriangle(clipVertices);
+        }
+    }
+
+    void rasterizeTile(int tileIndex)
+    {
+        int tileX = (tileIndex % m_tilesX) * TileSize;
+        int tileY = (tileIndex / m_tilesX) * TileSize;
+
+        for (u32 triangleIndex : m_tileBins[tileIndex]) {
+            rasterizeTriangleInTile(m_triangles[triangleIndex], tileX, tileY);
+        }
+
+        // Update the block level of the hierarchy
+        for (int by = tileY; by < tileY + TileSize; by += BlockSize) {
+            for (int bx = tileX; bx < tileX + TileSize; bx += BlockSize) {
+                f32 maxDepth = 0.0f;
+                for (int y = by; y < by + BlockSize; ++y) {
+                    const f32* row = m_depth.data() + static_cast<size_t>(y) * m_width;
+                    for (int x = bx; x < bx + BlockSize; ++x) {
+                        maxDepth = std::max(maxDepth, row[x]);
+                    }
+                }
+                m_blockMaxDepth[static_cast<size_t>(by / BlockSize) * (m_width / BlockSize) + bx / BlockSize] = maxDepth;
+            }
+        }
+    }
+
+    // Rasterizes all tiles, in parallel using the task scheduler (see parallel.h) since tiles don't share any pixels
+    void rasterize()
+    {
+        parallelFor(0, static_cast<size_t>(tileCount()), 1, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                rasterizeTile(static_cast<int>(i));
+            }
+        });
+    }
+
+    // Returns false if the box is occluded by the rasterized occluders, or outside the screen
+    bool isVisible(const aabb3& box, const mat4& viewProjection) const
+    {
+        f32 minX = static_cast<f32>(m_width);
+        f32 minY = static_cast<f32>(m_height);
+        f32 maxX = 0.0f;
+        f32 maxY = 0.0f;
+        f32 minDepth = 1.0f;
+
+        for (int i = 0; i < 8; ++i) {
+            vec3 corner = vec3((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            vec4 clip = viewProjection * vec4(corner, static_cast<Float>(1));
+            ClipVertex v = { static_cast<f32>(clip.x), static_cast<f32>(clip.y), static_cast<f32>(clip.z), static_cast<f32>(clip.w) };
+
+            // (boxes crossing the near plane are treated as visible)
+            if (nearPlaneDistance(v) < 0.0f || v.w <= 0.0f) {
+                return true;
+            }
+
+            ScreenVertex s = toScreen(v);
+            minX = std::min(minX, s.x);
+            minY = std::min(minY, s.y);
+            maxX = std::max(maxX, s.x);
+            maxY = std::max(maxY, s.y);
+            minDepth = std::min(minDepth, s.z);
+        }
+
+        // All pixels which the box touches, not just the ones with the center inside
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+        int x1 = std::min(m_width - 1, static_cast<int>(std::floor(maxX)));
+        int y1 = std::min(m_height - 1, static_cast<int>(std::floor(maxY)));
+        if (x0 > x1 || y0 > y1) {
+            return false;
+        }
+
+        for (int by = y0 / BlockSize; by <= y1 / BlockSize; ++by) {
+            for (int bx = x0 / BlockSize; bx <= x1 / BlockSize; ++bx) {
+                if (minDepth > m_blockMaxDepth[static_cast<size_t>(by) * (m_width / BlockSize) + bx]) {
+                    continue;
+                }
+                for (int y = std::max(y0, by * BlockSize); y <= std::min(y1, by * BlockSize + BlockSize - 1); ++y) {
+                    for (int x = std::max(x0, bx * BlockSize); x <= std::min(x1, bx * BlockSize + BlockSize - 1); ++x) {
+                        if (minDepth <= depthAt(x, y)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+
+private:
+    struct ClipVertex {
+        f32 x, y, z, w;
+    };
+
+    struct ScreenVertex {
+        f32 x, y, z;
+    };
+
+    struct ScreenTriangle {
+        ScreenVertex v[3];
+    };
+
+    f32 nearPlaneDistance(const ClipVertex& v) const
+    {
+        return m_reverseZ ? v.w - v.z : v.z;
+    }
+
+    ScreenVertex toScreen(const ClipVertex& v) const
+    {
+        f32 invW = 1.0f / v.w;
+        f32 depth = v.z * invW;
+        return { (v.x * invW * 0.5f + 0.5f) * static_cast<f32>(m_width),
+                 (v.y * invW * 0.5f + 0.5f) * static_cast<f32>(m_height),
+                 m_reverseZ ? 1.0f - depth : depth };
+    }
+
+    void addClippedTriangle(const ClipVertex clipVertices[3])
+    {
+        // Clip against the near plane, which gives a polygon of up to 4 vertices
+        ClipVertex polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i) {
+            const ClipVertex& a = clipVertices[i];
+            const ClipVertex& b = clipVertices[(i + 1) % 3];
+            f32 da = nearPlaneDistance(a);
+            f32 db = nearPlaneDistance(b);
+            if (da >= 0.0f) {
+                polygon[count++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                f32 t = da / (da - db);
+                polygon[count++] = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+            }
+        }
+
+        for (int i = 1; i + 1 < count; ++i) {
+            ScreenTriangle triangle = { { toScreen(polygon[0]), toScreen(polygon[i]), toScreen(polygon[i + 1]) } };
+            binTriangle(triangle);
+        }
+    }
+
+    void binTriangle(ScreenTriangle triangle)
+    {
+        ScreenVertex& v0 = triangle.v[0];
+        ScreenVertex& v1 = triangle.v[1];
+        ScreenVertex& v2 = triangle.v[2];
+
+        // Use counter-clockwise winding (in the math sense) for all triangles, and skip degenerate ones
+        f32 area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (area == 0.0f || !std::isfinite(area)) {
+            return;
+        }
+        if (area < 0.0f) {
+            std::swap(v1, v2);
+        }
+
+        f32 minX = std::min(v0.x, std::min(v1.x, v2.x));
+        f32 minY = std::min(v0.y, std::min(v1.y, v2.y));
+        f32 maxX = std::max(v0.x, std::max(v1.x, v2.x));
+        f32 maxY = std::max(v0.y, std::max(v1.y, v2.y));
+        if (maxX < 0.0f || maxY < 0.0f || minX >= static_cast<f32>(m_width) || minY >= static_cast<f32>(m_height)) {
+            return;
+        }
+
+        int tx0 = std::max(0, static_cast<int>(minX) / TileSize);
+        int ty0 = std::max(0, static_cast<int>(minY) / TileSize);
+        int tx1 = std::min(m_tilesX - 1, static_cast<int>(std::min(maxX, static_cast<f32>(m_width - 1))) / TileSize);
+        int ty1 = std::min(m_tilesY - 1, static_cast<int>(std::min(maxY, static_cast<f32>(m_height - 1))) / TileSize);
+
+        u32 triangleIndex = static_cast<u32>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                m_tileBins[static_cast<size_t>(ty) * m_tilesX + tx].push_back(triangleIndex);
+            }
+        }
+    }
+
+    void rasterizeTriangleInTile(const ScreenTriangle& triangle, int tileX, int tileY)
+    {
+        const ScreenVertex& v0 = triangle.v[0];
+        const ScreenVertex& v1 = triangle.v[1];
+        const ScreenVertex& v2 = triangle.v[2];
+
+        // Edge functions E(p) = a * (p.x - origin.x) + b * (p.y - origin.y), which are positive inside, and the depth plane.
+        // Relative to a vertex, since clipped triangles can have vertices far outside the screen.
+        f32 a[3], b[3], originX[3], originY[3];
+        const ScreenVertex* vertices[3] = { &v0, &v1, &v2 };
+        for (int i = 0; i < 3; ++i) {
+            const ScreenVertex& from = *vertices[i];
+            const ScreenVertex& to = *vertices[(i + 1) % 3];
+            a[i] = from.y - to.y;
+            b[i] = to.x - from.x;
+            originX[i] = from.x;
+            originY[i] = from.y;
+        }
+
+        f32 dx1 = v1.x - v0.x, dy1 = v1.y - v0.y, dz1 = v1.z - v0.z;
+        f32 dx2 = v2.x - v0.x, dy2 = v2.y - v0.y, dz2 = v2.z - v0.z;
+        f32 invArea = 1.0f / (dx1 * dy2 - dx2 * dy1);
+        f32 dzdx = (dz1 * dy2 - dz2 * dy1) * invArea;
+        f32 dzdy = (dz2 * dx1 - dz1 * dx2) * invArea;
+
+        // Bounding box of the triangle within the tile, with x aligned to 4 pixels for SIMD
+        int x0 = std::max(tileX, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))) & ~3);
+        int y0 = std::max(tileY, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+        int x1 = std::min(tileX + TileSize, static_cast<int>(std::max(v0.x, std::max(v1.x, v2.x))) + 1);
+        int y1 = std::min(tileY + TileSize, static_cast<int>(std::max(v0.y, std::max(v1.y, v2.y))) + 1);
+
+        for (int y = y0; y < y1; ++y) {
+            f32 py = static_cast<f32>(y) + 0.5f;
+            f32 rowE[3] = { b[0] * (py - originY[0]), b[1] * (py - originY[1]), b[2] * (py - originY[2]) };
+            f32 rowZ = v0.z + dzdy * (py - v0.y);
+            f32* row = m_depth.data() + static_cast<size_t>(y) * m_width;
+            int x = x0;
+
+#ifdef MOOS_SSE
+            // (the tile width is a multiple of 4, so it's fine to test a few pixels outside the bounding box)
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            for (; x < x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<f32>(x)), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), _mm_sub_ps(px, _mm_set1_ps(originX[0]))), _mm_set1_ps(rowE[0]));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), _mm_sub_ps(px, _mm_set1_ps(originX[1]))), _mm_set1_ps(rowE[1]));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), _mm_sub_ps(px, _mm_set1_ps(originX[2]))), _mm_set1_ps(rowE[2]));
+                __m128 inside = _mm_cmpge_ps(_mm_min_ps(e0, _mm_min_ps(e1, e2)), _mm_setzero_ps());
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), _mm_sub_ps(px, _mm_set1_ps(v0.x))), _mm_set1_ps(rowZ));
+                __m128 depth = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(nearer, z), _mm_andnot_ps(nearer, depth)));
+            }
+#endif
+
+            for (; x < x1; ++x) {
+                f32 px = static_cast<f32>(x) + 0.5f;
+                f32 e0 = a[0] * (px - originX[0]) + rowE[0];
+                f32 e1 = a[1] * (px - originX[1]) + rowE[1];
+                f32 e2 = a[2] * (px - originX[2]) + rowE[2];
+                if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                    f32 z = dzdx * (px - v0.x) + rowZ;
+                    row[x] = std::min(row[x], z);
+                }
+            }
+        }
+    }
+
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+    bool m_reverseZ;
+
+    AlignedVector<f32> m_depth {};
+    AlignedVector<f32> m_blockMaxDepth {};
+    std::vector<ScreenTriangle> m_triangles {};
+    std::vector<std::vector<u32>> m_tileBins {};
+};
+
+} // namespace moos
@@ -0,0 +1,330 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "core.h"
+
+#include <atomic> // for std::atomic
+#include <condition_variable> // for std::condition_variable
+#include <deque> // for std::deque
+#include <functional> // for std::function
+#include <memory> // for std::unique_ptr
+#include <mutex> // for std::mutex
+#include <thread> // for std::thread
+#include <vector> // for std::vector
+
+namespace moos {
+
+// Interface for running tasks in parallel, so applications can plug in their own job system with setTaskScheduler (the
+// default is a work-stealing ThreadPool). Tasks must not throw.
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    virtual ~TaskScheduler() = default;
+
+    // Queues the task to be run by some thread, possibly one that's waiting in runPendingTask
+    virtual void submit(Task task) = 0;
+
+    // Runs one queued task on the calling thread, if there is one. Called while waiting for tasks, so that waiting threads
+    // help out (which also makes nested waits from inside tasks safe).
+    virtual bool runPendingTask() = 0;
+
+    // The number of threads that may run tasks at the same time, including a waiting thread
+    virtual size_t concurrency() const = 0;
+};
+
+// Work-stealing thread pool, where each worker has its own deque of tasks. Workers run their own newest tasks first
+// (depth first, for cache locality) and steal the oldest tasks of other workers (which tend to be the largest when
+// ranges are split recursively). Tasks submitted from other threads are spread over the workers round-robin.
+class ThreadPool final : public TaskScheduler {
+public:
+    // Uses one worker less than the hardware concurrency, since the thread waiting for the tasks also runs them
+    explicit ThreadPool(size_t workerCount = defaultWorkerCount())
+        : m_queues(std::max(workerCount, static_cast<size_t>(1)))
+    {
+        m_workers.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; ++i) {
+            m_workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_wakeCondition.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static size_t defaultWorkerCount()
+    {
+        unsigned hardwareConcurrency = std::thread::hardware_concurrency();
+        return (hardwareConcurrency > 1) ? hardwareConcurrency - 1 : 0;
+    }
+
+    size_t workerCount() const { return m_workers.size(); }
+    size_t concurrency() const override { return m_workers.size() + 1; }
+
+    void submit(Task task) override
+    {
+        size_t queueIndex = (currentWorker().pool == this)
+            ? currentWorker().index
+            : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        {
+            std::lock_guard<std::mutex> lock(m_queues[queueIndex].mutex);
+            m_queues[queueIndex].tasks.push_back(std::move(task));
+        }
+
+        // Increment before taking the sleep lock, so a worker either sees the task or gets the notification
+        m_queuedCount.fetch_add(1, std::memory_order_release);
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_wakeCondition.notify_one();
+    }
+
+    bool runPendingTask() override
+    {
+        size_t ownQueue = (currentWorker().pool == this) ? currentWorker().index : m_queues.size();
+        Task task;
+        if (!popTask(ownQueue, task)) {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct WorkerIdentity {
+        const ThreadPool* pool { nullptr };
+        size_t index { 0 };
+    };
+
+    static WorkerIdentity& currentWorker()
+    {
+        static thread_local WorkerIdentity s_identity {};
+        return s_identity;
+    }
+
+    // Pops the newest task of the own queue (if ownQueue is valid), or else steals the oldest task of another queue
+    bool popTask(size_t ownQueue, Task& task)
+    {
+        if (m_queuedCount.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+
+        if (ownQueue < m_queues.size()) {
+            WorkerQueue& queue = m_queues[ownQueue];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        size_t start = (ownQueue < m_queues.size()) ? ownQueue + 1 : 0;
+        for (size_t i = 0; i < m_queues.size(); ++i) {
+            WorkerQueue& queue = m_queues[(start + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t index)
+    {
+        currentWorker() = { this, index };
+        Task task;
+        while (true) {
+            if (popTask(index, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_wakeCondition.wait(lock, [this] { return m_stopping || m_queuedCount.load(std::memory_order_acquire) > 0; });
+            if (m_stopping) {
+                return;
+            }
+        }
+    }
+
+    std::vector<WorkerQueue> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_nextQueue { 0 };
+    std::atomic<size_t> m_queuedCount { 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    bool m_stopping { false };
+};
+
+namespace detail {
+
+    inline std::atomic<TaskScheduler*>& customTaskScheduler()
+    {
+        static std::atomic<TaskScheduler*> s_scheduler { nullptr };
+        return s_scheduler;
+    }
+
+} // namespace detail
+
+// Replaces the scheduler used by default for TaskGroup, parallelFor & parallelReduce (and so by the library itself), or
+// restores the default ThreadPool if nullptr. The scheduler must outlive its use and no tasks may be in flight.
+inline void setTaskScheduler(TaskScheduler* scheduler)
+{
+    detail::customTaskScheduler().store(scheduler, std::memory_order_release);
+}
+
+inline TaskScheduler& taskScheduler()
+{
+    if (TaskScheduler* scheduler = detail::customTaskScheduler().load(std::memory_order_acquire)) {
+        return *scheduler;
+    }
+    static ThreadPool s_defaultPool {};
+    return s_defaultPool;
+}
+
+// A set of tasks that can be waited on together. Waiting runs pending tasks (of any group) on the waiting thread.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = taskScheduler())
+        : m_scheduler(scheduler)
+    {
+    }
+
+    ~TaskGroup()
+    {
+        wait();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    TaskScheduler& scheduler() const { return m_scheduler; }
+
+    template<typename Fn>
+    void run(Fn&& fn)
+    {
+        m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+        m_scheduler.submit([this, task = std::forward<Fn>(fn)]() mutable {
+            task();
+            m_pendingCount.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void wait()
+    {
+        while (m_pendingCount.load(std::memory_order_acquire) > 0) {
+            if (!m_scheduler.runPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    TaskScheduler& m_scheduler;
+    std::atomic<size_t> m_pendingCount { 0 };
+};
+
+namespace detail {
+
+    template<typename Fn>
+    void parallelForRange(TaskGroup& group, size_t begin, size_t end, size_t grainSize, Fn& fn)
+    {
+        // Split off the upper halves as tasks, so that stealing threads take big pieces of work
+        while (end - begin > grainSize) {
+            size_t middle = begin + (end - begin) / 2;
+            group.run([&group, middle, end, grainSize, &fn] { parallelForRange(group, middle, end, grainSize, fn); });
+            end = middle;
+        }
+        fn(begin, end);
+    }
+
+} // namespace detail
+
+// Calls fn(rangeBegin, rangeEnd) for subranges of [begin, end) in parallel, with at most grainSize elements each, and
+// returns when all of them are done. Taking ranges lets fn call a batch function (e.g. transformPointsBatch) per range.
+template<typename Fn>
+void parallelFor(size_t begin, size_t end, size_t grainSize, Fn&& fn, TaskScheduler& scheduler = taskScheduler())
+{
+    grainSize = std::max(grainSize, static_cast<size_t>(1));
+    if (end <= begin) {
+        return;
+    }
+    if (end - begin <= grainSize || scheduler.concurrency() <= 1) {
+        fn(begin, end);
+        return;
+    }
+    TaskGroup group { scheduler };
+    detail::parallelForRange(group, begin, end, grainSize, fn);
+    group.wait();
+}
+
+// Reduces [begin, end) by mapping chunks of grainSize elements with map(rangeBegin, rangeEnd) in parallel and combining
+// the results in order with combine(a, b). The chunks only depend on grainSize, so the result is deterministic (also for
+// floats) regardless of the number of threads.
+template<typename T, typename MapFn, typename CombineFn>
+T parallelReduce(size_t begin, size_t end, size_t grainSize, T identity, MapFn&& map, CombineFn&& combine, TaskScheduler& scheduler = taskScheduler())
+{
+    grainSize = std::max(grainSize, static_cast<size_t>(1));
+    if (end <= begin) {
+        return identity;
+    }
+    size_t chunkCount = (end - begin + grainSize - 1) / grainSize;
+    std::vector<T> partials(chunkCount, identity);
+    parallelFor(0, chunkCount, 1, [&](size_t firstChunk, size_t endChunk) {
+        for (size_t chunk = firstChunk; chunk < endChunk; ++chunk) {
+            size_t chunkBegin = begin + chunk * grainSize;
+            partials[chunk] = map(chunkBegin, std::min(chunkBegin + grainSize, end));
+        }
+    }, scheduler);
+
+    T result = identity;
+    for (const T& partial : partials) {
+        result = combine(result, partial);
+    }
+    return result;
+}
+
+} // namespace moos
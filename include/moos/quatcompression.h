@@ -0,0 +1,660 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "core.h"
+#include "quaternion.h"
+#include "vector.h"
+
+namespace moos {
+
+// Compact encodings of unit quaternions, e.g. for replicating orientations over the network or storing them on disk.
+//
+// All decoders only use exact integer arithmetic followed by single IEEE float operations (conversions, multiplications,
+// divisions, and square roots, never a multiply followed by an add), so decoding is bit-exact between the scalar and
+// SIMD versions, and across platforms & compilers as long as the code isn't compiled with fast-math. Encoding is not
+// guaranteed to be bit-exact, which is fine since the encoded bits are what is sent. All decoders return unit
+// quaternions (up to rounding), but q and -q may be decoded as either since they represent the same rotation.
+
+// Smallest three: the largest component (in magnitude) is dropped and reconstructed from the unit length constraint,
+// which also means the other three are in the range [-1/sqrt(2), +1/sqrt(2)] and can be quantized more precisely.
+
+// 2-bit index of the dropped component in bits 27-28 and 3x9 bits for the other components (top 3 bits are zero, so it
+// can be written as 29 bits to a bit stream). Max error around 0.0035 per component.
+struct QuatSmallestThree29 {
+    u32 bits;
+};
+
+// 2-bit index of the dropped component in bits 30-31 and 3x10 bits for the other components. Max error around 0.002 per component.
+struct QuatSmallestThree32 {
+    u32 bits;
+};
+
+// 3x15 bits for the other components in the lower bits of the 16-bit values, and the index of the dropped component
+// in the top bits of the first two values. Max error around 5e-5 per component.
+struct QuatSmallestThree48 {
+    u16 data[3];
+};
+
+// Octahedral-encoded rotation axis (2x11 bits, in bits 0-21) and angle (10 bits, in bits 22-31). The angle is stored as
+// tan(angle/4) in [0, 1], i.e. the length of the modified Rodrigues parameters, so that decoding is rational and needs
+// no trigonometry. Max error around 0.002 per component, roughly uniform over all rotations.
+struct QuatOctahedral32 {
+    u32 bits;
+};
+
+// All four components stored as 16-bit signed normalized values, renormalized when decoded. Max error around 2e-5 per component.
+// The encoder only writes values in [-32767, 32767], and the decoder clamps -32768 (e.g. from corrupt data) to -32767.
+struct QuatComponents64 {
+    i16 data[4];
+};
+
+namespace detail {
+
+    template<int Bits>
+    constexpr i32 smallestThreeMax()
+    {
+        return (1 << (Bits - 1)) - 1;
+    }
+
+    template<int Bits>
+    constexpr f32 smallestThreeScale()
+    {
+        return 0.70710678118654752f / static_cast<f32>(smallestThreeMax<Bits>());
+    }
+
+    constexpr i32 octahedralAxisMax = 1023; // (i.e. axis components are stored as [-1023, +1023] in 11 bits)
+    constexpr i32 octahedralAngleMax = 1023; // (i.e. tan(angle/4) is stored as [0, 1023] in 10 bits)
+
+    // Quantizes the value in [-1, +1] to an unsigned integer in [0, 2 * maxValue], i.e. offset by maxValue
+    inline u32 quantizeSigned(f32 value, i32 maxValue)
+    {
+        f32 max = static_cast<f32>(maxValue);
+        f32 scaled = value * max + (max + 0.5f);
+        return static_cast<u32>(clamp(scaled, 0.0f, 2.0f * max));
+    }
+
+    template<int Bits>
+    void encodeSmallestThree(const fquat& q, u32& largestIndex, u32 quantized[3])
+    {
+        f32 components[4] = { q.vec.x, q.vec.y, q.vec.z, q.w };
+
+        largestIndex = 0;
+        for (u32 i = 1; i < 4; ++i) {
+            if (std::abs(components[i]) > std::abs(components[largestIndex])) {
+                largestIndex = i;
+            }
+        }
+
+        // q and -q represent the same rotation, so flip the quaternion so that the dropped component is always positive
+        f32 scale = (components[largestIndex] < 0.0f) ? -1.41421356237309505f : 1.41421356237309505f;
+
+        for (u32 i = 0, j = 0; i < 4; ++i) {
+            if (i != largestIndex) {
+                quantized[j++] = quantizeSigned(components[i] * scale, smallestThreeMax<Bits>());
+            }
+        }
+    }
+
+    template<int Bits>
+    fquat decodeSmallestThree(u32 largestIndex, const u32 quantized[3])
+    {
+        constexpr i32 max = smallestThreeMax<Bits>();
+        constexpr f32 scale = smallestThreeScale<Bits>();
+
+        i32 ia = static_cast<i32>(quantized[0]) - max;
+        i32 ib = static_cast<i32>(quantized[1]) - max;
+        i32 ic = static_cast<i32>(quantized[2]) - max;
+
+        // The components are i * scale with scale = 1/(sqrt(2) * max), so the dropped component can be computed
+        // exactly in integers up to the final square root: sqrt(1 - sum(i^2) * scale^2) = sqrt(2 * max^2 - sum(i^2)) * scale
+        i32 remaining = std::max(0, 2 * max * max - (ia * ia + ib * ib + ic * ic));
+        f32 largest = std::sqrt(static_cast<f32>(remaining)) * scale;
+
+        f32 a = static_cast<f32>(ia) * scale;
+        f32 b = static_cast<f32>(ib) * scale;
+        f32 c = static_cast<f32>(ic) * scale;
+
+        switch (largestIndex) {
+        case 0:
+            return { { largest, a, b }, c };
+        case 1:
+            return { { a, largest, b }, c };
+        case 2:
+            return { { a, b, largest }, c };
+        default:
+            return { { a, b, c }, largest };
+        }
+    }
+
+    inline u32 encodeOctahedral(const fquat& q)
+    {
+        // Use the representation with w >= 0, so that the angle is in [0, pi] and tan(angle/4) = |v| / (1 + w) in [0, 1]
+        fquat c = (q.w < 0.0f) ? -q : q;
+        f32 tanQuarterAngle = length(c.vec) / (1.0f + c.w);
+        u32 angle = static_cast<u32>(clamp(tanQuarterAngle * octahedralAngleMax + 0.5f, 0.0f, static_cast<f32>(octahedralAngleMax)));
+
+        // Octahedral projection of the axis (any axis will do for the identity rotation)
+        f32 l1 = std::abs(c.vec.x) + std::abs(c.vec.y) + std::abs(c.vec.z);
+        fvec3 n = (l1 > 0.0f) ? c.vec / l1 : fvec3(0.0f, 0.0f, 1.0f);
+        f32 x = n.x;
+        f32 y = n.y;
+        if (n.z < 0.0f) {
+            x = std::copysign(1.0f - std::abs(n.y), n.x);
+            y = std::copysign(1.0f - std::abs(n.x), n.y);
+        }
+
+        return quantizeSigned(x, octahedralAxisMax) | (quantizeSigned(y, octahedralAxisMax) << 11) | (angle << 22);
+    }
+
+    inline fquat decodeOctahedral(u32 bits)
+    {
+        constexpr i32 axisMax = octahedralAxisMax;
+        constexpr i32 angleMax = octahedralAngleMax;
+
+        // Unfold the octahedron in integers, which is exact
+        i32 ix = static_cast<i32>(bits & 0x7ff) - axisMax;
+        i32 iy = static_cast<i32>((bits >> 11) & 0x7ff) - axisMax;
+        i32 iz = axisMax - std::abs(ix) - std::abs(iy);
+        if (iz < 0) {
+            i32 foldedX = (axisMax - std::abs(iy)) * (ix < 0 ? -1 : 1);
+            i32 foldedY = (axisMax - std::abs(ix)) * (iy < 0 ? -1 : 1);
+            ix = foldedX;
+            iy = foldedY;
+        }
+        i32 axisLength2 = ix * ix + iy * iy + iz * iz;
+
+        // With t = k / angleMax = tan(angle/4): cos(angle/2) = (1 - t^2) / (1 + t^2) and sin(angle/2) = 2t / (1 + t^2)
+        i32 k = static_cast<i32>(bits >> 22);
+        f32 denominator = static_cast<f32>(angleMax * angleMax + k * k);
+        f32 w = static_cast<f32>(angleMax * angleMax - k * k) / denominator;
+        f32 sinHalfAngle = static_cast<f32>(2 * angleMax * k) / denominator;
+
+        f32 invAxisLength = 1.0f / std::sqrt(static_cast<f32>(axisLength2));
+        fvec3 v = { static_cast<f32>(ix) * invAxisLength * sinHalfAngle,
+                    static_cast<f32>(iy) * invAxisLength * sinHalfAngle,
+                    static_cast<f32>(iz) * invAxisLength * sinHalfAngle };
+        return { v, w };
+    }
+
+} // namespace detail
+
+inline QuatSmallestThree29 compressQuatSmallestThree29(const fquat& q)
+{
+    u32 largestIndex, quantized[3];
+    detail::encodeSmallestThree<9>(q, largestIndex, quantized);
+    return { (largestIndex << 27) | (quantized[0] << 18) | (quantized[1] << 9) | quantized[2] };
+}
+
+inline QuatSmallestThree32 compressQuatSmallestThree32(const fquat& q)
+{
+    u32 largestIndex, quantized[3];
+    detail::encodeSmallestThree<10>(q, largestIndex, quantized);
+    return { (largestIndex << 30) | (quantized[0] << 20) | (quantized[1] << 10) | quantized[2] };
+}
+
+inline QuatSmallestThree48 compressQuatSmallestThree48(const fquat& q)
+{
+    u32 largestIndex, quantized[3];
+    detail::encodeSmallestThree<15>(q, largestIndex, quantized);
+
+    QuatSmallestThree48 c;
+    c.data[0] = static_cast<u16>(quantized[0] | ((largestIndex & 1) << 15));
+    c.data[1] = static_cast<u16>(quantized[1] | ((largestIndex >> 1) << 15));
+    c.data[2] = static_cast<u16>(quantized[2]);
+    return c;
+}
+
+inline QuatOctahedral32 compressQuatOctahedral32(const fquat& q)
+{
+    return { detail::encodeOctahedral(q) };
+}
+
+inline QuatComponents64 compressQuatComponents64(const fquat& q)
+{
+    constexpr i32 max = 32767;
+    f32 components[4] = { q.vec.x, q.vec.y, q.vec.z, q.w };
+
+    QuatComponents64 c;
+    for (int i = 0; i < 4; ++i) {
+        c.data[i] = static_cast<i16>(static_cast<i32>(detail::quantizeSigned(components[i], max)) - max);
+    }
+    return c;
+}
+
+inline fquat decompressQuat(const QuatSmallestThree29& c)
+{
+    u32 quantized[3] = { (c.bits >> 18) & 0x1ff, (c.bits >> 9) & 0x1ff, c.bits & 0x1ff };
+    return detail::decodeSmallestThree<9>((c.bits >> 27) & 0x3, quantized);
+}
+
+inline fquat decompressQuat(const QuatSmallestThree32& c)
+{
+    u32 quantized[3] = { (c.bits >> 20) & 0x3ff, (c.bits >> 10) & 0x3ff, c.bits & 0x3ff };
+    return detail::decodeSmallestThree<10>(c.bits >> 30, quantized);
+}
+
+inline fquat decompressQuat(const QuatSmallestThree48& c)
+{
+    u32 largestIndex = static_cast<u32>((c.data[0] >> 15) | ((c.data[1] >> 15) << 1));
+    u32 quantized[3] = { c.data[0] & 0x7fffu, c.data[1] & 0x7fffu, c.data[2] & 0x7fffu };
+    return detail::decodeSmallestThree<15>(largestIndex, quantized);
+}
+
+inline fquat decompressQuat(const QuatOctahedral32& c)
+{
+    return detail::decodeOctahedral(c.bits);
+}
+
+inline fquat decompressQuat(const QuatComponents64& c)
+{
+    // (the scale of the quantization cancels out in the normalization, and the sums of squares are exact in integers,
+    // where the clamping keeps the sum of two squares from overflowing)
+    i32 v[4];
+    for (int i = 0; i < 4; ++i) {
+        v[i] = std::max<i32>(c.data[i], -32767);
+    }
+    i32 xy = v[0] * v[0] + v[1] * v[1];
+    i32 zw = v[2] * v[2] + v[3] * v[3];
+    f32 invLength = 1.0f / std::sqrt(static_cast<f32>(xy) + static_cast<f32>(zw));
+    return { { static_cast<f32>(v[0]) * invLength, static_cast<f32>(v[1]) * invLength, static_cast<f32>(v[2]) * invLength },
+             static_cast<f32>(v[3]) * invLength };
+}
+
+// Batch versions, e.g. for all replicated orientations of a network tick. For f32 with SSE, 4 quaternions are encoded
+// and decoded at a time. The SIMD decoding gives bit-identical results to the scalar decompressQuat.
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    inline __m128i quantizeSignedx4(__m128 value, i32 maxValue)
+    {
+        __m128 max = _mm_set1_ps(static_cast<f32>(maxValue));
+        __m128 scaled = _mm_add_ps(_mm_mul_ps(value, max), _mm_add_ps(max, _mm_set1_ps(0.5f)));
+        scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_add_ps(max, max));
+        return _mm_cvttps_epi32(scaled);
+    }
+
+    inline __m128i absx4(__m128i v)
+    {
+        __m128i sign = _mm_srai_epi32(v, 31);
+        return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+    }
+
+    inline __m128i selectx4(__m128i mask, __m128i ifTrue, __m128i ifFalse)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, ifTrue), _mm_andnot_si128(mask, ifFalse));
+    }
+
+    inline __m128 selectx4(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+    }
+
+    // Exact sum of squares of 16-bit signed values in 32-bit lanes (SSE2 has no 32-bit integer multiply, but madd does this)
+    inline __m128i sumOfSquaresx4(__m128i a, __m128i b, __m128i c)
+    {
+        const __m128i lowMask = _mm_set1_epi32(0xffff);
+        __m128i ab = _mm_or_si128(_mm_and_si128(a, lowMask), _mm_slli_epi32(b, 16));
+        __m128i cc = _mm_and_si128(c, lowMask);
+        return _mm_add_epi32(_mm_madd_epi16(ab, ab), _mm_madd_epi16(cc, cc));
+    }
+
+    template<int Bits>
+    void encodeSmallestThreex4(const fquat* quats, __m128i& largestIndex, __m128i quantized[3])
+    {
+        __m128 x = quats[0].simd();
+        __m128 y = quats[1].simd();
+        __m128 z = quats[2].simd();
+        __m128 w = quats[3].simd();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 largestAbs = _mm_andnot_ps(signMask, x);
+        __m128 largest = x;
+        largestIndex = _mm_setzero_si128();
+
+        const __m128 components[3] = { y, z, w };
+        for (int i = 0; i < 3; ++i) {
+            __m128 isLarger = _mm_cmpgt_ps(_mm_andnot_ps(signMask, components[i]), largestAbs);
+            largestAbs = selectx4(isLarger, _mm_andnot_ps(signMask, components[i]), largestAbs);
+            largest = selectx4(isLarger, components[i], largest);
+            largestIndex = selectx4(_mm_castps_si128(isLarger), _mm_set1_epi32(i + 1), largestIndex);
+        }
+
+        // Flip so that the dropped component is positive, and scale [-1/sqrt(2), +1/sqrt(2)] to [-1, +1]
+        __m128 scale = _mm_or_ps(_mm_set1_ps(1.41421356237309505f), _mm_and_ps(largest, signMask));
+
+        __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_setzero_si128()));
+        __m128 is01 = _mm_castsi128_ps(_mm_cmplt_epi32(largestIndex, _mm_set1_epi32(2)));
+        __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(3)));
+        __m128 a = selectx4(is0, y, x);
+        __m128 b = selectx4(is01, z, y);
+        __m128 c = selectx4(is3, z, w);
+
+        quantized[0] = quantizeSignedx4(_mm_mul_ps(a, scale), smallestThreeMax<Bits>());
+        quantized[1] = quantizeSignedx4(_mm_mul_ps(b, scale), smallestThreeMax<Bits>());
+        quantized[2] = quantizeSignedx4(_mm_mul_ps(c, scale), smallestThreeMax<Bits>());
+    }
+
+    template<int Bits>
+    void decodeSmallestThreex4(__m128i largestIndex, const __m128i quantized[3], __m128& x, __m128& y, __m128& z, __m128& w)
+    {
+        const __m128i max = _mm_set1_epi32(smallestThreeMax<Bits>());
+        const __m128 scale = _mm_set1_ps(smallestThreeScale<Bits>());
+
+        __m128i ia = _mm_sub_epi32(quantized[0], max);
+        __m128i ib = _mm_sub_epi32(quantized[1], max);
+        __m128i ic = _mm_sub_epi32(quantized[2], max);
+
+        __m128i remaining = _mm_sub_epi32(_mm_set1_epi32(2 * smallestThreeMax<Bits>() * smallestThreeMax<Bits>()), sumOfSquaresx4(ia, ib, ic));
+        remaining = _mm_andnot_si128(_mm_srai_epi32(remaining, 31), remaining);
+        __m128 largest = _mm_mul_ps(_mm_sqrt_ps(_mm_cvtepi32_ps(remaining)), scale);
+
+        __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(ia), scale);
+        __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(ib), scale);
+        __m128 c = _mm_mul_ps(_mm_cvtepi32_ps(ic), scale);
+
+        __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(0)));
+        __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(1)));
+        __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(2)));
+        __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(3)));
+
+        x = selectx4(is0, largest, a);
+        y = selectx4(is0, a, selectx4(is1, largest, b));
+        z = selectx4(_mm_or_ps(is0, is1), b, selectx4(is2, largest, c));
+        w = selectx4(is3, largest, c);
+    }
+
+    // Decodes four 48-bit smallest three quaternions to SoA form, e.g. for further processing in SIMD registers
+    inline void decodeSmallestThree48x4(const QuatSmallestThree48* c, __m128& x, __m128& y, __m128& z, __m128& w)
+    {
+        __m128i d0 = _mm_setr_epi32(c[0].data[0], c[1].data[0], c[2].data[0], c[3].data[0]);
+        __m128i d1 = _mm_setr_epi32(c[0].data[1], c[1].data[1], c[2].data[1], c[3].data[1]);
+        __m128i d2 = _mm_setr_epi32(c[0].data[2], c[1].data[2], c[2].data[2], c[3].data[2]);
+
+        const __m128i mask15 = _mm_set1_epi32(0x7fff);
+        __m128i largestIndex = _mm_or_si128(_mm_srli_epi32(d0, 15), _mm_slli_epi32(_mm_srli_epi32(d1, 15), 1));
+        __m128i quantized[3] = { _mm_and_si128(d0, mask15), _mm_and_si128(d1, mask15), _mm_and_si128(d2, mask15) };
+        decodeSmallestThreex4<15>(largestIndex, quantized, x, y, z, w);
+    }
+
+    inline __m128i encodeOctahedralx4(const fquat* quats)
+    {
+        __m128 x = quats[0].simd();
+        __m128 y = quats[1].simd();
+        __m128 z = quats[2].simd();
+        __m128 w = quats[3].simd();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        __m128 flip = _mm_and_ps(w, signMask);
+        x = _mm_xor_ps(x, flip);
+        y = _mm_xor_ps(y, flip);
+        z = _mm_xor_ps(z, flip);
+        w = _mm_xor_ps(w, flip);
+
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 tanQuarterAngle = _mm_div_ps(length, _mm_add_ps(one, w));
+        const __m128 angleMax = _mm_set1_ps(static_cast<f32>(octahedralAngleMax));
+        __m128 angle = _mm_add_ps(_mm_mul_ps(tanQuarterAngle, angleMax), _mm_set1_ps(0.5f));
+        __m128i quantizedAngle = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(angle, _mm_setzero_ps()), angleMax));
+
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+        __m128 valid = _mm_cmpgt_ps(l1, _mm_setzero_ps());
+        __m128 invL1 = _mm_div_ps(one, l1);
+        __m128 nx = _mm_and_ps(valid, _mm_mul_ps(x, invL1));
+        __m128 ny = _mm_and_ps(valid, _mm_mul_ps(y, invL1));
+        __m128 nz = selectx4(valid, _mm_mul_ps(z, invL1), one);
+
+        __m128 fold = _mm_cmplt_ps(nz, _mm_setzero_ps());
+        __m128 foldedX = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ny)), _mm_and_ps(nx, signMask));
+        __m128 foldedY = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, nx)), _mm_and_ps(ny, signMask));
+        nx = selectx4(fold, foldedX, nx);
+        ny = selectx4(fold, foldedY, ny);
+
+        __m128i qx = quantizeSignedx4(nx, octahedralAxisMax);
+        __m128i qy = quantizeSignedx4(ny, octahedralAxisMax);
+        return _mm_or_si128(_mm_or_si128(qx, _mm_slli_epi32(qy, 11)), _mm_slli_epi32(quantizedAngle, 22));
+    }
+
+    inline void decodeOctahedralx4(__m128i bits, fquat* result)
+    {
+        const __m128i axisMax = _mm_set1_epi32(octahedralAxisMax);
+        const __m128i mask11 = _mm_set1_epi32(0x7ff);
+
+        __m128i ix = _mm_sub_epi32(_mm_and_si128(bits, mask11), axisMax);
+        __m128i iy = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 11), mask11), axisMax);
+        __m128i absX = absx4(ix);
+        __m128i absY = absx4(iy);
+        __m128i iz = _mm_sub_epi32(_mm_sub_epi32(axisMax, absX), absY);
+
+        // (v ^ s) - s with s = sign(ix) >> 31, i.e. v * (ix < 0 ? -1 : 1)
+        __m128i fold = _mm_cmplt_epi32(iz, _mm_setzero_si128());
+        __m128i signX = _mm_srai_epi32(ix, 31);
+        __m128i signY = _mm_srai_epi32(iy, 31);
+        __m128i foldedX = _mm_sub_epi32(_mm_xor_si128(_mm_sub_epi32(axisMax, absY), signX), signX);
+        __m128i foldedY = _mm_sub_epi32(_mm_xor_si128(_mm_sub_epi32(axisMax, absX), signY), signY);
+        ix = selectx4(fold, foldedX, ix);
+        iy = selectx4(fold, foldedY, iy);
+        __m128i axisLength2 = sumOfSquaresx4(ix, iy, iz);
+
+        __m128i k = _mm_srli_epi32(bits, 22);
+        __m128i k2 = _mm_madd_epi16(k, k);
+        __m128i twoMaxK = _mm_madd_epi16(k, _mm_set1_epi32(2 * octahedralAngleMax));
+        __m128i max2 = _mm_set1_epi32(octahedralAngleMax * octahedralAngleMax);
+        __m128 denominator = _mm_cvtepi32_ps(_mm_add_epi32(max2, k2));
+        __m128 w = _mm_div_ps(_mm_cvtepi32_ps(_mm_sub_epi32(max2, k2)), denominator);
+        __m128 sinHalfAngle = _mm_div_ps(_mm_cvtepi32_ps(twoMaxK), denominator);
+
+        __m128 invAxisLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_cvtepi32_ps(axisLength2)));
+        __m128 x = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(ix), invAxisLength), sinHalfAngle);
+        __m128 y = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(iy), invAxisLength), sinHalfAngle);
+        __m128 z = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(iz), invAxisLength), sinHalfAngle);
+        storeQuatx4(x, y, z, w, result);
+    }
+
+} // namespace detail
+
+#endif
+
+inline void compressQuatBatch(const fquat* quats, QuatSmallestThree29* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128i largestIndex, quantized[3];
+        detail::encodeSmallestThreex4<9>(quats + i, largestIndex, quantized);
+        __m128i bits = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(largestIndex, 27), _mm_slli_epi32(quantized[0], 18)),
+                                    _mm_or_si128(_mm_slli_epi32(quantized[1], 9), quantized[2]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), bits);
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = compressQuatSmallestThree29(quats[i]);
+    }
+}
+
+inline void compressQuatBatch(const fquat* quats, QuatSmallestThree32* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128i largestIndex, quantized[3];
+        detail::encodeSmallestThreex4<10>(quats + i, largestIndex, quantized);
+        __m128i bits = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(largestIndex, 30), _mm_slli_epi32(quantized[0], 20)),
+                                    _mm_or_si128(_mm_slli_epi32(quantized[1], 10), quantized[2]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), bits);
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = compressQuatSmallestThree32(quats[i]);
+    }
+}
+
+inline void compressQuatBatch(const fquat* quats, QuatSmallestThree48* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128i largestIndex, quantized[3];
+        detail::encodeSmallestThreex4<15>(quats + i, largestIndex, quantized);
+        quantized[0] = _mm_or_si128(quantized[0], _mm_slli_epi32(_mm_and_si128(largestIndex, _mm_set1_epi32(1)), 15));
+        quantized[1] = _mm_or_si128(quantized[1], _mm_slli_epi32(_mm_srli_epi32(largestIndex, 1), 15));
+
+        alignas(16) u32 values[3][4];
+        for (int j = 0; j < 3; ++j) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(values[j]), quantized[j]);
+        }
+        for (int lane = 0; lane < 4; ++lane) {
+            for (int j = 0; j < 3; ++j) {
+                result[i + lane].data[j] = static_cast<u16>(values[j][lane]);
+            }
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = compressQuatSmallestThree48(quats[i]);
+    }
+}
+
+inline void compressQuatBatch(const fquat* quats, QuatOctahedral32* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), detail::encodeOctahedralx4(quats + i));
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = compressQuatOctahedral32(quats[i]);
+    }
+}
+
+inline void compressQuatBatch(const fquat* quats, QuatComponents64* result, size_t count)
+{
+#ifdef MOOS_SSE
+    const __m128i max = _mm_set1_epi32(32767);
+    for (size_t i = 0; i < count; ++i) {
+        __m128i values = _mm_sub_epi32(detail::quantizeSignedx4(quats[i].simd(), 32767), max);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(result[i].data), _mm_packs_epi32(values, values));
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = compressQuatComponents64(quats[i]);
+    }
+#endif
+}
+
+inline void decompressQuatBatch(const QuatSmallestThree29* compressed, fquat* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    const __m128i mask9 = _mm_set1_epi32(0x1ff);
+    for (; i + 4 <= count; i += 4) {
+        __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(compressed + i));
+        __m128i largestIndex = _mm_and_si128(_mm_srli_epi32(bits, 27), _mm_set1_epi32(0x3));
+        __m128i quantized[3] = { _mm_and_si128(_mm_srli_epi32(bits, 18), mask9), _mm_and_si128(_mm_srli_epi32(bits, 9), mask9), _mm_and_si128(bits, mask9) };
+        __m128 x, y, z, w;
+        detail::decodeSmallestThreex4<9>(largestIndex, quantized, x, y, z, w);
+        detail::storeQuatx4(x, y, z, w, result + i);
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = decompressQuat(compressed[i]);
+    }
+}
+
+inline void decompressQuatBatch(const QuatSmallestThree32* compressed, fquat* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    const __m128i mask10 = _mm_set1_epi32(0x3ff);
+    for (; i + 4 <= count; i += 4) {
+        __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(compressed + i));
+        __m128i largestIndex = _mm_srli_epi32(bits, 30);
+        __m128i quantized[3] = { _mm_and_si128(_mm_srli_epi32(bits, 20), mask10), _mm_and_si128(_mm_srli_epi32(bits, 10), mask10), _mm_and_si128(bits, mask10) };
+        __m128 x, y, z, w;
+        detail::decodeSmallestThreex4<10>(largestIndex, quantized, x, y, z, w);
+        detail::storeQuatx4(x, y, z, w, result + i);
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = decompressQuat(compressed[i]);
+    }
+}
+
+inline void decompressQuatBatch(const QuatSmallestThree48* compressed, fquat* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128 x, y, z, w;
+        detail::decodeSmallestThree48x4(compressed + i, x, y, z, w);
+        detail::storeQuatx4(x, y, z, w, result + i);
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = decompressQuat(compressed[i]);
+    }
+}
+
+inline void decompressQuatBatch(const QuatOctahedral32* compressed, fquat* result, size_t count)
+{
+    size_t i = 0;
+#ifdef MOOS_SSE
+    for (; i + 4 <= count; i += 4) {
+        detail::decodeOctahedralx4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(compressed + i)), result + i);
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = decompressQuat(compressed[i]);
+    }
+}
+
+inline void decompressQuatBatch(const QuatComponents64* compressed, fquat* result, size_t count)
+{
+#ifdef MOOS_SSE
+    for (size_t i = 0; i < count; ++i) {
+        __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(compressed[i].data));
+        values = _mm_max_epi16(values, _mm_set1_epi16(-32767));
+        __m128 squares = _mm_cvtepi32_ps(_mm_madd_epi16(values, values));
+        __m128 length2 = _mm_add_ss(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(1, 1, 1, 1)));
+        __m128 invLength = _mm_div_ss(_mm_set_ss(1.0f), _mm_sqrt_ss(length2));
+        __m128 components = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16));
+        result[i] = fquat(_mm_mul_ps(components, _mm_shuffle_ps(invLength, invLength, _MM_SHUFFLE(0, 0, 0, 0))));
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = decompressQuat(compressed[i]);
+    }
+#endif
+}
+
+} // namespace moos
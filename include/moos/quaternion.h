@@ -25,9 +25,12 @@
 #pragma once
 
 #include "core.h"
+#include "cpu.h"
 #include "matrix.h"
 #include "vector.h"
 
+#include <limits> // for std::numeric_limits etc.
+
 namespace moos {
 
 template<typename T, typename _ = void>
@@ -59,10 +62,10 @@ struct tquat<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
         };
     }
 
-    constexpr tquat<T>& operator*=(const tquat<T>& q) const
+    constexpr tquat<T>& operator*=(const tquat<T>& q)
     {
         *this = *this * q;
-        return this;
+        return *this;
     }
 
     constexpr tvec3<T> operator*(const tvec3<T>& v) const
@@ -75,23 +78,213 @@ struct tquat<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
 
         return res;
     }
+
+    // (component-wise operations, e.g. for blending or integrating quaternions, which don't preserve unit length)
+
+    constexpr tquat<T> operator+(const tquat<T>& q) const { return { vec + q.vec, w + q.w }; }
+    constexpr tquat<T> operator-(const tquat<T>& q) const { return { vec - q.vec, w - q.w }; }
+    constexpr tquat<T> operator-() const { return { -vec, -w }; }
+    constexpr tquat<T> operator*(T f) const { return { vec * f, w * f }; }
+};
+
+#ifdef MOOS_SSE
+
+// Composing rotations is a very common operation (e.g. in animation), so for f32 we keep the quaternion
+// 16-byte aligned and treat it as a single __m128 with the layout (x, y, z, w), same as the generic one.
+template<>
+struct alignas(16) tquat<f32> {
+    tvec3<f32> vec;
+    f32 w;
+
+    constexpr tquat(tvec3<f32> vec, f32 w) noexcept
+        : vec(vec)
+        , w(w)
+    {
+    }
+
+    constexpr tquat() noexcept
+        : tquat({ 0.0f, 0.0f, 0.0f }, 1.0f)
+    {
+    }
+
+    explicit tquat(__m128 xyzw) noexcept
+    {
+        _mm_store_ps(&vec.x, xyzw);
+    }
+
+    __m128 simd() const
+    {
+        return _mm_load_ps(&vec.x);
+    }
+
+    MOOS_CONSTEXPR_SIMD tquat<f32> operator*(const tquat<f32>& q) const
+    {
+        if (isConstantEvaluated()) {
+            return { w * q.vec + q.w * vec + cross(vec, q.vec), w * q.w - dot(vec, q.vec) };
+        }
+
+        // Hamilton product, written as the sum of the four components of this quaternion times a
+        // shuffled and sign-flipped version of q, to avoid the separate cross & dot products.
+
+        __m128 a = simd();
+        __m128 b = q.simd();
+
+        const __m128 signsX = _mm_setr_ps(+0.0f, -0.0f, +0.0f, -0.0f);
+        const __m128 signsY = _mm_setr_ps(+0.0f, +0.0f, -0.0f, -0.0f);
+        const __m128 signsZ = _mm_setr_ps(-0.0f, +0.0f, +0.0f, -0.0f);
+
+        __m128 bWZYX = _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)), signsX);
+        __m128 bZWXY = _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)), signsY);
+        __m128 bYXWZ = _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)), signsZ);
+
+        __m128 res = _mm_mul_ps(simd::splat<3>(a), b);
+        res = _mm_add_ps(res, _mm_mul_ps(simd::splat<0>(a), bWZYX));
+        res = _mm_add_ps(res, _mm_mul_ps(simd::splat<1>(a), bZWXY));
+        res = _mm_add_ps(res, _mm_mul_ps(simd::splat<2>(a), bYXWZ));
+
+        return tquat<f32>(res);
+    }
+
+    MOOS_CONSTEXPR_SIMD tquat<f32>& operator*=(const tquat<f32>& q)
+    {
+        *this = *this * q;
+        return *this;
+    }
+
+    MOOS_CONSTEXPR_SIMD tvec3<f32> operator*(const tvec3<f32>& v) const
+    {
+        // Same method by Fabian 'ryg' Giessen as for the generic version, see above
+
+        if (isConstantEvaluated()) {
+            tvec3<f32> t = 2.0f * cross(vec, v);
+            return v + w * t + cross(vec, t);
+        }
+
+        __m128 q = simd();
+        __m128 vv = simd::load(v);
+
+        __m128 t = simd::cross3(q, vv);
+        t = _mm_add_ps(t, t);
+
+        __m128 res = _mm_add_ps(vv, _mm_mul_ps(simd::splat<3>(q), t));
+        res = _mm_add_ps(res, simd::cross3(q, t));
+
+        return simd::storeVec3(res);
+    }
+
+    // (component-wise operations, e.g. for blending or integrating quaternions, which don't preserve unit length)
+
+    MOOS_CONSTEXPR_SIMD tquat<f32> operator+(const tquat<f32>& q) const
+    {
+        return isConstantEvaluated() ? tquat<f32>(vec + q.vec, w + q.w) : tquat<f32>(_mm_add_ps(simd(), q.simd()));
+    }
+
+    MOOS_CONSTEXPR_SIMD tquat<f32> operator-(const tquat<f32>& q) const
+    {
+        return isConstantEvaluated() ? tquat<f32>(vec - q.vec, w - q.w) : tquat<f32>(_mm_sub_ps(simd(), q.simd()));
+    }
+
+    MOOS_CONSTEXPR_SIMD tquat<f32> operator-() const
+    {
+        return isConstantEvaluated() ? tquat<f32>(-vec, -w) : tquat<f32>(_mm_xor_ps(simd(), _mm_set1_ps(-0.0f)));
+    }
+
+    MOOS_CONSTEXPR_SIMD tquat<f32> operator*(f32 f) const
+    {
+        return isConstantEvaluated() ? tquat<f32>(vec * f, w * f) : tquat<f32>(_mm_mul_ps(simd(), _mm_set1_ps(f)));
+    }
 };
 
+static_assert(sizeof(tquat<f32>) == 4 * sizeof(f32), "f32 quaternion must be exactly one __m128 in size");
+
+#endif
+
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
-constexpr tquat<T> axisAngle(const tvec3<T>& axis, T angle)
+constexpr tquat<T> operator*(T lhs, const tquat<T>& rhs)
 {
-    T halfAngle = angle / static_cast<T>(2);
-    tvec3<T> xyz = axis * std::sin(halfAngle);
-    T w = std::cos(halfAngle);
-    return tquat<T>(xyz, w);
+    return rhs * lhs;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T dot(const tquat<T>& p, const tquat<T>& q)
+{
+    return dot(p.vec, q.vec) + p.w * q.w;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T length2(const tquat<T>& q)
+{
+    return dot(q, q);
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T length(const tquat<T>& q)
+{
+    return cx::sqrt(length2(q));
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tquat<T> conjugate(const tquat<T>& q)
+{
+    return { -q.vec, q.w };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tquat<T> inverse(const tquat<T>& q)
+{
+    // (for unit quaternions this is identical to the conjugate, so prefer that if possible)
+    T invLength2 = static_cast<T>(1) / length2(q);
+    return { -q.vec * invLength2, q.w * invLength2 };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tquat<T> normalize(const tquat<T>& q)
+{
+    T invLength = static_cast<T>(1) / length(q);
+    return { q.vec * invLength, q.w * invLength };
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline f32 dot(const tquat<f32>& p, const tquat<f32>& q)
+{
+    return _mm_cvtss_f32(simd::dot4(p.simd(), q.simd()));
+}
+
+template<>
+inline tquat<f32> conjugate(const tquat<f32>& q)
+{
+    const __m128 signs = _mm_setr_ps(-0.0f, -0.0f, -0.0f, +0.0f);
+    return tquat<f32>(_mm_xor_ps(q.simd(), signs));
+}
+
+template<>
+inline tquat<f32> inverse(const tquat<f32>& q)
+{
+    const __m128 signs = _mm_setr_ps(-0.0f, -0.0f, -0.0f, +0.0f);
+    __m128 v = q.simd();
+    __m128 len2 = simd::dot4(v, v);
+    return tquat<f32>(_mm_div_ps(_mm_xor_ps(v, signs), len2));
+}
+
+template<>
+inline tquat<f32> normalize(const tquat<f32>& q)
+{
+    __m128 v = q.simd();
+    __m128 len = _mm_sqrt_ps(simd::dot4(v, v));
+    return tquat<f32>(_mm_div_ps(v, len));
 }
 
+#endif
+
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
-constexpr tquat<T> lookRotation(const tvec3<T>& forward, const tvec3<T>& tempUp)
+constexpr tquat<T> axisAngle(const tvec3<T>& axis, T angle)
 {
-    // TODO: Implement something like this: https://answers.unity.com/questions/467614/what-is-the-source-code-of-quaternionlookrotation.html
-    //  However, I think Unity is left-handed, so maybe not exactly like that...
-    return {};
+    T halfAngle = angle / static_cast<T>(2);
+    tvec3<T> xyz = axis * cx::sin(halfAngle);
+    T w = cx::cos(halfAngle);
+    return tquat<T>(xyz, w);
 }
 
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
@@ -109,21 +302,21 @@ constexpr tvec3<T> quatToEulerAngles(const tquat<T>& q)
 
     // Roll (x-axis rotation)
     T sinRollCosPitch = static_cast<T>(2) * (q.w * q.vec.x + q.vec.y * q.vec.z);
-    T cosRollCosPitch = static_cast<T>(1) - static_cast<T>(2) * square(q.vec.x) + square(q.vec.y);
-    euler.x = std::atan2(sinRollCosPitch, cosRollCosPitch);
+    T cosRollCosPitch = static_cast<T>(1) - static_cast<T>(2) * (square(q.vec.x) + square(q.vec.y));
+    euler.x = cx::atan2(sinRollCosPitch, cosRollCosPitch);
 
     // Pitch (y-axis rotation)
     T sinPitch = static_cast<T>(2) * (q.w * q.vec.y - q.vec.z * q.vec.x);
-    if (std::abs(sinPitch) >= static_cast<T>(1)) {
-        euler.y = std::copysign(HALF_PI, sinPitch); // (clamp to +-90 degrees)
+    if (cx::abs(sinPitch) >= static_cast<T>(1)) {
+        euler.y = (sinPitch < static_cast<T>(0)) ? -static_cast<T>(HALF_PI) : static_cast<T>(HALF_PI); // (clamp to +-90 degrees)
     } else {
-        euler.y = std::asin(sinPitch);
+        euler.y = cx::asin(sinPitch);
     }
 
     // Yaw (z-axis rotation)
     T sinYawCosPitch = static_cast<T>(2) * (q.w * q.vec.z + q.vec.x * q.vec.y);
-    T cosYawCosPitch = static_cast<T>(1) - static_cast<T>(2) * square(q.vec.y) + square(q.vec.z);
-    euler.z = std::atan2(sinYawCosPitch, cosYawCosPitch);
+    T cosYawCosPitch = static_cast<T>(1) - static_cast<T>(2) * (square(q.vec.y) + square(q.vec.z));
+    euler.z = cx::atan2(sinYawCosPitch, cosYawCosPitch);
 
     return euler;
 }
@@ -138,14 +331,14 @@ constexpr tquat<T> quatFromEulerAngles(const tvec3<T>& euler)
     const T& yaw = euler.z;
 
     T half = static_cast<T>(0.5);
-    T cr = std::cos(roll * half);
-    T sr = std::sin(roll * half);
-    T cp = std::cos(pitch * half);
-    T sp = std::sin(pitch * half);
-    T cy = std::cos(yaw * half);
-    T sy = std::sin(yaw * half);
-
-    tvec3<T> q;
+    T cr = cx::cos(roll * half);
+    T sr = cx::sin(roll * half);
+    T cp = cx::cos(pitch * half);
+    T sp = cx::sin(pitch * half);
+    T cy = cx::cos(yaw * half);
+    T sy = cx::sin(yaw * half);
+
+    tquat<T> q;
     q.vec.x = sr * cp * cy - cr * sp * sy;
     q.vec.y = cr * sp * cy + sr * cp * sy;
     q.vec.z = cr * cp * sy - sr * sp * cy;
@@ -154,6 +347,145 @@ constexpr tquat<T> quatFromEulerAngles(const tvec3<T>& euler)
     return q;
 }
 
+// Batch versions of axisAngle and the Euler angle conversions. For f32 these use the SSE versions of fast::sincos
+// and fast::atan2, which are accurate to around 1e-7 and 3e-7 respectively (see core.h). Like fast::sincos, the SSE
+// lanes give NaN quaternions for half angles beyond 2^24 and for infinite or NaN angles.
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void axisAngleBatch(const tvec3<T>* axes, const T* angles, tquat<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = axisAngle(axes[i], angles[i]);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void quatFromEulerAnglesBatch(const tvec3<T>* eulerAngles, tquat<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = quatFromEulerAngles(eulerAngles[i]);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void quatToEulerAnglesBatch(const tquat<T>* quats, tvec3<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = quatToEulerAngles(quats[i]);
+    }
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    inline void loadVec3x4(const tvec3<f32>* v, __m128& x, __m128& y, __m128& z)
+    {
+        x = _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x);
+        y = _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y);
+        z = _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z);
+    }
+
+    inline void storeQuatx4(__m128 x, __m128 y, __m128 z, __m128 w, tquat<f32>* result)
+    {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        result[0] = tquat<f32>(x);
+        result[1] = tquat<f32>(y);
+        result[2] = tquat<f32>(z);
+        result[3] = tquat<f32>(w);
+    }
+
+} // namespace detail
+
+template<>
+inline void axisAngleBatch(const tvec3<f32>* axes, const f32* angles, tquat<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ax, ay, az;
+        detail::loadVec3x4(axes + i, ax, ay, az);
+
+        __m128 s, c;
+        fast::sincos(_mm_mul_ps(_mm_loadu_ps(angles + i), _mm_set1_ps(0.5f)), s, c);
+
+        detail::storeQuatx4(_mm_mul_ps(ax, s), _mm_mul_ps(ay, s), _mm_mul_ps(az, s), c, result + i);
+    }
+    for (; i < count; ++i) {
+        result[i] = axisAngle(axes[i], angles[i]);
+    }
+}
+
+template<>
+inline void quatFromEulerAnglesBatch(const tvec3<f32>* eulerAngles, tquat<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 roll, pitch, yaw;
+        detail::loadVec3x4(eulerAngles + i, roll, pitch, yaw);
+
+        const __m128 half = _mm_set1_ps(0.5f);
+        __m128 sr, cr, sp, cp, sy, cy;
+        fast::sincos(_mm_mul_ps(roll, half), sr, cr);
+        fast::sincos(_mm_mul_ps(pitch, half), sp, cp);
+        fast::sincos(_mm_mul_ps(yaw, half), sy, cy);
+
+        __m128 cpcy = _mm_mul_ps(cp, cy), spsy = _mm_mul_ps(sp, sy);
+        __m128 spcy = _mm_mul_ps(sp, cy), cpsy = _mm_mul_ps(cp, sy);
+
+        __m128 x = _mm_sub_ps(_mm_mul_ps(sr, cpcy), _mm_mul_ps(cr, spsy));
+        __m128 y = _mm_add_ps(_mm_mul_ps(cr, spcy), _mm_mul_ps(sr, cpsy));
+        __m128 z = _mm_sub_ps(_mm_mul_ps(cr, cpsy), _mm_mul_ps(sr, spcy));
+        __m128 w = _mm_add_ps(_mm_mul_ps(cr, cpcy), _mm_mul_ps(sr, spsy));
+
+        detail::storeQuatx4(x, y, z, w, result + i);
+    }
+    for (; i < count; ++i) {
+        result[i] = quatFromEulerAngles(eulerAngles[i]);
+    }
+}
+
+template<>
+inline void quatToEulerAnglesBatch(const tquat<f32>* quats, tvec3<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = quats[i + 0].simd();
+        __m128 y = quats[i + 1].simd();
+        __m128 z = quats[i + 2].simd();
+        __m128 w = quats[i + 3].simd();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+
+        __m128 sinRollCosPitch = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(w, x), _mm_mul_ps(y, z)));
+        __m128 cosRollCosPitch = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+        __m128 roll = fast::atan2(sinRollCosPitch, cosRollCosPitch);
+
+        // (asin(x) = atan2(x, sqrt(1 - x^2)), which also clamps to +-90 degrees for |x| >= 1)
+        __m128 sinPitch = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(w, y), _mm_mul_ps(z, x)));
+        __m128 cosPitch = _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(one, _mm_mul_ps(sinPitch, sinPitch))));
+        __m128 pitch = fast::atan2(sinPitch, cosPitch);
+
+        __m128 sinYawCosPitch = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(w, z), _mm_mul_ps(x, y)));
+        __m128 cosYawCosPitch = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+        __m128 yaw = fast::atan2(sinYawCosPitch, cosYawCosPitch);
+
+        __m128 unused = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(roll, pitch, yaw, unused);
+        result[i + 0] = simd::storeVec3(roll);
+        result[i + 1] = simd::storeVec3(pitch);
+        result[i + 2] = simd::storeVec3(yaw);
+        result[i + 3] = simd::storeVec3(unused);
+    }
+    for (; i < count; ++i) {
+        result[i] = quatToEulerAngles(quats[i]);
+    }
+}
+
+#endif
+
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
 constexpr tmat4<T> quatToMatrix(const tquat<T>& q)
 {
@@ -194,7 +526,7 @@ constexpr tmat4<T> quatToMatrix(const tquat<T>& q)
 }
 
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
-constexpr tquat<T> quatFromMatrix(const tmat4<T>& m)
+constexpr tquat<T> quatFromMatrix(const tmat3<T>& m)
 {
     // This function is a rewritten version of Mike Day's "Converting a Rotation Matrix to a Quaternion" code. Probably not official,
     // but a copy of the document can be found at https://d3cw3dd2w32x2b.cloudfront.net/wp-content/uploads/2015/01/matrix-to-quat.pdf
@@ -231,6 +563,1434 @@ constexpr tquat<T> quatFromMatrix(const tmat4<T>& m)
     return q;
 }
 
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tquat<T> quatFromMatrix(const tmat4<T>& m)
+{
+    return quatFromMatrix(tmat3<T>(m));
+}
+
+// Batch conversions, e.g. for building the bone palette for skinning. Translations and scales are optional (nullptr
+// means no translation and unit scale). The tmat3x4 versions write the transposed upper 3x4 part of the affine matrix,
+// i.e., the three rows of the transform with the translation in w, which is the usual layout for bone palettes.
+
+namespace detail {
+
+    template<typename T>
+    tmat4<T> quatToMatrixWithTranslationScale(const tquat<T>& rotation, const tvec3<T>* translation, const tvec3<T>* scale)
+    {
+        tmat4<T> m = quatToMatrix(rotation);
+        if (scale) {
+            m.x = tvec4<T>(m.x.xyz() * scale->x, static_cast<T>(0));
+            m.y = tvec4<T>(m.y.xyz() * scale->y, static_cast<T>(0));
+            m.z = tvec4<T>(m.z.xyz() * scale->z, static_cast<T>(0));
+        }
+        if (translation) {
+            m.w = tvec4<T>(*translation, static_cast<T>(1));
+        }
+        return m;
+    }
+
+    template<typename T>
+    void storeTransposedAffine(const tmat4<T>& m, tmat3x4<T>& result)
+    {
+        tmat4<T> rows = transpose(m);
+        result.x = rows.x;
+        result.y = rows.y;
+        result.z = rows.z;
+    }
+
+    template<typename T>
+    void decomposeMatrixWithoutShear(const tmat4<T>& m, tquat<T>& rotation, tvec3<T>* translation, tvec3<T>* scale)
+    {
+        tvec3<T> s = { length(m.x.xyz()), length(m.y.xyz()), length(m.z.xyz()) };
+        rotation = quatFromMatrix(tmat3<T>(m.x.xyz() / s.x, m.y.xyz() / s.y, m.z.xyz() / s.z));
+        if (translation) {
+            *translation = m.w.xyz();
+        }
+        if (scale) {
+            *scale = s;
+        }
+    }
+
+} // namespace detail
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void quatToMatrixBatch(const tquat<T>* rotations, const tvec3<T>* translations, const tvec3<T>* scales, tmat4<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = detail::quatToMatrixWithTranslationScale(rotations[i], translations ? translations + i : nullptr, scales ? scales + i : nullptr);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void quatToMatrixBatch(const tquat<T>* rotations, const tvec3<T>* translations, const tvec3<T>* scales, tmat3x4<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        tmat4<T> m = detail::quatToMatrixWithTranslationScale(rotations[i], translations ? translations + i : nullptr, scales ? scales + i : nullptr);
+        detail::storeTransposedAffine(m, result[i]);
+    }
+}
+
+// Decomposes matrices into rotation, translation, and scale, assuming each matrix is a (non-mirroring) rotation, translation,
+// and axis-aligned scale without shear. Translations and scales are optional (nullptr means they are not written).
+// For general affine matrices (with shear or mirroring) use decompose/decomposeBatch in transform.h instead.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void quatFromMatrixBatch(const tmat4<T>* matrices, tquat<T>* rotations, tvec3<T>* translations, tvec3<T>* scales, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        detail::decomposeMatrixWithoutShear(matrices[i], rotations[i], translations ? translations + i : nullptr, scales ? scales + i : nullptr);
+    }
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    inline void quatToMatrixEntries4(const tquat<f32>* rotations, const tvec3<f32>* scales, __m128 m[3][3])
+    {
+        // Computes the rotation matrix entries m[column][row] (optionally scaled) of four quaternions, as in quatToMatrix
+
+        __m128 b = rotations[0].simd();
+        __m128 c = rotations[1].simd();
+        __m128 d = rotations[2].simd();
+        __m128 a = rotations[3].simd();
+        _MM_TRANSPOSE4_PS(b, c, d, a);
+
+        const __m128 two = _mm_set1_ps(2.0f);
+        __m128 a2 = _mm_mul_ps(a, a), b2 = _mm_mul_ps(b, b), c2 = _mm_mul_ps(c, c), d2 = _mm_mul_ps(d, d);
+        __m128 ab = _mm_mul_ps(a, b), ac = _mm_mul_ps(a, c), ad = _mm_mul_ps(a, d);
+        __m128 bc = _mm_mul_ps(b, c), bd = _mm_mul_ps(b, d), cd = _mm_mul_ps(c, d);
+
+        m[0][0] = _mm_sub_ps(_mm_add_ps(a2, b2), _mm_add_ps(c2, d2));
+        m[0][1] = _mm_mul_ps(two, _mm_add_ps(bc, ad));
+        m[0][2] = _mm_mul_ps(two, _mm_sub_ps(bd, ac));
+
+        m[1][0] = _mm_mul_ps(two, _mm_sub_ps(bc, ad));
+        m[1][1] = _mm_sub_ps(_mm_add_ps(a2, c2), _mm_add_ps(b2, d2));
+        m[1][2] = _mm_mul_ps(two, _mm_add_ps(cd, ab));
+
+        m[2][0] = _mm_mul_ps(two, _mm_add_ps(bd, ac));
+        m[2][1] = _mm_mul_ps(two, _mm_sub_ps(cd, ab));
+        m[2][2] = _mm_sub_ps(_mm_add_ps(a2, d2), _mm_add_ps(b2, c2));
+
+        if (scales) {
+            __m128 s[3] = {
+                _mm_setr_ps(scales[0].x, scales[1].x, scales[2].x, scales[3].x),
+                _mm_setr_ps(scales[0].y, scales[1].y, scales[2].y, scales[3].y),
+                _mm_setr_ps(scales[0].z, scales[1].z, scales[2].z, scales[3].z)
+            };
+            for (int col = 0; col < 3; ++col) {
+                for (int row = 0; row < 3; ++row) {
+                    m[col][row] = _mm_mul_ps(m[col][row], s[col]);
+                }
+            }
+        }
+    }
+
+    inline void loadTranslations4(const tvec3<f32>* translations, __m128 t[3])
+    {
+        if (translations) {
+            t[0] = _mm_setr_ps(translations[0].x, translations[1].x, translations[2].x, translations[3].x);
+            t[1] = _mm_setr_ps(translations[0].y, translations[1].y, translations[2].y, translations[3].y);
+            t[2] = _mm_setr_ps(translations[0].z, translations[1].z, translations[2].z, translations[3].z);
+        } else {
+            t[0] = t[1] = t[2] = _mm_setzero_ps();
+        }
+    }
+
+    // Branch-free version of quatFromMatrix for four rotation matrices, where m[column][row] holds that entry for the
+    // four matrices: compute all four cases and select per lane
+    inline void quatFromMatrixEntries4(const __m128 m[3][3], tquat<f32>* result)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 m00 = m[0][0], m11 = m[1][1], m22 = m[2][2];
+
+        __m128 tA = _mm_sub_ps(_mm_add_ps(one, m00), _mm_add_ps(m11, m22));
+        __m128 tB = _mm_sub_ps(_mm_add_ps(one, m11), _mm_add_ps(m00, m22));
+        __m128 tC = _mm_sub_ps(_mm_add_ps(one, m22), _mm_add_ps(m00, m11));
+        __m128 tD = _mm_add_ps(_mm_add_ps(one, m00), _mm_add_ps(m11, m22));
+
+        __m128 xyPlusYx = _mm_add_ps(m[0][1], m[1][0]), xyMinusYx = _mm_sub_ps(m[0][1], m[1][0]);
+        __m128 zxPlusXz = _mm_add_ps(m[2][0], m[0][2]), zxMinusXz = _mm_sub_ps(m[2][0], m[0][2]);
+        __m128 yzPlusZy = _mm_add_ps(m[1][2], m[2][1]), yzMinusZy = _mm_sub_ps(m[1][2], m[2][1]);
+
+        __m128 caseZNeg = _mm_cmplt_ps(m22, _mm_setzero_ps());
+        __m128 caseA = _mm_and_ps(caseZNeg, _mm_cmpgt_ps(m00, m11));
+        __m128 caseB = _mm_andnot_ps(caseA, caseZNeg);
+        __m128 caseC = _mm_andnot_ps(caseZNeg, _mm_cmplt_ps(m00, _mm_sub_ps(_mm_setzero_ps(), m11)));
+
+        auto select = [](__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+            return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+        };
+        auto select4 = [&](__m128 a, __m128 b, __m128 c, __m128 d) {
+            return select(caseA, a, select(caseB, b, select(caseC, c, d)));
+        };
+
+        __m128 t = select4(tA, tB, tC, tD);
+        __m128 qx = select4(tA, xyPlusYx, zxPlusXz, yzMinusZy);
+        __m128 qy = select4(xyPlusYx, tB, yzPlusZy, zxMinusXz);
+        __m128 qz = select4(zxPlusXz, yzPlusZy, tC, xyMinusYx);
+        __m128 qw = select4(yzMinusZy, zxMinusXz, xyMinusYx, tD);
+
+        __m128 s = _mm_div_ps(_mm_set1_ps(0.5f), _mm_sqrt_ps(t));
+        qx = _mm_mul_ps(qx, s);
+        qy = _mm_mul_ps(qy, s);
+        qz = _mm_mul_ps(qz, s);
+        qw = _mm_mul_ps(qw, s);
+
+        storeQuatx4(qx, qy, qz, qw, result);
+    }
+
+} // namespace detail
+
+template<>
+inline void quatToMatrixBatch(const tquat<f32>* rotations, const tvec3<f32>* translations, const tvec3<f32>* scales, tmat4<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 m[3][3];
+        __m128 t[3];
+        detail::quatToMatrixEntries4(rotations + i, scales ? scales + i : nullptr, m);
+        detail::loadTranslations4(translations ? translations + i : nullptr, t);
+
+        // Transpose from one lane per matrix to one register per matrix column
+        __m128 columns[4][4];
+        for (int col = 0; col < 3; ++col) {
+            __m128 x = m[col][0], y = m[col][1], z = m[col][2], w = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            columns[col][0] = x, columns[col][1] = y, columns[col][2] = z, columns[col][3] = w;
+        }
+        __m128 x = t[0], y = t[1], z = t[2], w = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        columns[3][0] = x, columns[3][1] = y, columns[3][2] = z, columns[3][3] = w;
+
+        for (int j = 0; j < 4; ++j) {
+            f32* dst = value_ptr(result[i + j]);
+            _mm_storeu_ps(dst + 0, columns[0][j]);
+            _mm_storeu_ps(dst + 4, columns[1][j]);
+            _mm_storeu_ps(dst + 8, columns[2][j]);
+            _mm_storeu_ps(dst + 12, columns[3][j]);
+        }
+    }
+
+    for (; i < count; ++i) {
+        result[i] = detail::quatToMatrixWithTranslationScale(rotations[i], translations ? translations + i : nullptr, scales ? scales + i : nullptr);
+    }
+}
+
+namespace detail {
+
+    inline void quatToMatrix3x4Scalar(const tquat<f32>* rotations, const tvec3<f32>* translations, const tvec3<f32>* scales, tmat3x4<f32>* result, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            tmat4<f32> m = quatToMatrixWithTranslationScale(rotations[i], translations ? translations + i : nullptr, scales ? scales + i : nullptr);
+            storeTransposedAffine(m, result[i]);
+        }
+    }
+
+    inline void quatToMatrix3x4SSE2(const tquat<f32>* rotations, const tvec3<f32>* translations, const tvec3<f32>* scales, tmat3x4<f32>* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 m[3][3];
+            __m128 t[3];
+            quatToMatrixEntries4(rotations + i, scales ? scales + i : nullptr, m);
+            loadTranslations4(translations ? translations + i : nullptr, t);
+
+            // Transpose from one lane per matrix to one register per matrix row
+            __m128 rows[3][4];
+            for (int row = 0; row < 3; ++row) {
+                __m128 x = m[0][row], y = m[1][row], z = m[2][row], w = t[row];
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+                rows[row][0] = x, rows[row][1] = y, rows[row][2] = z, rows[row][3] = w;
+            }
+
+            for (int j = 0; j < 4; ++j) {
+                f32* dst = value_ptr(result[i + j]);
+                _mm_storeu_ps(dst + 0, rows[0][j]);
+                _mm_storeu_ps(dst + 4, rows[1][j]);
+                _mm_storeu_ps(dst + 8, rows[2][j]);
+            }
+        }
+        quatToMatrix3x4Scalar(rotations + i, translations ? translations + i : nullptr, scales ? scales + i : nullptr, result + i, count - i);
+    }
+
+#ifdef MOOS_DISPATCH
+
+    // Transposes the 4x4 matrix in each 128-bit lane, like _MM_TRANSPOSE4_PS
+    MOOS_TARGET_AVX2 inline void transpose4x4LanesAVX2(__m256& a, __m256& b, __m256& c, __m256& d)
+    {
+        __m256 t0 = _mm256_unpacklo_ps(a, b);
+        __m256 t1 = _mm256_unpackhi_ps(a, b);
+        __m256 t2 = _mm256_unpacklo_ps(c, d);
+        __m256 t3 = _mm256_unpackhi_ps(c, d);
+        a = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        b = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        c = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        d = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    // The same as the SSE2 version for eight quaternions at a time, with quaternions 0-3 in the low 128-bit lanes and
+    // 4-7 in the high lanes. It doesn't use FMA, so the results are bit-identical to the SSE2 version.
+    MOOS_TARGET_AVX2 inline void quatToMatrix3x4AVX2(const tquat<f32>* rotations, const tvec3<f32>* translations, const tvec3<f32>* scales, tmat3x4<f32>* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const tquat<f32>* q = rotations + i;
+            __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(q[0].simd()), q[4].simd(), 1);
+            __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(q[1].simd()), q[5].simd(), 1);
+            __m256 d = _mm256_insertf128_ps(_mm256_castps128_ps256(q[2].simd()), q[6].simd(), 1);
+            __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(q[3].simd()), q[7].simd(), 1);
+            transpose4x4LanesAVX2(b, c, d, a);
+
+            const __m256 two = _mm256_set1_ps(2.0f);
+            __m256 a2 = _mm256_mul_ps(a, a), b2 = _mm256_mul_ps(b, b), c2 = _mm256_mul_ps(c, c), d2 = _mm256_mul_ps(d, d);
+            __m256 ab = _mm256_mul_ps(a, b), ac = _mm256_mul_ps(a, c), ad = _mm256_mul_ps(a, d);
+            __m256 bc = _mm256_mul_ps(b, c), bd = _mm256_mul_ps(b, d), cd = _mm256_mul_ps(c, d);
+
+            __m256 m[3][3];
+            m[0][0] = _mm256_sub_ps(_mm256_add_ps(a2, b2), _mm256_add_ps(c2, d2));
+            m[0][1] = _mm256_mul_ps(two, _mm256_add_ps(bc, ad));
+            m[0][2] = _mm256_mul_ps(two, _mm256_sub_ps(bd, ac));
+            m[1][0] = _mm256_mul_ps(two, _mm256_sub_ps(bc, ad));
+            m[1][1] = _mm256_sub_ps(_mm256_add_ps(a2, c2), _mm256_add_ps(b2, d2));
+            m[1][2] = _mm256_mul_ps(two, _mm256_add_ps(cd, ab));
+            m[2][0] = _mm256_mul_ps(two, _mm256_add_ps(bd, ac));
+            m[2][1] = _mm256_mul_ps(two, _mm256_sub_ps(cd, ab));
+            m[2][2] = _mm256_sub_ps(_mm256_add_ps(a2, d2), _mm256_add_ps(b2, c2));
+
+            // (the lanes are in the order 0-3, 4-7, i.e., the same as the vectors)
+            if (scales) {
+                const tvec3<f32>* s = scales + i;
+                __m256 sx = _mm256_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x, s[4].x, s[5].x, s[6].x, s[7].x);
+                __m256 sy = _mm256_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y, s[4].y, s[5].y, s[6].y, s[7].y);
+                __m256 sz = _mm256_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z, s[4].z, s[5].z, s[6].z, s[7].z);
+                for (int row = 0; row < 3; ++row) {
+                    m[0][row] = _mm256_mul_ps(m[0][row], sx);
+                    m[1][row] = _mm256_mul_ps(m[1][row], sy);
+                    m[2][row] = _mm256_mul_ps(m[2][row], sz);
+                }
+            }
+            __m256 t[3] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+            if (translations) {
+                const tvec3<f32>* p = translations + i;
+                t[0] = _mm256_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x, p[4].x, p[5].x, p[6].x, p[7].x);
+                t[1] = _mm256_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y, p[4].y, p[5].y, p[6].y, p[7].y);
+                t[2] = _mm256_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z, p[4].z, p[5].z, p[6].z, p[7].z);
+            }
+
+            // Transpose from one lane per matrix to one 128-bit half per matrix row
+            for (int row = 0; row < 3; ++row) {
+                __m256 x = m[0][row], y = m[1][row], z = m[2][row], w = t[row];
+                transpose4x4LanesAVX2(x, y, z, w);
+                __m256 rows[4] = { x, y, z, w };
+                for (int j = 0; j < 4; ++j) {
+                    _mm_storeu_ps(value_ptr(result[i + j]) + 4 * row, _mm256_castps256_ps128(rows[j]));
+                    _mm_storeu_ps(value_ptr(result[i + 4 + j]) + 4 * row, _mm256_extractf128_ps(rows[j], 1));
+                }
+            }
+        }
+        quatToMatrix3x4SSE2(rotations + i, translations ? translations + i : nullptr, scales ? scales + i : nullptr, result + i, count - i);
+    }
+
+#endif
+
+} // namespace detail
+
+// (for the bone palette this is dispatched to the best kernel for the CPU, e.g. eight quaternions at a time with AVX2)
+template<>
+inline void quatToMatrixBatch(const tquat<f32>* rotations, const tvec3<f32>* translations, const tvec3<f32>* scales, tmat3x4<f32>* result, size_t count)
+{
+    using Kernel = void (*)(const tquat<f32>*, const tvec3<f32>*, const tvec3<f32>*, tmat3x4<f32>*, size_t);
+    static const KernelTable<Kernel> kernels = {
+        { SimdLevel::Scalar, detail::quatToMatrix3x4Scalar },
+        { SimdLevel::SSE2, detail::quatToMatrix3x4SSE2 },
+#ifdef MOOS_DISPATCH
+        { SimdLevel::AVX2, detail::quatToMatrix3x4AVX2 },
+#endif
+    };
+    kernels.select()(rotations, translations, scales, result, count);
+}
+
+template<>
+inline void quatFromMatrixBatch(const tmat4<f32>* matrices, tquat<f32>* rotations, tvec3<f32>* translations, tvec3<f32>* scales, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+
+        // Load & transpose so that m[column][row] holds that entry for the four matrices
+        __m128 m[3][3];
+        for (int col = 0; col < 3; ++col) {
+            __m128 x = _mm_loadu_ps(value_ptr(matrices[i + 0]) + 4 * col);
+            __m128 y = _mm_loadu_ps(value_ptr(matrices[i + 1]) + 4 * col);
+            __m128 z = _mm_loadu_ps(value_ptr(matrices[i + 2]) + 4 * col);
+            __m128 w = _mm_loadu_ps(value_ptr(matrices[i + 3]) + 4 * col);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            m[col][0] = x, m[col][1] = y, m[col][2] = z;
+        }
+
+        __m128 scale[3];
+        for (int col = 0; col < 3; ++col) {
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[col][0], m[col][0]), _mm_mul_ps(m[col][1], m[col][1])), _mm_mul_ps(m[col][2], m[col][2]));
+            scale[col] = _mm_sqrt_ps(length2);
+            __m128 invScale = _mm_div_ps(_mm_set1_ps(1.0f), scale[col]);
+            for (int row = 0; row < 3; ++row) {
+                m[col][row] = _mm_mul_ps(m[col][row], invScale);
+            }
+        }
+
+        detail::quatFromMatrixEntries4(m, rotations + i);
+
+        if (translations) {
+            for (int j = 0; j < 4; ++j) {
+                translations[i + j] = matrices[i + j].w.xyz();
+            }
+        }
+        if (scales) {
+            __m128 x = scale[0], y = scale[1], z = scale[2], w = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            scales[i + 0] = simd::storeVec3(x);
+            scales[i + 1] = simd::storeVec3(y);
+            scales[i + 2] = simd::storeVec3(z);
+            scales[i + 3] = simd::storeVec3(w);
+        }
+    }
+
+    for (; i < count; ++i) {
+        detail::decomposeMatrixWithoutShear(matrices[i], rotations[i], translations ? translations + i : nullptr, scales ? scales + i : nullptr);
+    }
+}
+
+#endif
+
+// Orientation from directions
+
+// Returns the rotation which rotates globalForward to forward and globalUp to (the part orthogonal to forward of) tempUp,
+// i.e., the rotation part of the inverse of lookAt. As for lookAt, forward must not be parallel to tempUp.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> lookRotation(const tvec3<T>& forward, const tvec3<T>& tempUp = tvec3<T>(0, 1, 0))
+{
+    tvec3<T> f = normalize(forward);
+    tvec3<T> right = normalize(cross(f, tempUp));
+    tvec3<T> up = cross(right, f);
+    return quatFromMatrix(tmat3<T>(right, up, -f));
+}
+
+// Returns the shortest arc rotation which rotates the direction from to the direction to. The inputs don't have to be
+// normalized. For opposite directions the result is a half turn around some axis orthogonal to from.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> rotationBetween(const tvec3<T>& from, const tvec3<T>& to)
+{
+    // Using the half-way trick, i.e., q = normalize(cross(a, b), |a||b| + dot(a, b)) without any trigonometry
+    T lengths = std::sqrt(length2(from) * length2(to));
+    T w = lengths + dot(from, to);
+    if (w <= static_cast<T>(1e-6) * lengths) {
+        tvec3<T> axis = (std::abs(from.x) > std::abs(from.z)) ? tvec3<T>(-from.y, from.x, 0) : tvec3<T>(0, -from.z, from.y);
+        return tquat<T>(normalize(axis), static_cast<T>(0));
+    }
+    return normalize(tquat<T>(cross(from, to), w));
+}
+
+// Batch versions, e.g. for orienting many billboards, turrets, or bones per frame. For lookRotationBatch, ups is optional
+// (nullptr means globalUp for all). For f32 these are branch-free SSE versions that don't go via the scalar code.
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void lookRotationBatch(const tvec3<T>* forwards, const tvec3<T>* ups, tquat<T>* result, size_t count)
+{
+    const tvec3<T> defaultUp = tvec3<T>(0, 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = lookRotation(forwards[i], ups ? ups[i] : defaultUp);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void rotationBetweenBatch(const tvec3<T>* from, const tvec3<T>* to, tquat<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = rotationBetween(from[i], to[i]);
+    }
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    inline void cross3x4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz, __m128& x, __m128& y, __m128& z)
+    {
+        x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+        y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+        z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+    }
+
+    inline void normalize3x4(__m128& x, __m128& y, __m128& z)
+    {
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+        x = _mm_mul_ps(x, invLength);
+        y = _mm_mul_ps(y, invLength);
+        z = _mm_mul_ps(z, invLength);
+    }
+
+} // namespace detail
+
+template<>
+inline void lookRotationBatch(const tvec3<f32>* forwards, const tvec3<f32>* ups, tquat<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 fx, fy, fz;
+        detail::loadVec3x4(forwards + i, fx, fy, fz);
+        detail::normalize3x4(fx, fy, fz);
+
+        __m128 tx, ty, tz;
+        if (ups) {
+            detail::loadVec3x4(ups + i, tx, ty, tz);
+        } else {
+            tx = tz = _mm_setzero_ps();
+            ty = _mm_set1_ps(1.0f);
+        }
+
+        __m128 m[3][3];
+        detail::cross3x4(fx, fy, fz, tx, ty, tz, m[0][0], m[0][1], m[0][2]);
+        detail::normalize3x4(m[0][0], m[0][1], m[0][2]);
+        detail::cross3x4(m[0][0], m[0][1], m[0][2], fx, fy, fz, m[1][0], m[1][1], m[1][2]);
+
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        m[2][0] = _mm_xor_ps(fx, signMask);
+        m[2][1] = _mm_xor_ps(fy, signMask);
+        m[2][2] = _mm_xor_ps(fz, signMask);
+
+        detail::quatFromMatrixEntries4(m, result + i);
+    }
+
+    const tvec3<f32> defaultUp = tvec3<f32>(0, 1, 0);
+    for (; i < count; ++i) {
+        result[i] = lookRotation(forwards[i], ups ? ups[i] : defaultUp);
+    }
+}
+
+template<>
+inline void rotationBetweenBatch(const tvec3<f32>* from, const tvec3<f32>* to, tquat<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ax, ay, az, bx, by, bz;
+        detail::loadVec3x4(from + i, ax, ay, az);
+        detail::loadVec3x4(to + i, bx, by, bz);
+
+        __m128 length2A = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)), _mm_mul_ps(az, az));
+        __m128 length2B = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, bx), _mm_mul_ps(by, by)), _mm_mul_ps(bz, bz));
+        __m128 lengths = _mm_sqrt_ps(_mm_mul_ps(length2A, length2B));
+        __m128 dotAB = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+
+        __m128 x, y, z;
+        detail::cross3x4(ax, ay, az, bx, by, bz, x, y, z);
+        __m128 w = _mm_add_ps(lengths, dotAB);
+
+        // For (close to) opposite directions use a half turn around an axis orthogonal to from, selected per lane
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 opposite = _mm_cmple_ps(w, _mm_mul_ps(_mm_set1_ps(1e-6f), lengths));
+        __m128 useXY = _mm_cmpgt_ps(_mm_andnot_ps(signMask, ax), _mm_andnot_ps(signMask, az));
+        auto select = [](__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+            return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+        };
+        __m128 ox = select(useXY, _mm_xor_ps(ay, signMask), _mm_setzero_ps());
+        __m128 oy = select(useXY, ax, _mm_xor_ps(az, signMask));
+        __m128 oz = select(useXY, _mm_setzero_ps(), ay);
+        x = select(opposite, ox, x);
+        y = select(opposite, oy, y);
+        z = select(opposite, oz, z);
+        w = _mm_andnot_ps(opposite, w);
+
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+        __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+        detail::storeQuatx4(_mm_mul_ps(x, invLength), _mm_mul_ps(y, invLength), _mm_mul_ps(z, invLength), _mm_mul_ps(w, invLength), result + i);
+    }
+
+    for (; i < count; ++i) {
+        result[i] = rotationBetween(from[i], to[i]);
+    }
+}
+
+#endif
+
+// Interpolation
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tquat<T> nlerp(const tquat<T>& a, const tquat<T>& b, T t)
+{
+    // Interpolates along the shortest path, i.e., flips b if a and b are in different hemispheres
+    T tb = (dot(a, b) < static_cast<T>(0)) ? -t : t;
+    T ta = static_cast<T>(1) - t;
+    return normalize(tquat<T>(ta * a.vec + tb * b.vec, ta * a.w + tb * b.w));
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> slerp(const tquat<T>& a, const tquat<T>& b, T t)
+{
+    // Interpolates along the shortest path, i.e., flips b if a and b are in different hemispheres
+
+    T cosTheta = dot(a, b);
+    T sign = static_cast<T>(1);
+    if (cosTheta < static_cast<T>(0)) {
+        cosTheta = -cosTheta;
+        sign = -sign;
+    }
+
+    // For (almost) parallel quaternions sin(theta) goes to zero, but then nlerp is accurate anyway
+    if (cosTheta > static_cast<T>(1) - std::numeric_limits<T>::epsilon()) {
+        return nlerp(a, b, t);
+    }
+
+    T theta = std::acos(cosTheta);
+    T invSinTheta = static_cast<T>(1) / std::sin(theta);
+    T ta = std::sin((static_cast<T>(1) - t) * theta) * invSinTheta;
+    T tb = std::sin(t * theta) * invSinTheta * sign;
+
+    return { ta * a.vec + tb * b.vec, ta * a.w + tb * b.w };
+}
+
+namespace detail {
+
+    // Coefficients for slerpFast, using the method from "A Fast and Accurate Algorithm for Computing SLERP" by David Eberly
+    // (https://www.geometrictools.com/Documentation/FastAndAccurateSlerp.pdf). The slerp weight sin(t * theta) / sin(theta)
+    // is evaluated as a truncated series in cos(theta) - 1, where the last term is scaled to minimize the max. error.
+
+    constexpr double slerpFastOnePlusMu = 1.85298109240830;
+    constexpr double slerpFastU[8] = {
+        1.0 / (1 * 3), 1.0 / (2 * 5), 1.0 / (3 * 7), 1.0 / (4 * 9),
+        1.0 / (5 * 11), 1.0 / (6 * 13), 1.0 / (7 * 15), slerpFastOnePlusMu / (8 * 17)
+    };
+    constexpr double slerpFastV[8] = {
+        1.0 / 3, 2.0 / 5, 3.0 / 7, 4.0 / 9,
+        5.0 / 11, 6.0 / 13, 7.0 / 15, slerpFastOnePlusMu * 8.0 / 17
+    };
+
+    template<typename T>
+    constexpr T slerpFastWeight(T t, T cosThetaMinusOne)
+    {
+        T t2 = t * t;
+        T weight = static_cast<T>(1);
+        for (int i = 7; i >= 0; --i) {
+            T b = static_cast<T>(slerpFastU[i]) * t2 - static_cast<T>(slerpFastV[i]);
+            weight = static_cast<T>(1) + b * cosThetaMinusOne * weight;
+        }
+        return t * weight;
+    }
+
+#ifdef MOOS_SSE
+    inline __m128 slerpFastWeight(__m128 t, __m128 cosThetaMinusOne)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 weight = one;
+        for (int i = 7; i >= 0; --i) {
+            __m128 b = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(static_cast<f32>(slerpFastU[i])), t2), _mm_set1_ps(static_cast<f32>(slerpFastV[i])));
+            weight = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(b, cosThetaMinusOne), weight));
+        }
+        return _mm_mul_ps(t, weight);
+    }
+#endif
+
+#ifdef MOOS_AVX2
+    inline __m256 slerpFastWeight(__m256 t, __m256 cosThetaMinusOne)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 weight = one;
+        for (int i = 7; i >= 0; --i) {
+            __m256 b = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(static_cast<f32>(slerpFastU[i])), t2), _mm256_set1_ps(static_cast<f32>(slerpFastV[i])));
+            weight = _mm256_add_ps(one, _mm256_mul_ps(_mm256_mul_ps(b, cosThetaMinusOne), weight));
+        }
+        return _mm256_mul_ps(t, weight);
+    }
+#endif
+
+} // namespace detail
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tquat<T> slerpFast(const tquat<T>& a, const tquat<T>& b, T t)
+{
+    // Branch-free approximation of slerp (along the shortest path) without any trigonometric functions. The max.
+    // error per component compared to slerp is around 2e-5, so for most purposes it does not need normalization.
+
+    T cosTheta = dot(a, b);
+    T sign = (cosTheta < static_cast<T>(0)) ? -static_cast<T>(1) : static_cast<T>(1);
+    T cosThetaMinusOne = sign * cosTheta - static_cast<T>(1);
+
+    T ta = detail::slerpFastWeight(static_cast<T>(1) - t, cosThetaMinusOne);
+    T tb = detail::slerpFastWeight(t, cosThetaMinusOne) * sign;
+
+    return { ta * a.vec + tb * b.vec, ta * a.w + tb * b.w };
+}
+
+// Quaternion packets, i.e., N quaternions stored as structure-of-arrays. The generic packet functions are written
+// as simple fixed-length loops over the lanes, which the compiler may vectorize. The 4-lane f32 versions are explicitly
+// written with SSE, and the 8-lane f32 versions with AVX2 if it's enabled at compile time (see MOOS_AVX2).
+
+template<typename T, int N>
+struct alignas(detail::vecNAlignment(N * sizeof(T), alignof(T))) tquatPacket {
+    T x[N], y[N], z[N], w[N];
+};
+
+template<int N>
+using quatPacket = tquatPacket<Float, N>;
+
+template<typename T, int N>
+void loadPacket(tquatPacket<T, N>& packet, const tquat<T>* quats)
+{
+    for (int i = 0; i < N; ++i) {
+        packet.x[i] = quats[i].vec.x;
+        packet.y[i] = quats[i].vec.y;
+        packet.z[i] = quats[i].vec.z;
+        packet.w[i] = quats[i].w;
+    }
+}
+
+template<typename T, int N>
+void storePacket(const tquatPacket<T, N>& packet, tquat<T>* quats)
+{
+    for (int i = 0; i < N; ++i) {
+        quats[i].vec = { packet.x[i], packet.y[i], packet.z[i] };
+        quats[i].w = packet.w[i];
+    }
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline void loadPacket(tquatPacket<f32, 4>& packet, const tquat<f32>* quats)
+{
+    __m128 x = quats[0].simd();
+    __m128 y = quats[1].simd();
+    __m128 z = quats[2].simd();
+    __m128 w = quats[3].simd();
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_store_ps(packet.x, x);
+    _mm_store_ps(packet.y, y);
+    _mm_store_ps(packet.z, z);
+    _mm_store_ps(packet.w, w);
+}
+
+template<>
+inline void storePacket(const tquatPacket<f32, 4>& packet, tquat<f32>* quats)
+{
+    __m128 q0 = _mm_load_ps(packet.x);
+    __m128 q1 = _mm_load_ps(packet.y);
+    __m128 q2 = _mm_load_ps(packet.z);
+    __m128 q3 = _mm_load_ps(packet.w);
+    _MM_TRANSPOSE4_PS(q0, q1, q2, q3);
+    quats[0] = tquat<f32>(q0);
+    quats[1] = tquat<f32>(q1);
+    quats[2] = tquat<f32>(q2);
+    quats[3] = tquat<f32>(q3);
+}
+
+#endif
+
+#ifdef MOOS_AVX2
+
+namespace detail {
+
+    // Transposes the 4x4 matrix in each 128-bit lane, like _MM_TRANSPOSE4_PS
+    inline void transpose4x4Lanes(__m256& a, __m256& b, __m256& c, __m256& d)
+    {
+        __m256 t0 = _mm256_unpacklo_ps(a, b);
+        __m256 t1 = _mm256_unpackhi_ps(a, b);
+        __m256 t2 = _mm256_unpacklo_ps(c, d);
+        __m256 t3 = _mm256_unpackhi_ps(c, d);
+        a = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        b = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        c = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        d = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+} // namespace detail
+
+template<>
+inline void loadPacket(tquatPacket<f32, 8>& packet, const tquat<f32>* quats)
+{
+    // (quaternions 0-3 go in the low lanes and 4-7 in the high lanes)
+    __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(quats[0].simd()), quats[4].simd(), 1);
+    __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(quats[1].simd()), quats[5].simd(), 1);
+    __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(quats[2].simd()), quats[6].simd(), 1);
+    __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(quats[3].simd()), quats[7].simd(), 1);
+    detail::transpose4x4Lanes(x, y, z, w);
+    _mm256_store_ps(packet.x, x);
+    _mm256_store_ps(packet.y, y);
+    _mm256_store_ps(packet.z, z);
+    _mm256_store_ps(packet.w, w);
+}
+
+template<>
+inline void storePacket(const tquatPacket<f32, 8>& packet, tquat<f32>* quats)
+{
+    __m256 q0 = _mm256_load_ps(packet.x);
+    __m256 q1 = _mm256_load_ps(packet.y);
+    __m256 q2 = _mm256_load_ps(packet.z);
+    __m256 q3 = _mm256_load_ps(packet.w);
+    detail::transpose4x4Lanes(q0, q1, q2, q3);
+    quats[0] = tquat<f32>(_mm256_castps256_ps128(q0));
+    quats[1] = tquat<f32>(_mm256_castps256_ps128(q1));
+    quats[2] = tquat<f32>(_mm256_castps256_ps128(q2));
+    quats[3] = tquat<f32>(_mm256_castps256_ps128(q3));
+    quats[4] = tquat<f32>(_mm256_extractf128_ps(q0, 1));
+    quats[5] = tquat<f32>(_mm256_extractf128_ps(q1, 1));
+    quats[6] = tquat<f32>(_mm256_extractf128_ps(q2, 1));
+    quats[7] = tquat<f32>(_mm256_extractf128_ps(q3, 1));
+}
+
+#endif
+
+template<typename T, int N>
+tquatPacket<T, N> operator*(const tquatPacket<T, N>& p, const tquatPacket<T, N>& q)
+{
+    tquatPacket<T, N> res;
+    for (int i = 0; i < N; ++i) {
+        res.x[i] = p.w[i] * q.x[i] + p.x[i] * q.w[i] + p.y[i] * q.z[i] - p.z[i] * q.y[i];
+        res.y[i] = p.w[i] * q.y[i] - p.x[i] * q.z[i] + p.y[i] * q.w[i] + p.z[i] * q.x[i];
+        res.z[i] = p.w[i] * q.z[i] + p.x[i] * q.y[i] - p.y[i] * q.x[i] + p.z[i] * q.w[i];
+        res.w[i] = p.w[i] * q.w[i] - p.x[i] * q.x[i] - p.y[i] * q.y[i] - p.z[i] * q.z[i];
+    }
+    return res;
+}
+
+template<typename T, int N>
+tvec3Packet<T, N> operator*(const tquatPacket<T, N>& q, const tvec3Packet<T, N>& v)
+{
+    // Same method as for tquat, i.e., t = 2 * cross(q.vec, v) and v' = v + q.w * t + cross(q.vec, t)
+    tvec3Packet<T, N> res;
+    for (int i = 0; i < N; ++i) {
+        T tx = static_cast<T>(2) * (q.y[i] * v.z[i] - q.z[i] * v.y[i]);
+        T ty = static_cast<T>(2) * (q.z[i] * v.x[i] - q.x[i] * v.z[i]);
+        T tz = static_cast<T>(2) * (q.x[i] * v.y[i] - q.y[i] * v.x[i]);
+        res.x[i] = v.x[i] + q.w[i] * tx + (q.y[i] * tz - q.z[i] * ty);
+        res.y[i] = v.y[i] + q.w[i] * ty + (q.z[i] * tx - q.x[i] * tz);
+        res.z[i] = v.z[i] + q.w[i] * tz + (q.x[i] * ty - q.y[i] * tx);
+    }
+    return res;
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline tquatPacket<f32, 4> operator*(const tquatPacket<f32, 4>& p, const tquatPacket<f32, 4>& q)
+{
+    __m128 px = _mm_load_ps(p.x), py = _mm_load_ps(p.y), pz = _mm_load_ps(p.z), pw = _mm_load_ps(p.w);
+    __m128 qx = _mm_load_ps(q.x), qy = _mm_load_ps(q.y), qz = _mm_load_ps(q.z), qw = _mm_load_ps(q.w);
+
+    __m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pw, qx), _mm_mul_ps(px, qw)), _mm_sub_ps(_mm_mul_ps(py, qz), _mm_mul_ps(pz, qy)));
+    __m128 y = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(pw, qy), _mm_mul_ps(px, qz)), _mm_add_ps(_mm_mul_ps(py, qw), _mm_mul_ps(pz, qx)));
+    __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pw, qz), _mm_mul_ps(px, qy)), _mm_sub_ps(_mm_mul_ps(pz, qw), _mm_mul_ps(py, qx)));
+    __m128 w = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(pw, qw), _mm_mul_ps(px, qx)), _mm_add_ps(_mm_mul_ps(py, qy), _mm_mul_ps(pz, qz)));
+
+    tquatPacket<f32, 4> res;
+    _mm_store_ps(res.x, x);
+    _mm_store_ps(res.y, y);
+    _mm_store_ps(res.z, z);
+    _mm_store_ps(res.w, w);
+    return res;
+}
+
+template<>
+inline tvec3Packet<f32, 4> operator*(const tquatPacket<f32, 4>& q, const tvec3Packet<f32, 4>& v)
+{
+    __m128 qx = _mm_load_ps(q.x), qy = _mm_load_ps(q.y), qz = _mm_load_ps(q.z), qw = _mm_load_ps(q.w);
+    __m128 vx = _mm_load_ps(v.x), vy = _mm_load_ps(v.y), vz = _mm_load_ps(v.z);
+
+    const __m128 two = _mm_set1_ps(2.0f);
+    __m128 tx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qy, vz), _mm_mul_ps(qz, vy)));
+    __m128 ty = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qz, vx), _mm_mul_ps(qx, vz)));
+    __m128 tz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qx, vy), _mm_mul_ps(qy, vx)));
+
+    __m128 x = _mm_add_ps(_mm_add_ps(vx, _mm_mul_ps(qw, tx)), _mm_sub_ps(_mm_mul_ps(qy, tz), _mm_mul_ps(qz, ty)));
+    __m128 y = _mm_add_ps(_mm_add_ps(vy, _mm_mul_ps(qw, ty)), _mm_sub_ps(_mm_mul_ps(qz, tx), _mm_mul_ps(qx, tz)));
+    __m128 z = _mm_add_ps(_mm_add_ps(vz, _mm_mul_ps(qw, tz)), _mm_sub_ps(_mm_mul_ps(qx, ty), _mm_mul_ps(qy, tx)));
+
+    tvec3Packet<f32, 4> res;
+    _mm_store_ps(res.x, x);
+    _mm_store_ps(res.y, y);
+    _mm_store_ps(res.z, z);
+    return res;
+}
+
+#endif
+
+#ifdef MOOS_AVX2
+
+template<>
+inline tquatPacket<f32, 8> operator*(const tquatPacket<f32, 8>& p, const tquatPacket<f32, 8>& q)
+{
+    __m256 px = _mm256_load_ps(p.x), py = _mm256_load_ps(p.y), pz = _mm256_load_ps(p.z), pw = _mm256_load_ps(p.w);
+    __m256 qx = _mm256_load_ps(q.x), qy = _mm256_load_ps(q.y), qz = _mm256_load_ps(q.z), qw = _mm256_load_ps(q.w);
+
+    __m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pw, qx), _mm256_mul_ps(px, qw)), _mm256_sub_ps(_mm256_mul_ps(py, qz), _mm256_mul_ps(pz, qy)));
+    __m256 y = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(pw, qy), _mm256_mul_ps(px, qz)), _mm256_add_ps(_mm256_mul_ps(py, qw), _mm256_mul_ps(pz, qx)));
+    __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pw, qz), _mm256_mul_ps(px, qy)), _mm256_sub_ps(_mm256_mul_ps(pz, qw), _mm256_mul_ps(py, qx)));
+    __m256 w = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(pw, qw), _mm256_mul_ps(px, qx)), _mm256_add_ps(_mm256_mul_ps(py, qy), _mm256_mul_ps(pz, qz)));
+
+    tquatPacket<f32, 8> res;
+    _mm256_store_ps(res.x, x);
+    _mm256_store_ps(res.y, y);
+    _mm256_store_ps(res.z, z);
+    _mm256_store_ps(res.w, w);
+    return res;
+}
+
+template<>
+inline tvec3Packet<f32, 8> operator*(const tquatPacket<f32, 8>& q, const tvec3Packet<f32, 8>& v)
+{
+    __m256 qx = _mm256_load_ps(q.x), qy = _mm256_load_ps(q.y), qz = _mm256_load_ps(q.z), qw = _mm256_load_ps(q.w);
+    __m256 vx = _mm256_load_ps(v.x), vy = _mm256_load_ps(v.y), vz = _mm256_load_ps(v.z);
+
+    const __m256 two = _mm256_set1_ps(2.0f);
+    __m256 tx = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(qy, vz), _mm256_mul_ps(qz, vy)));
+    __m256 ty = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(qz, vx), _mm256_mul_ps(qx, vz)));
+    __m256 tz = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(qx, vy), _mm256_mul_ps(qy, vx)));
+
+    __m256 x = _mm256_add_ps(_mm256_add_ps(vx, _mm256_mul_ps(qw, tx)), _mm256_sub_ps(_mm256_mul_ps(qy, tz), _mm256_mul_ps(qz, ty)));
+    __m256 y = _mm256_add_ps(_mm256_add_ps(vy, _mm256_mul_ps(qw, ty)), _mm256_sub_ps(_mm256_mul_ps(qz, tx), _mm256_mul_ps(qx, tz)));
+    __m256 z = _mm256_add_ps(_mm256_add_ps(vz, _mm256_mul_ps(qw, tz)), _mm256_sub_ps(_mm256_mul_ps(qx, ty), _mm256_mul_ps(qy, tx)));
+
+    tvec3Packet<f32, 8> res;
+    _mm256_store_ps(res.x, x);
+    _mm256_store_ps(res.y, y);
+    _mm256_store_ps(res.z, z);
+    return res;
+}
+
+#endif
+
+template<typename T, int N>
+tquatPacket<T, N> nlerp(const tquatPacket<T, N>& a, const tquatPacket<T, N>& b, T t)
+{
+    tquatPacket<T, N> res;
+    T ta = static_cast<T>(1) - t;
+    for (int i = 0; i < N; ++i) {
+        T cosTheta = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i] + a.w[i] * b.w[i];
+        T tb = (cosTheta < static_cast<T>(0)) ? -t : t;
+        T x = ta * a.x[i] + tb * b.x[i];
+        T y = ta * a.y[i] + tb * b.y[i];
+        T z = ta * a.z[i] + tb * b.z[i];
+        T w = ta * a.w[i] + tb * b.w[i];
+        T invLength = static_cast<T>(1) / std::sqrt(x * x + y * y + z * z + w * w);
+        res.x[i] = x * invLength;
+        res.y[i] = y * invLength;
+        res.z[i] = z * invLength;
+        res.w[i] = w * invLength;
+    }
+    return res;
+}
+
+template<typename T, int N>
+tquatPacket<T, N> slerpFast(const tquatPacket<T, N>& a, const tquatPacket<T, N>& b, T t)
+{
+    tquatPacket<T, N> res;
+    for (int i = 0; i < N; ++i) {
+        T cosTheta = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i] + a.w[i] * b.w[i];
+        T sign = (cosTheta < static_cast<T>(0)) ? -static_cast<T>(1) : static_cast<T>(1);
+        T cosThetaMinusOne = sign * cosTheta - static_cast<T>(1);
+        T ta = detail::slerpFastWeight(static_cast<T>(1) - t, cosThetaMinusOne);
+        T tb = detail::slerpFastWeight(t, cosThetaMinusOne) * sign;
+        res.x[i] = ta * a.x[i] + tb * b.x[i];
+        res.y[i] = ta * a.y[i] + tb * b.y[i];
+        res.z[i] = ta * a.z[i] + tb * b.z[i];
+        res.w[i] = ta * a.w[i] + tb * b.w[i];
+    }
+    return res;
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline tquatPacket<f32, 4> nlerp(const tquatPacket<f32, 4>& a, const tquatPacket<f32, 4>& b, f32 t)
+{
+    __m128 ax = _mm_load_ps(a.x), ay = _mm_load_ps(a.y), az = _mm_load_ps(a.z), aw = _mm_load_ps(a.w);
+    __m128 bx = _mm_load_ps(b.x), by = _mm_load_ps(b.y), bz = _mm_load_ps(b.z), bw = _mm_load_ps(b.w);
+
+    __m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+    __m128 sign = _mm_and_ps(cosTheta, _mm_set1_ps(-0.0f));
+
+    __m128 ta = _mm_set1_ps(1.0f - t);
+    __m128 tb = _mm_xor_ps(_mm_set1_ps(t), sign);
+
+    __m128 x = _mm_add_ps(_mm_mul_ps(ta, ax), _mm_mul_ps(tb, bx));
+    __m128 y = _mm_add_ps(_mm_mul_ps(ta, ay), _mm_mul_ps(tb, by));
+    __m128 z = _mm_add_ps(_mm_mul_ps(ta, az), _mm_mul_ps(tb, bz));
+    __m128 w = _mm_add_ps(_mm_mul_ps(ta, aw), _mm_mul_ps(tb, bw));
+
+    __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+    __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+
+    tquatPacket<f32, 4> res;
+    _mm_store_ps(res.x, _mm_mul_ps(x, invLength));
+    _mm_store_ps(res.y, _mm_mul_ps(y, invLength));
+    _mm_store_ps(res.z, _mm_mul_ps(z, invLength));
+    _mm_store_ps(res.w, _mm_mul_ps(w, invLength));
+    return res;
+}
+
+template<>
+inline tquatPacket<f32, 4> slerpFast(const tquatPacket<f32, 4>& a, const tquatPacket<f32, 4>& b, f32 t)
+{
+    __m128 ax = _mm_load_ps(a.x), ay = _mm_load_ps(a.y), az = _mm_load_ps(a.z), aw = _mm_load_ps(a.w);
+    __m128 bx = _mm_load_ps(b.x), by = _mm_load_ps(b.y), bz = _mm_load_ps(b.z), bw = _mm_load_ps(b.w);
+
+    __m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+    __m128 sign = _mm_and_ps(cosTheta, _mm_set1_ps(-0.0f));
+    __m128 cosThetaMinusOne = _mm_sub_ps(_mm_xor_ps(cosTheta, sign), _mm_set1_ps(1.0f));
+
+    __m128 ta = detail::slerpFastWeight(_mm_set1_ps(1.0f - t), cosThetaMinusOne);
+    __m128 tb = _mm_xor_ps(detail::slerpFastWeight(_mm_set1_ps(t), cosThetaMinusOne), sign);
+
+    tquatPacket<f32, 4> res;
+    _mm_store_ps(res.x, _mm_add_ps(_mm_mul_ps(ta, ax), _mm_mul_ps(tb, bx)));
+    _mm_store_ps(res.y, _mm_add_ps(_mm_mul_ps(ta, ay), _mm_mul_ps(tb, by)));
+    _mm_store_ps(res.z, _mm_add_ps(_mm_mul_ps(ta, az), _mm_mul_ps(tb, bz)));
+    _mm_store_ps(res.w, _mm_add_ps(_mm_mul_ps(ta, aw), _mm_mul_ps(tb, bw)));
+    return res;
+}
+
+#endif
+
+#ifdef MOOS_AVX2
+
+template<>
+inline tquatPacket<f32, 8> nlerp(const tquatPacket<f32, 8>& a, const tquatPacket<f32, 8>& b, f32 t)
+{
+    __m256 ax = _mm256_load_ps(a.x), ay = _mm256_load_ps(a.y), az = _mm256_load_ps(a.z), aw = _mm256_load_ps(a.w);
+    __m256 bx = _mm256_load_ps(b.x), by = _mm256_load_ps(b.y), bz = _mm256_load_ps(b.z), bw = _mm256_load_ps(b.w);
+
+    __m256 cosTheta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_add_ps(_mm256_mul_ps(az, bz), _mm256_mul_ps(aw, bw)));
+    __m256 sign = _mm256_and_ps(cosTheta, _mm256_set1_ps(-0.0f));
+
+    __m256 ta = _mm256_set1_ps(1.0f - t);
+    __m256 tb = _mm256_xor_ps(_mm256_set1_ps(t), sign);
+
+    __m256 x = _mm256_add_ps(_mm256_mul_ps(ta, ax), _mm256_mul_ps(tb, bx));
+    __m256 y = _mm256_add_ps(_mm256_mul_ps(ta, ay), _mm256_mul_ps(tb, by));
+    __m256 z = _mm256_add_ps(_mm256_mul_ps(ta, az), _mm256_mul_ps(tb, bz));
+    __m256 w = _mm256_add_ps(_mm256_mul_ps(ta, aw), _mm256_mul_ps(tb, bw));
+
+    __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_add_ps(_mm256_mul_ps(z, z), _mm256_mul_ps(w, w)));
+    __m256 invLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(length2));
+
+    tquatPacket<f32, 8> res;
+    _mm256_store_ps(res.x, _mm256_mul_ps(x, invLength));
+    _mm256_store_ps(res.y, _mm256_mul_ps(y, invLength));
+    _mm256_store_ps(res.z, _mm256_mul_ps(z, invLength));
+    _mm256_store_ps(res.w, _mm256_mul_ps(w, invLength));
+    return res;
+}
+
+template<>
+inline tquatPacket<f32, 8> slerpFast(const tquatPacket<f32, 8>& a, const tquatPacket<f32, 8>& b, f32 t)
+{
+    __m256 ax = _mm256_load_ps(a.x), ay = _mm256_load_ps(a.y), az = _mm256_load_ps(a.z), aw = _mm256_load_ps(a.w);
+    __m256 bx = _mm256_load_ps(b.x), by = _mm256_load_ps(b.y), bz = _mm256_load_ps(b.z), bw = _mm256_load_ps(b.w);
+
+    __m256 cosTheta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_add_ps(_mm256_mul_ps(az, bz), _mm256_mul_ps(aw, bw)));
+    __m256 sign = _mm256_and_ps(cosTheta, _mm256_set1_ps(-0.0f));
+    __m256 cosThetaMinusOne = _mm256_sub_ps(_mm256_xor_ps(cosTheta, sign), _mm256_set1_ps(1.0f));
+
+    __m256 ta = detail::slerpFastWeight(_mm256_set1_ps(1.0f - t), cosThetaMinusOne);
+    __m256 tb = _mm256_xor_ps(detail::slerpFastWeight(_mm256_set1_ps(t), cosThetaMinusOne), sign);
+
+    tquatPacket<f32, 8> res;
+    _mm256_store_ps(res.x, _mm256_add_ps(_mm256_mul_ps(ta, ax), _mm256_mul_ps(tb, bx)));
+    _mm256_store_ps(res.y, _mm256_add_ps(_mm256_mul_ps(ta, ay), _mm256_mul_ps(tb, by)));
+    _mm256_store_ps(res.z, _mm256_add_ps(_mm256_mul_ps(ta, az), _mm256_mul_ps(tb, bz)));
+    _mm256_store_ps(res.w, _mm256_add_ps(_mm256_mul_ps(ta, aw), _mm256_mul_ps(tb, bw)));
+    return res;
+}
+
+#endif
+
+// Packet slerp. The generic version uses the scalar slerp for each lane, and the SIMD f32 versions use fast::atan2 &
+// fast::sin instead of std::acos & std::sin, which gives results within around 1e-6 of slerp.
+
+template<typename T, int N>
+tquatPacket<T, N> slerp(const tquatPacket<T, N>& a, const tquatPacket<T, N>& b, T t)
+{
+    tquatPacket<T, N> res;
+    for (int i = 0; i < N; ++i) {
+        tquat<T> q = slerp(tquat<T>({ a.x[i], a.y[i], a.z[i] }, a.w[i]), tquat<T>({ b.x[i], b.y[i], b.z[i] }, b.w[i]), t);
+        res.x[i] = q.vec.x;
+        res.y[i] = q.vec.y;
+        res.z[i] = q.vec.z;
+        res.w[i] = q.w;
+    }
+    return res;
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    // Slerp of the lanes of the SoA quaternions a & b, written with the lane-wise primitives of the fast math functions
+    template<typename V>
+    void slerpLanes(const V a[4], const V b[4], f32 t, V result[4])
+    {
+        using namespace fast::detail;
+        const V one = constant<V>(1.0f);
+        V cosTheta = add(add(mul(a[0], b[0]), mul(a[1], b[1])), add(mul(a[2], b[2]), mul(a[3], b[3])));
+        V sign = bitAnd(cosTheta, constant<V>(-0.0f));
+        cosTheta = bitXor(cosTheta, sign);
+
+        // (like slerp, (almost) parallel quaternions use nlerp instead, where sin(theta) goes to zero)
+        auto parallel = greater(cosTheta, constant<V>(1.0f - std::numeric_limits<f32>::epsilon()));
+        V sinTheta = sqrt(max(sub(one, mul(cosTheta, cosTheta)), constant<V>(0.0f)));
+        V theta = fast::atan2(sinTheta, cosTheta);
+        V invSinTheta = div(one, sinTheta);
+        V ta = select(parallel, constant<V>(1.0f - t), mul(fast::sin(mul(constant<V>(1.0f - t), theta)), invSinTheta));
+        V tb = select(parallel, constant<V>(t), mul(fast::sin(mul(constant<V>(t), theta)), invSinTheta));
+        tb = bitXor(tb, sign);
+
+        V length2 = constant<V>(0.0f);
+        for (int c = 0; c < 4; ++c) {
+            result[c] = add(mul(ta, a[c]), mul(tb, b[c]));
+            length2 = add(length2, mul(result[c], result[c]));
+        }
+        V scale = select(parallel, div(one, sqrt(length2)), one);
+        for (int c = 0; c < 4; ++c) {
+            result[c] = mul(result[c], scale);
+        }
+    }
+
+} // namespace detail
+
+template<>
+inline tquatPacket<f32, 4> slerp(const tquatPacket<f32, 4>& a, const tquatPacket<f32, 4>& b, f32 t)
+{
+    __m128 va[4] = { _mm_load_ps(a.x), _mm_load_ps(a.y), _mm_load_ps(a.z), _mm_load_ps(a.w) };
+    __m128 vb[4] = { _mm_load_ps(b.x), _mm_load_ps(b.y), _mm_load_ps(b.z), _mm_load_ps(b.w) };
+    __m128 v[4];
+    detail::slerpLanes(va, vb, t, v);
+
+    tquatPacket<f32, 4> res;
+    _mm_store_ps(res.x, v[0]);
+    _mm_store_ps(res.y, v[1]);
+    _mm_store_ps(res.z, v[2]);
+    _mm_store_ps(res.w, v[3]);
+    return res;
+}
+
+#endif
+
+#ifdef MOOS_AVX2
+
+template<>
+inline tquatPacket<f32, 8> slerp(const tquatPacket<f32, 8>& a, const tquatPacket<f32, 8>& b, f32 t)
+{
+    __m256 va[4] = { _mm256_load_ps(a.x), _mm256_load_ps(a.y), _mm256_load_ps(a.z), _mm256_load_ps(a.w) };
+    __m256 vb[4] = { _mm256_load_ps(b.x), _mm256_load_ps(b.y), _mm256_load_ps(b.z), _mm256_load_ps(b.w) };
+    __m256 v[4];
+    detail::slerpLanes(va, vb, t, v);
+
+    tquatPacket<f32, 8> res;
+    _mm256_store_ps(res.x, v[0]);
+    _mm256_store_ps(res.y, v[1]);
+    _mm256_store_ps(res.z, v[2]);
+    _mm256_store_ps(res.w, v[3]);
+    return res;
+}
+
+#endif
+
+// Batch interpolation of count quaternion pairs with a common interpolation factor, e.g. for blending two
+// animation poses. The result may alias either of the inputs. These go via packets of eight quaternions with AVX2
+// and four otherwise, so for f32 they use the SIMD packet functions (see above for the accuracy of slerpBatch).
+
+namespace detail {
+
+#ifdef MOOS_AVX2
+    constexpr int interpolationPacketSize = 8;
+#else
+    constexpr int interpolationPacketSize = 4;
+#endif
+
+    template<int N, typename T, typename PacketFunc, typename ScalarFunc>
+    void interpolateBatch(const tquat<T>* a, const tquat<T>* b, tquat<T>* result, size_t count, PacketFunc packetFunc, ScalarFunc scalarFunc)
+    {
+        size_t i = 0;
+        for (; i + N <= count; i += N) {
+            tquatPacket<T, N> pa, pb;
+            loadPacket(pa, a + i);
+            loadPacket(pb, b + i);
+            storePacket(packetFunc(pa, pb), result + i);
+        }
+        for (; i < count; ++i) {
+            result[i] = scalarFunc(a[i], b[i]);
+        }
+    }
+
+} // namespace detail
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void nlerpBatch(const tquat<T>* a, const tquat<T>* b, T t, tquat<T>* result, size_t count)
+{
+    constexpr int N = detail::interpolationPacketSize;
+    detail::interpolateBatch<N>(
+        a, b, result, count,
+        [t](const tquatPacket<T, N>& pa, const tquatPacket<T, N>& pb) { return nlerp(pa, pb, t); },
+        [t](const tquat<T>& qa, const tquat<T>& qb) { return nlerp(qa, qb, t); });
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void slerpBatch(const tquat<T>* a, const tquat<T>* b, T t, tquat<T>* result, size_t count)
+{
+    constexpr int N = detail::interpolationPacketSize;
+    detail::interpolateBatch<N>(
+        a, b, result, count,
+        [t](const tquatPacket<T, N>& pa, const tquatPacket<T, N>& pb) { return slerp(pa, pb, t); },
+        [t](const tquat<T>& qa, const tquat<T>& qb) { return slerp(qa, qb, t); });
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void slerpFastBatch(const tquat<T>* a, const tquat<T>* b, T t, tquat<T>* result, size_t count)
+{
+    constexpr int N = detail::interpolationPacketSize;
+    detail::interpolateBatch<N>(
+        a, b, result, count,
+        [t](const tquatPacket<T, N>& pa, const tquatPacket<T, N>& pb) { return slerpFast(pa, pb, t); },
+        [t](const tquat<T>& qa, const tquat<T>& qb) { return slerpFast(qa, qb, t); });
+}
+
+// Exponential map & integration of angular velocity
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> exp(const tquat<T>& q)
+{
+    T angle = length(q.vec);
+    T expW = std::exp(q.w);
+    T sinc = (angle > std::numeric_limits<T>::epsilon()) ? std::sin(angle) / angle : static_cast<T>(1);
+    return { q.vec * (expW * sinc), expW * std::cos(angle) };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> log(const tquat<T>& q)
+{
+    T vecLength = length(q.vec);
+    T qLength = std::sqrt(square(vecLength) + square(q.w));
+    T angle = std::atan2(vecLength, q.w);
+
+    // The factor is angle / vecLength = (angle / sin(angle)) / qLength, where a Taylor expansion is used for small angles
+    // (as sin(angle) goes to zero). For a negative real q the axis is undefined, so the vector part is left zero.
+    T factor;
+    if (angle * angle < static_cast<T>(1e-6)) {
+        factor = (static_cast<T>(1) + angle * angle / static_cast<T>(6)) / qLength;
+    } else {
+        factor = (vecLength > static_cast<T>(0)) ? angle / vecLength : static_cast<T>(0);
+    }
+    return { q.vec * factor, std::log(qLength) };
+}
+
+namespace detail {
+
+    template<typename T>
+    constexpr T integrationSinc(T halfAngle, T halfAngleSinOverAngularSpeed, T halfDt)
+    {
+        // Returns sin(halfAngle) / angularSpeed, where halfAngle = angularSpeed * dt / 2, but switches to a Taylor
+        // expansion for small angles to avoid dividing by (close to) zero for bodies that are not rotating
+        T halfAngle2 = halfAngle * halfAngle;
+        return (halfAngle2 < static_cast<T>(1e-6))
+            ? halfDt * (static_cast<T>(1) - halfAngle2 / static_cast<T>(6))
+            : halfAngleSinOverAngularSpeed;
+    }
+
+    // Sine & cosine for the packet integration, using the branch-free fast::sincos for f32 so the loop over the lanes
+    // can be vectorized
+    template<typename T>
+    void integrationSinCos(T halfAngle, T& sinHalfAngle, T& cosHalfAngle)
+    {
+        sinHalfAngle = std::sin(halfAngle);
+        cosHalfAngle = std::cos(halfAngle);
+    }
+
+    inline void integrationSinCos(f32 halfAngle, f32& sinHalfAngle, f32& cosHalfAngle)
+    {
+        fast::sincos(halfAngle, sinHalfAngle, cosHalfAngle);
+    }
+
+} // namespace detail
+
+// Integrates the orientation q over the time dt with the (world space) angular velocity, using the exact exponential map,
+// i.e., q' = exp(angularVelocity * dt / 2) * q. Both integrate and integrateFast return unit quaternions for unit inputs.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> integrate(const tquat<T>& q, const tvec3<T>& angularVelocity, T dt)
+{
+    T angularSpeed = length(angularVelocity);
+    T halfDt = static_cast<T>(0.5) * dt;
+    T halfAngle = angularSpeed * halfDt;
+    T sinHalfAngle = std::sin(halfAngle);
+    T factor = detail::integrationSinc(halfAngle, (angularSpeed > static_cast<T>(0)) ? sinHalfAngle / angularSpeed : static_cast<T>(0), halfDt);
+    tquat<T> dq = tquat<T>(angularVelocity * factor, std::cos(halfAngle));
+    return dq * q;
+}
+
+// First-order integration followed by normalization, i.e., q' = normalize(q + dt/2 * (angularVelocity, 0) * q). This is
+// accurate for small rotations per step, and is cheaper since it doesn't require any trigonometric functions.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tquat<T> integrateFast(const tquat<T>& q, const tvec3<T>& angularVelocity, T dt)
+{
+    tquat<T> spin = tquat<T>(angularVelocity, static_cast<T>(0)) * q;
+    return normalize(q + spin * (static_cast<T>(0.5) * dt));
+}
+
+template<typename T, int N>
+tquatPacket<T, N> integrate(const tquatPacket<T, N>& q, const tvec3Packet<T, N>& angularVelocity, T dt)
+{
+    tquatPacket<T, N> dq;
+    T halfDt = static_cast<T>(0.5) * dt;
+    for (int i = 0; i < N; ++i) {
+        T wx = angularVelocity.x[i], wy = angularVelocity.y[i], wz = angularVelocity.z[i];
+        T angularSpeed = std::sqrt(wx * wx + wy * wy + wz * wz);
+        T halfAngle = angularSpeed * halfDt;
+        T sinHalfAngle, cosHalfAngle;
+        detail::integrationSinCos(halfAngle, sinHalfAngle, cosHalfAngle);
+        T factor = detail::integrationSinc(halfAngle, (angularSpeed > static_cast<T>(0)) ? sinHalfAngle / angularSpeed : static_cast<T>(0), halfDt);
+        dq.x[i] = wx * factor;
+        dq.y[i] = wy * factor;
+        dq.z[i] = wz * factor;
+        dq.w[i] = cosHalfAngle;
+    }
+    return dq * q;
+}
+
+template<typename T, int N>
+tquatPacket<T, N> integrateFast(const tquatPacket<T, N>& q, const tvec3Packet<T, N>& angularVelocity, T dt)
+{
+    tquatPacket<T, N> spin;
+    for (int i = 0; i < N; ++i) {
+        spin.x[i] = angularVelocity.x[i];
+        spin.y[i] = angularVelocity.y[i];
+        spin.z[i] = angularVelocity.z[i];
+        spin.w[i] = static_cast<T>(0);
+    }
+    spin = spin * q;
+
+    tquatPacket<T, N> res;
+    T halfDt = static_cast<T>(0.5) * dt;
+    for (int i = 0; i < N; ++i) {
+        T x = q.x[i] + halfDt * spin.x[i];
+        T y = q.y[i] + halfDt * spin.y[i];
+        T z = q.z[i] + halfDt * spin.z[i];
+        T w = q.w[i] + halfDt * spin.w[i];
+        T invLength = static_cast<T>(1) / std::sqrt(x * x + y * y + z * z + w * w);
+        res.x[i] = x * invLength;
+        res.y[i] = y * invLength;
+        res.z[i] = z * invLength;
+        res.w[i] = w * invLength;
+    }
+    return res;
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline tquatPacket<f32, 4> integrate(const tquatPacket<f32, 4>& q, const tvec3Packet<f32, 4>& angularVelocity, f32 dt)
+{
+    __m128 wx = _mm_load_ps(angularVelocity.x), wy = _mm_load_ps(angularVelocity.y), wz = _mm_load_ps(angularVelocity.z);
+    __m128 angularSpeed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, wx), _mm_mul_ps(wy, wy)), _mm_mul_ps(wz, wz)));
+
+    __m128 halfDt = _mm_set1_ps(0.5f * dt);
+    __m128 halfAngle = _mm_mul_ps(angularSpeed, halfDt);
+    __m128 sinHalfAngle, cosHalfAngle;
+    fast::sincos(halfAngle, sinHalfAngle, cosHalfAngle);
+
+    // (see detail::integrationSinc; the division by zero for non-rotating bodies is discarded by the select)
+    __m128 halfAngle2 = _mm_mul_ps(halfAngle, halfAngle);
+    __m128 small = _mm_cmplt_ps(halfAngle2, _mm_set1_ps(1e-6f));
+    __m128 taylor = _mm_mul_ps(halfDt, _mm_sub_ps(_mm_set1_ps(1.0f), _mm_div_ps(halfAngle2, _mm_set1_ps(6.0f))));
+    __m128 factor = _mm_or_ps(_mm_and_ps(small, taylor), _mm_andnot_ps(small, _mm_div_ps(sinHalfAngle, angularSpeed)));
+
+    tquatPacket<f32, 4> dq;
+    _mm_store_ps(dq.x, _mm_mul_ps(wx, factor));
+    _mm_store_ps(dq.y, _mm_mul_ps(wy, factor));
+    _mm_store_ps(dq.z, _mm_mul_ps(wz, factor));
+    _mm_store_ps(dq.w, cosHalfAngle);
+    return dq * q;
+}
+
+template<>
+inline tquatPacket<f32, 4> integrateFast(const tquatPacket<f32, 4>& q, const tvec3Packet<f32, 4>& angularVelocity, f32 dt)
+{
+    __m128 qx = _mm_load_ps(q.x), qy = _mm_load_ps(q.y), qz = _mm_load_ps(q.z), qw = _mm_load_ps(q.w);
+    __m128 halfDt = _mm_set1_ps(0.5f * dt);
+    __m128 wx = _mm_mul_ps(_mm_load_ps(angularVelocity.x), halfDt);
+    __m128 wy = _mm_mul_ps(_mm_load_ps(angularVelocity.y), halfDt);
+    __m128 wz = _mm_mul_ps(_mm_load_ps(angularVelocity.z), halfDt);
+
+    // q + (w, 0) * q, where w is the angular velocity scaled by dt / 2 (see the tquatPacket product)
+    __m128 x = _mm_add_ps(qx, _mm_add_ps(_mm_mul_ps(wx, qw), _mm_sub_ps(_mm_mul_ps(wy, qz), _mm_mul_ps(wz, qy))));
+    __m128 y = _mm_add_ps(qy, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(wy, qw), _mm_mul_ps(wx, qz)), _mm_mul_ps(wz, qx)));
+    __m128 z = _mm_add_ps(qz, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(wx, qy), _mm_mul_ps(wy, qx)), _mm_mul_ps(wz, qw)));
+    __m128 w = _mm_sub_ps(qw, _mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, qx), _mm_mul_ps(wy, qy)), _mm_mul_ps(wz, qz)));
+
+    __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+    __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+
+    tquatPacket<f32, 4> res;
+    _mm_store_ps(res.x, _mm_mul_ps(x, invLength));
+    _mm_store_ps(res.y, _mm_mul_ps(y, invLength));
+    _mm_store_ps(res.z, _mm_mul_ps(z, invLength));
+    _mm_store_ps(res.w, _mm_mul_ps(w, invLength));
+    return res;
+}
+
+#endif
+
+// Batch integration in place, for orientations & angular velocities stored as arrays of packets (i.e. packetCount * N bodies)
+// as is common in physics engines, or stored as plain arrays of quaternions & vectors.
+
+template<typename T, int N>
+void integrateBatch(tquatPacket<T, N>* orientations, const tvec3Packet<T, N>* angularVelocities, T dt, size_t packetCount)
+{
+    for (size_t i = 0; i < packetCount; ++i) {
+        orientations[i] = integrate(orientations[i], angularVelocities[i], dt);
+    }
+}
+
+template<typename T, int N>
+void integrateFastBatch(tquatPacket<T, N>* orientations, const tvec3Packet<T, N>* angularVelocities, T dt, size_t packetCount)
+{
+    for (size_t i = 0; i < packetCount; ++i) {
+        orientations[i] = integrateFast(orientations[i], angularVelocities[i], dt);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void integrateBatch(tquat<T>* orientations, const tvec3<T>* angularVelocities, T dt, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        tquatPacket<T, 4> q;
+        tvec3Packet<T, 4> w;
+        loadPacket(q, orientations + i);
+        loadPacket(w, angularVelocities + i);
+        storePacket(integrate(q, w, dt), orientations + i);
+    }
+    for (; i < count; ++i) {
+        orientations[i] = integrate(orientations[i], angularVelocities[i], dt);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void integrateFastBatch(tquat<T>* orientations, const tvec3<T>* angularVelocities, T dt, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        tquatPacket<T, 4> q;
+        tvec3Packet<T, 4> w;
+        loadPacket(q, orientations + i);
+        loadPacket(w, angularVelocities + i);
+        storePacket(integrateFast(q, w, dt), orientations + i);
+    }
+    for (; i < count; ++i) {
+        orientations[i] = integrateFast(orientations[i], angularVelocities[i], dt);
+    }
+}
+
 using quat = tquat<Float>;
 using fquat = tquat<f32>;
 using dquat = tquat<f64>;
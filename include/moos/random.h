@@ -25,12 +25,126 @@
 #pragma once
 
 #include "core.h"
+#include "cpu.h"
 #include "vector.h"
 
 #include <random> // for random number generation
 
 namespace moos {
 
+namespace detail {
+
+    // Integer hash with low bias (lowbias32 by Chris Wellons), used as a counter-based generator
+    constexpr u32 hashU32(u32 x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    constexpr u32 RandomIndexMultiplier = 0x9e3779b9u;
+    constexpr f32 RandomFloatScale = 1.0f / 16777216.0f;
+
+    inline void randomFloatsScalar(u32 key, u32 firstIndex, f32* result, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            u32 index = firstIndex + static_cast<u32>(i);
+            result[i] = static_cast<f32>(hashU32((index * RandomIndexMultiplier) ^ key) >> 8) * RandomFloatScale;
+        }
+    }
+
+#ifdef MOOS_DISPATCH
+
+    MOOS_TARGET_SSE41 inline void randomFloatsSSE41(u32 key, u32 firstIndex, f32* result, size_t count)
+    {
+        const __m128i keys = _mm_set1_epi32(static_cast<int>(key));
+        const __m128i multiplier = _mm_set1_epi32(static_cast<int>(RandomIndexMultiplier));
+        const __m128i hashMultiplier1 = _mm_set1_epi32(0x7feb352d);
+        const __m128i hashMultiplier2 = _mm_set1_epi32(static_cast<int>(0x846ca68bu));
+        __m128i index = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstIndex)), _mm_setr_epi32(0, 1, 2, 3));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i x = _mm_xor_si128(_mm_mullo_epi32(index, multiplier), keys);
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+            x = _mm_mullo_epi32(x, hashMultiplier1);
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+            x = _mm_mullo_epi32(x, hashMultiplier2);
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+            _mm_storeu_ps(result + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(RandomFloatScale)));
+            index = _mm_add_epi32(index, _mm_set1_epi32(4));
+        }
+        randomFloatsScalar(key, firstIndex + static_cast<u32>(i), result + i, count - i);
+    }
+
+    MOOS_TARGET_AVX2 inline void randomFloatsAVX2(u32 key, u32 firstIndex, f32* result, size_t count)
+    {
+        const __m256i keys = _mm256_set1_epi32(static_cast<int>(key));
+        const __m256i multiplier = _mm256_set1_epi32(static_cast<int>(RandomIndexMultiplier));
+        const __m256i hashMultiplier1 = _mm256_set1_epi32(0x7feb352d);
+        const __m256i hashMultiplier2 = _mm256_set1_epi32(static_cast<int>(0x846ca68bu));
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(firstIndex)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i x = _mm256_xor_si256(_mm256_mullo_epi32(index, multiplier), keys);
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+            x = _mm256_mullo_epi32(x, hashMultiplier1);
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+            x = _mm256_mullo_epi32(x, hashMultiplier2);
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+            _mm256_storeu_ps(result + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)), _mm256_set1_ps(RandomFloatScale)));
+            index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+        }
+        randomFloatsScalar(key, firstIndex + static_cast<u32>(i), result + i, count - i);
+    }
+
+    MOOS_BEGIN_AVX512_KERNELS
+    MOOS_TARGET_AVX512 inline void randomFloatsAVX512(u32 key, u32 firstIndex, f32* result, size_t count)
+    {
+        const __m512i keys = _mm512_set1_epi32(static_cast<int>(key));
+        const __m512i multiplier = _mm512_set1_epi32(static_cast<int>(RandomIndexMultiplier));
+        const __m512i hashMultiplier1 = _mm512_set1_epi32(0x7feb352d);
+        const __m512i hashMultiplier2 = _mm512_set1_epi32(static_cast<int>(0x846ca68bu));
+        __m512i index = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(firstIndex)),
+                                         _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m512i x = _mm512_xor_si512(_mm512_mullo_epi32(index, multiplier), keys);
+            x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+            x = _mm512_mullo_epi32(x, hashMultiplier1);
+            x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 15));
+            x = _mm512_mullo_epi32(x, hashMultiplier2);
+            x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+            _mm512_storeu_ps(result + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(x, 8)), _mm512_set1_ps(RandomFloatScale)));
+            index = _mm512_add_epi32(index, _mm512_set1_epi32(16));
+        }
+        randomFloatsAVX2(key, firstIndex + static_cast<u32>(i), result + i, count - i);
+    }
+    MOOS_END_AVX512_KERNELS
+
+#endif
+
+} // namespace detail
+
+// Fills result with uniform floats in [0, 1), where result[i] only depends on the seed and firstIndex + i (a hash of the
+// two). Unlike Random this is stateless, so a long fill can be split across threads, and the values are identical for
+// every dispatched kernel (see cpu.h). The sequence repeats after 2^32 values.
+inline void randomFloatsBatch(u32 seed, u32 firstIndex, f32* result, size_t count)
+{
+    using Kernel = void (*)(u32, u32, f32*, size_t);
+    static const KernelTable<Kernel> kernels = {
+        { SimdLevel::Scalar, detail::randomFloatsScalar },
+#ifdef MOOS_DISPATCH
+        { SimdLevel::SSE41, detail::randomFloatsSSE41 },
+        { SimdLevel::AVX2, detail::randomFloatsAVX2 },
+        { SimdLevel::AVX512, detail::randomFloatsAVX512 },
+#endif
+    };
+    kernels.select()(detail::hashU32(seed), firstIndex, result, count);
+}
+
 class Random {
 public:
     // Seeded by the system, similarly to time(NULL)
@@ -90,6 +204,12 @@ public:
         return position;
     }
 
+    // Fills values with uniform floats in [0, 1), using randomFloatsBatch seeded from this generator
+    void fillRandomFloats(f32* values, size_t count)
+    {
+        randomFloatsBatch(static_cast<u32>(m_engine()), 0, values, count);
+    }
+
 private:
     std::mt19937_64 m_engine;
 };
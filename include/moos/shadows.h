@@ -0,0 +1,166 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Simon Moos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "aabb.h"
+#include "core.h"
+#include "matrix.h"
+#include "transform.h"
+#include "vector.h"
+
+#include <utility> // for std::swap
+
+namespace moos {
+
+// Cascaded shadow maps for directional lights
+
+// Returns the view space distance of split i (of cascadeCount, so i = 0 gives zNear and i = cascadeCount gives zFar) using
+// the "practical split scheme", i.e., a blend between logarithmic (lambda = 1) and uniform (lambda = 0) splits.
+inline Float cascadeSplitDistance(int i, int cascadeCount, Float zNear, Float zFar, Float lambda)
+{
+    MOOS_ASSERT(cascadeCount > 0 && zNear > static_cast<Float>(0) && zFar > zNear);
+    Float fraction = static_cast<Float>(i) / static_cast<Float>(cascadeCount);
+    Float logarithmic = zNear * std::pow(zFar / zNear, fraction);
+    Float uniform = zNear + (zFar - zNear) * fraction;
+    return lambda * logarithmic + (static_cast<Float>(1) - lambda) * uniform;
+}
+
+// The camera & light setup for computeShadowCascades. The camera projection parameters are the ones passed to one of the
+// perspectiveProjectionTo*ClipSpace functions, except that zFar is the max shadow distance, which often is less than the
+// far plane of the camera. Casters in front of the cascade (from the light's point of view) are included by casterMargin.
+struct ShadowCascadeSetup {
+    mat4 cameraView;
+    Float fovy;
+    Float aspectRatio;
+    Float zNear;
+    Float zFar;
+
+    vec3 lightDirection; // (the direction the light travels in)
+    int cascadeCount;
+    Float splitLambda;
+    int shadowMapResolution;
+    Float casterMargin;
+
+    // ZeroToOne gives y-flipped matrices for Vulkan (see orthographicProjectionToVulkanClipSpace)
+    OrthographicProjectionDepthMode depthMode;
+};
+
+struct ShadowCascade {
+    // View space distance range of this cascade
+    Float nearDistance;
+    Float farDistance;
+
+    // World space corners of the view frustum slice, near (bottom left, bottom right, top left, top right) then far
+    vec3 corners[8];
+    aabb3 bounds;
+
+    // World space bounding sphere of the slice, which is independent of the camera rotation
+    vec3 sphereCenter;
+    Float sphereRadius;
+
+    // Stabilized light matrices, i.e., the cascade moves in whole texel steps so that shadow edges don't shimmer when the
+    // camera moves or rotates. The light view is a rotation only, so it's the same for all cascades.
+    mat4 lightView;
+    mat4 lightProjection;
+    mat4 lightViewProjection;
+};
+
+// Computes all setup.cascadeCount cascades. The frustum corners are computed in closed form from the projection
+// parameters and the (rigid) inverse view, so no general matrix inverses are needed.
+inline void computeShadowCascades(const ShadowCascadeSetup& setup, ShadowCascade* cascades)
+{
+    MOOS_ASSERT(setup.cascadeCount > 0 && setup.shadowMapResolution > 2);
+
+    const Float one = static_cast<Float>(1);
+    const Float half = static_cast<Float>(0.5);
+
+    // World space camera position & the directions to the frustum corners at unit view space distance
+    mat4 inverseView = inverseRigid(setup.cameraView);
+    vec3 eye = inverseView.w.xyz();
+    Float tanHalfFovy = std::tan(setup.fovy * half);
+    Float tanHalfFovx = tanHalfFovy * setup.aspectRatio;
+    vec3 cornerDirections[4];
+    for (int i = 0; i < 4; ++i) {
+        vec3 viewDirection = vec3((i & 1) ? tanHalfFovx : -tanHalfFovx, (i & 2) ? tanHalfFovy : -tanHalfFovy, -one);
+        cornerDirections[i] = inverseView.x.xyz() * viewDirection.x + inverseView.y.xyz() * viewDirection.y + inverseView.z.xyz() * viewDirection.z;
+    }
+    vec3 viewForward = -inverseView.z.xyz();
+
+    // (any up vector not parallel to the light direction works, since only the rotation around it changes)
+    vec3 lightDirection = normalize(setup.lightDirection);
+    vec3 lightUp = (std::abs(lightDirection.y) > static_cast<Float>(0.99)) ? globalZ : globalUp;
+    mat4 lightView = lookAt(vec3(static_cast<Float>(0)), lightDirection, lightUp);
+
+    // Ratio of the half-diagonal of a frustum slice to its distance, for the bounding spheres
+    Float k2 = tanHalfFovx * tanHalfFovx + tanHalfFovy * tanHalfFovy;
+
+    for (int c = 0; c < setup.cascadeCount; ++c) {
+        ShadowCascade& cascade = cascades[c];
+        Float n = cascadeSplitDistance(c, setup.cascadeCount, setup.zNear, setup.zFar, setup.splitLambda);
+        Float f = cascadeSplitDistance(c + 1, setup.cascadeCount, setup.zNear, setup.zFar, setup.splitLambda);
+        cascade.nearDistance = n;
+        cascade.farDistance = f;
+
+        cascade.bounds = aabb3();
+        for (int i = 0; i < 4; ++i) {
+            cascade.corners[i] = eye + cornerDirections[i] * n;
+            cascade.corners[i + 4] = eye + cornerDirections[i] * f;
+            cascade.bounds.expandWithPoint(cascade.corners[i]);
+            cascade.bounds.expandWithPoint(cascade.corners[i + 4]);
+        }
+
+        // The center of the smallest bounding sphere is on the view axis, equidistant from the near & far corners, unless
+        // that is beyond the far plane, in which case it's the center of the far plane.
+        Float centerDistance = std::min(half * (f + n) * (one + k2), f);
+        Float radius = std::sqrt((f - centerDistance) * (f - centerDistance) + f * f * k2);
+        cascade.sphereCenter = eye + viewForward * centerDistance;
+        cascade.sphereRadius = radius;
+
+        // Round the radius up so that the size of the projection (and the texel size) doesn't change due to rounding
+        // errors, and snap the center to whole texels in light space. Snapping moves the box by up to a texel, so it's
+        // padded by a texel on each side, with the texel size chosen so that the padded box is still whole texels.
+        Float snappedRadius = std::ceil(radius * static_cast<Float>(16)) / static_cast<Float>(16);
+        Float texelSize = (static_cast<Float>(2) * snappedRadius) / static_cast<Float>(setup.shadowMapResolution - 2);
+        Float halfExtent = snappedRadius + texelSize;
+        vec4 lightSpaceCenter = lightView * vec4(cascade.sphereCenter, one);
+        Float x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+        Float y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
+        Float zNear = -lightSpaceCenter.z - snappedRadius - setup.casterMargin;
+        Float zFar = -lightSpaceCenter.z + snappedRadius;
+
+        Float bottom = y - halfExtent;
+        Float top = y + halfExtent;
+        if (setup.depthMode == OrthographicProjectionDepthMode::ZeroToOne) {
+            std::swap(bottom, top);
+        }
+
+        cascade.lightView = lightView;
+        cascade.lightProjection = orthographicProjection(x - halfExtent, x + halfExtent, bottom, top, zNear, zFar, setup.depthMode);
+        cascade.lightViewProjection = cascade.lightProjection * lightView;
+    }
+}
+
+} // namespace moos
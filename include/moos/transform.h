@@ -25,6 +25,7 @@
 #pragma once
 
 #include "core.h"
+#include "cpu.h"
 #include "matrix.h"
 #include "quaternion.h"
 
@@ -63,22 +64,315 @@ constexpr tmat4<T> rotate(const tquat<T>& q)
 }
 
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
-constexpr tmat4<T> lookAt(const tvec3<T>& eye, const tvec3<T>& target, const tvec3<T>& tempUp = globalUp)
+constexpr tmat4<T> lookAt(const tvec3<T>& eye, const tvec3<T>& target, const tvec3<T>& tempUp = tvec3<T>(0, 1, 0))
 {
     tvec3<T> forward = normalize(target - eye);
     tvec3<T> right = normalize(cross(forward, tempUp));
     tvec3<T> up = cross(right, forward);
 
-    // TODO(optimization): Maybe make a version which doesn't require transpose?
-    tmat4<T> mTrans(
-        { right, -dot(right, eye) },
-        { up, -dot(up, eye) },
-        { -forward, +dot(forward, eye) },
-        { 0, 0, 0, 1 });
-    tmat4<T> m = transpose(mTrans);
+    // (the rows of the rotation part are the camera basis vectors, so write them directly as the transposed columns)
+    tmat4<T> m;
+    m.x = { right.x, up.x, -forward.x, static_cast<T>(0) };
+    m.y = { right.y, up.y, -forward.y, static_cast<T>(0) };
+    m.z = { right.z, up.z, -forward.z, static_cast<T>(0) };
+    m.w = { -dot(right, eye), -dot(up, eye), dot(forward, eye), static_cast<T>(1) };
     return m;
 }
 
+// The inverse of lookAt, i.e., the camera-to-world matrix, with the camera basis vectors as columns
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> lookAtInverse(const tvec3<T>& eye, const tvec3<T>& target, const tvec3<T>& tempUp = tvec3<T>(0, 1, 0))
+{
+    tvec3<T> forward = normalize(target - eye);
+    tvec3<T> right = normalize(cross(forward, tempUp));
+    tvec3<T> up = cross(right, forward);
+
+    tmat4<T> m;
+    m.x = { right, static_cast<T>(0) };
+    m.y = { up, static_cast<T>(0) };
+    m.z = { -forward, static_cast<T>(0) };
+    m.w = { eye, static_cast<T>(1) };
+    return m;
+}
+
+// Batch versions of lookAt & lookAtInverse, e.g. for cube map faces, probes, or shadow cascades. The up vectors are
+// optional (nullptr means globalUp for all). For f32 these are SSE versions which handle four matrices at a time.
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void lookAtBatch(const tvec3<T>* eyes, const tvec3<T>* targets, const tvec3<T>* ups, tmat4<T>* result, size_t count)
+{
+    const tvec3<T> defaultUp = tvec3<T>(0, 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = lookAt(eyes[i], targets[i], ups ? ups[i] : defaultUp);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void lookAtInverseBatch(const tvec3<T>* eyes, const tvec3<T>* targets, const tvec3<T>* ups, tmat4<T>* result, size_t count)
+{
+    const tvec3<T> defaultUp = tvec3<T>(0, 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = lookAtInverse(eyes[i], targets[i], ups ? ups[i] : defaultUp);
+    }
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    // Camera basis vectors of four lookAt calls, as structure-of-arrays
+    inline void lookAtBasisx4(const tvec3<f32>* eyes, const tvec3<f32>* targets, const tvec3<f32>* ups, __m128 eye[3], __m128 right[3], __m128 up[3], __m128 forward[3])
+    {
+        __m128 target[3], tempUp[3];
+        loadVec3x4(eyes, eye[0], eye[1], eye[2]);
+        loadVec3x4(targets, target[0], target[1], target[2]);
+        if (ups) {
+            loadVec3x4(ups, tempUp[0], tempUp[1], tempUp[2]);
+        } else {
+            tempUp[0] = tempUp[2] = _mm_setzero_ps();
+            tempUp[1] = _mm_set1_ps(1.0f);
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            forward[i] = _mm_sub_ps(target[i], eye[i]);
+        }
+        normalize3x4(forward[0], forward[1], forward[2]);
+        cross3x4(forward[0], forward[1], forward[2], tempUp[0], tempUp[1], tempUp[2], right[0], right[1], right[2]);
+        normalize3x4(right[0], right[1], right[2]);
+        cross3x4(right[0], right[1], right[2], forward[0], forward[1], forward[2], up[0], up[1], up[2]);
+    }
+
+    inline __m128 dot3x4(const __m128 a[3], const __m128 b[3])
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+    }
+
+    // Writes four matrices where column c of matrix i is (columns[c][0][i], columns[c][1][i], columns[c][2][i], columns[c][3][i])
+    inline void storeMatricesx4(__m128 columns[4][4], tmat4<f32>* result)
+    {
+        for (int c = 0; c < 4; ++c) {
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            for (int i = 0; i < 4; ++i) {
+                _mm_storeu_ps(value_ptr(result[i]) + 4 * c, columns[c][i]);
+            }
+        }
+    }
+
+} // namespace detail
+
+template<>
+inline void lookAtBatch(const tvec3<f32>* eyes, const tvec3<f32>* targets, const tvec3<f32>* ups, tmat4<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 eye[3], right[3], up[3], forward[3];
+        detail::lookAtBasisx4(eyes + i, targets + i, ups ? ups + i : nullptr, eye, right, up, forward);
+
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 columns[4][4];
+        for (int c = 0; c < 3; ++c) {
+            columns[c][0] = right[c];
+            columns[c][1] = up[c];
+            columns[c][2] = _mm_xor_ps(forward[c], signMask);
+            columns[c][3] = _mm_setzero_ps();
+        }
+        columns[3][0] = _mm_xor_ps(detail::dot3x4(right, eye), signMask);
+        columns[3][1] = _mm_xor_ps(detail::dot3x4(up, eye), signMask);
+        columns[3][2] = detail::dot3x4(forward, eye);
+        columns[3][3] = _mm_set1_ps(1.0f);
+        detail::storeMatricesx4(columns, result + i);
+    }
+
+    const tvec3<f32> defaultUp = tvec3<f32>(0, 1, 0);
+    for (; i < count; ++i) {
+        result[i] = lookAt(eyes[i], targets[i], ups ? ups[i] : defaultUp);
+    }
+}
+
+template<>
+inline void lookAtInverseBatch(const tvec3<f32>* eyes, const tvec3<f32>* targets, const tvec3<f32>* ups, tmat4<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 eye[3], right[3], up[3], forward[3];
+        detail::lookAtBasisx4(eyes + i, targets + i, ups ? ups + i : nullptr, eye, right, up, forward);
+
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 columns[4][4];
+        for (int r = 0; r < 3; ++r) {
+            columns[0][r] = right[r];
+            columns[1][r] = up[r];
+            columns[2][r] = _mm_xor_ps(forward[r], signMask);
+            columns[3][r] = eye[r];
+        }
+        columns[0][3] = columns[1][3] = columns[2][3] = _mm_setzero_ps();
+        columns[3][3] = _mm_set1_ps(1.0f);
+        detail::storeMatricesx4(columns, result + i);
+    }
+
+    const tvec3<f32> defaultUp = tvec3<f32>(0, 1, 0);
+    for (; i < count; ++i) {
+        result[i] = lookAtInverse(eyes[i], targets[i], ups ? ups[i] : defaultUp);
+    }
+}
+
+#endif
+
+// Inverse of a rigid transform, i.e., a rotation & translation only, such as a view matrix
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> inverseRigid(const tmat4<T>& m)
+{
+    tmat4<T> inv(static_cast<T>(1));
+    inv.x = { m.x.x, m.y.x, m.z.x, static_cast<T>(0) };
+    inv.y = { m.x.y, m.y.y, m.z.y, static_cast<T>(0) };
+    inv.z = { m.x.z, m.y.z, m.z.z, static_cast<T>(0) };
+    inv.w = { -dot(m.x.xyz(), m.w.xyz()), -dot(m.y.xyz(), m.w.xyz()), -dot(m.z.xyz(), m.w.xyz()), static_cast<T>(1) };
+    return inv;
+}
+
+// Normal matrices, i.e., the inverse-transpose of the upper 3x3 of a model matrix, which transforms normals so that they
+// stay perpendicular to transformed surfaces under non-uniform scale and shear. The columns of the cofactor matrix are
+// cross products of the model matrix columns, and the inverse-transpose is the cofactor matrix over the determinant.
+
+// The cofactor matrix, for when only the direction of transformed normals matters (i.e., they are normalized after).
+// Note that it's the normal matrix scaled by the determinant, so it flips normals for mirroring model matrices.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tmat3<T> normalMatrixCofactor(const tmat4<T>& m)
+{
+    tvec3<T> x = m.x.xyz(), y = m.y.xyz(), z = m.z.xyz();
+    return { cross(y, z), cross(z, x), cross(x, y) };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tmat3<T> normalMatrix(const tmat4<T>& m)
+{
+    tmat3<T> cofactor = normalMatrixCofactor(m);
+    T det = dot(m.x.xyz(), cofactor.x);
+    return (static_cast<T>(1) / det) * cofactor;
+}
+
+// A model matrix with its normal matrix cached, which is only recomputed when the upper 3x3 of the model matrix changes.
+// Most objects are static or only move (i.e. only the translation changes), so this skips most normal matrix updates.
+template<typename T, typename _ = void>
+struct tcachednormalmatrix {
+};
+
+template<typename T>
+struct tcachednormalmatrix<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
+    explicit tcachednormalmatrix(const tmat4<T>& model = tmat4<T>(static_cast<T>(1)))
+        : m_model(model)
+        , m_normal(normalMatrix(model))
+    {
+    }
+
+    const tmat4<T>& model() const { return m_model; }
+    const tmat3<T>& normal() const { return m_normal; }
+
+    // Returns true if the normal matrix was recomputed
+    bool setModel(const tmat4<T>& model)
+    {
+        bool upperChanged = !(model.x.xyz() == m_model.x.xyz() && model.y.xyz() == m_model.y.xyz() && model.z.xyz() == m_model.z.xyz());
+        m_model = model;
+        if (upperChanged) {
+            m_normal = normalMatrix(model);
+        }
+        return upperChanged;
+    }
+
+private:
+    tmat4<T> m_model;
+    tmat3<T> m_normal;
+};
+
+using cachednormalmatrix = tcachednormalmatrix<Float>;
+using fcachednormalmatrix = tcachednormalmatrix<f32>;
+using dcachednormalmatrix = tcachednormalmatrix<f64>;
+
+// Computes normal matrices for count model matrices, with the same layout as the model matrices, i.e., the rows of the
+// 3x3 normal matrix with a zero w (see quatToMatrixBatch for tmat3x4). The model matrices are optionally also written
+// in that layout (nullptr means they are not written). For f32 this is an SSE version which handles four at a time.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void normalMatrixBatch(const tmat4<T>* matrices, tmat3x4<T>* models, tmat3x4<T>* normals, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (models) {
+            detail::storeTransposedAffine(matrices[i], models[i]);
+        }
+        tmat3<T> n = transpose(normalMatrix(matrices[i]));
+        normals[i].x = { n.x, static_cast<T>(0) };
+        normals[i].y = { n.y, static_cast<T>(0) };
+        normals[i].z = { n.z, static_cast<T>(0) };
+    }
+}
+
+#ifdef MOOS_SSE
+
+template<>
+inline void normalMatrixBatch(const tmat4<f32>* matrices, tmat3x4<f32>* models, tmat3x4<f32>* normals, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // m[column][row] holds that entry for the four matrices
+        __m128 m[3][3];
+        for (int col = 0; col < 3; ++col) {
+            __m128 x = _mm_loadu_ps(value_ptr(matrices[i + 0]) + 4 * col);
+            __m128 y = _mm_loadu_ps(value_ptr(matrices[i + 1]) + 4 * col);
+            __m128 z = _mm_loadu_ps(value_ptr(matrices[i + 2]) + 4 * col);
+            __m128 w = _mm_loadu_ps(value_ptr(matrices[i + 3]) + 4 * col);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            m[col][0] = x, m[col][1] = y, m[col][2] = z;
+        }
+
+        __m128 c[3][3];
+        detail::cross3x4(m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2], c[0][0], c[0][1], c[0][2]);
+        detail::cross3x4(m[2][0], m[2][1], m[2][2], m[0][0], m[0][1], m[0][2], c[1][0], c[1][1], c[1][2]);
+        detail::cross3x4(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], c[2][0], c[2][1], c[2][2]);
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], c[0][0]), _mm_mul_ps(m[0][1], c[0][1])), _mm_mul_ps(m[0][2], c[0][2]));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        // Row r of a normal matrix is (c[0][r], c[1][r], c[2][r]) / det, so transpose from lanes to one register per row
+        __m128 rows[3][4];
+        for (int row = 0; row < 3; ++row) {
+            __m128 x = _mm_mul_ps(c[0][row], invDet);
+            __m128 y = _mm_mul_ps(c[1][row], invDet);
+            __m128 z = _mm_mul_ps(c[2][row], invDet);
+            __m128 w = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            rows[row][0] = x, rows[row][1] = y, rows[row][2] = z, rows[row][3] = w;
+        }
+        for (int j = 0; j < 4; ++j) {
+            f32* dst = value_ptr(normals[i + j]);
+            _mm_storeu_ps(dst + 0, rows[0][j]);
+            _mm_storeu_ps(dst + 4, rows[1][j]);
+            _mm_storeu_ps(dst + 8, rows[2][j]);
+        }
+
+        if (models) {
+            for (int j = 0; j < 4; ++j) {
+                const f32* src = value_ptr(matrices[i + j]);
+                __m128 x = _mm_loadu_ps(src + 0), y = _mm_loadu_ps(src + 4), z = _mm_loadu_ps(src + 8), w = _mm_loadu_ps(src + 12);
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+                f32* dst = value_ptr(models[i + j]);
+                _mm_storeu_ps(dst + 0, x);
+                _mm_storeu_ps(dst + 4, y);
+                _mm_storeu_ps(dst + 8, z);
+            }
+        }
+    }
+
+    for (; i < count; ++i) {
+        if (models) {
+            detail::storeTransposedAffine(matrices[i], models[i]);
+        }
+        tmat3<f32> n = transpose(normalMatrix(matrices[i]));
+        normals[i].x = { n.x, 0.0f };
+        normals[i].y = { n.y, 0.0f };
+        normals[i].z = { n.z, 0.0f };
+    }
+}
+
+#endif
+
 // Projective transformations
 
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
@@ -87,11 +381,11 @@ constexpr tmat4<T> perspectiveProjectionToVulkanClipSpace(T fovy, T aspectRatio,
     // Code rewritten from GLM: https://github.com/g-truc/glm/blob/master/glm/ext/matrix_clip_space.inl
     // Right-handed, depth in range [0, 1], and y-coordinates where the top is -1 and the bottom is +1.
 
-    MOOS_ASSERT(std::abs(aspectRatio - std::numeric_limits<T>::epsilon()) > static_cast<T>(0));
-    MOOS_ASSERT(std::abs(zFar - zNear) > std::numeric_limits<T>::epsilon());
+    MOOS_ASSERT(cx::abs(aspectRatio - std::numeric_limits<T>::epsilon()) > static_cast<T>(0));
+    MOOS_ASSERT(cx::abs(zFar - zNear) > std::numeric_limits<T>::epsilon());
     MOOS_ASSERT(fovy > std::numeric_limits<T>::epsilon());
 
-    T tanHalfFovy = std::tan(fovy / static_cast<T>(2));
+    T tanHalfFovy = cx::tan(fovy / static_cast<T>(2));
     tmat4<T> m(static_cast<T>(0));
 
     m.x.x = static_cast<T>(1) / (aspectRatio * tanHalfFovy);
@@ -109,11 +403,11 @@ constexpr tmat4<T> perspectiveProjectionToOpenGLClipSpace(T fovy, T aspectRatio,
     // Code rewritten from GLM: https://github.com/g-truc/glm/blob/master/glm/ext/matrix_clip_space.inl
     // Right-handed, depth in range [-1, 1], and y-coordinates where the top is +1 and the bottom is -1.
 
-    MOOS_ASSERT(std::abs(aspectRatio - std::numeric_limits<T>::epsilon()) > static_cast<T>(0));
-    MOOS_ASSERT(std::abs(zFar - zNear) > std::numeric_limits<T>::epsilon());
+    MOOS_ASSERT(cx::abs(aspectRatio - std::numeric_limits<T>::epsilon()) > static_cast<T>(0));
+    MOOS_ASSERT(cx::abs(zFar - zNear) > std::numeric_limits<T>::epsilon());
     MOOS_ASSERT(fovy > std::numeric_limits<T>::epsilon());
 
-    T tanHalfFovy = std::tan(fovy / static_cast<T>(2));
+    T tanHalfFovy = cx::tan(fovy / static_cast<T>(2));
     tmat4<T> m(static_cast<T>(0));
 
     m.x.x = static_cast<T>(1) / (aspectRatio * tanHalfFovy);
@@ -173,34 +467,712 @@ constexpr tmat4<T> orthographicProjectionToOpenGLClipSpace(T size, T zNear, T zF
     return orthographicProjection(-halfSize, +halfSize, -halfSize, +halfSize, zNear, zFar, OrthographicProjectionDepthMode::NegativeOneToOne);
 }
 
+// Reverse-Z & infinite far plane versions of the Vulkan perspective projection, i.e., with depth in range [0, 1]. Reverse-Z
+// maps the near plane to depth 1 and the far plane to depth 0, which together with a floating point depth buffer gives
+// close to uniform depth precision over the whole range. With an infinite far plane, depth approaches 0 (or 1 without
+// reverse-Z) at infinity. Use a greater (or greater-or-equal) depth test and clear depth to 0 for reverse-Z.
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> perspectiveProjectionToVulkanClipSpaceReverseZ(T fovy, T aspectRatio, T zNear, T zFar)
+{
+    MOOS_ASSERT(cx::abs(zFar - zNear) > std::numeric_limits<T>::epsilon());
+    tmat4<T> m = perspectiveProjectionToVulkanClipSpace(fovy, aspectRatio, zNear, zFar);
+    m.z.z = zNear / (zFar - zNear);
+    m.w.z = (zFar * zNear) / (zFar - zNear);
+    return m;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> perspectiveProjectionToVulkanClipSpaceInfiniteFar(T fovy, T aspectRatio, T zNear)
+{
+    MOOS_ASSERT(zNear > static_cast<T>(0));
+    tmat4<T> m = perspectiveProjectionToVulkanClipSpace(fovy, aspectRatio, zNear, zNear + static_cast<T>(1));
+    m.z.z = -static_cast<T>(1);
+    m.w.z = -zNear;
+    return m;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> perspectiveProjectionToVulkanClipSpaceReverseZInfiniteFar(T fovy, T aspectRatio, T zNear)
+{
+    MOOS_ASSERT(zNear > static_cast<T>(0));
+    tmat4<T> m = perspectiveProjectionToVulkanClipSpace(fovy, aspectRatio, zNear, zNear + static_cast<T>(1));
+    m.z.z = static_cast<T>(0);
+    m.w.z = zNear;
+    return m;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> perspectiveProjectionToOpenGLClipSpaceInfiniteFar(T fovy, T aspectRatio, T zNear)
+{
+    MOOS_ASSERT(zNear > static_cast<T>(0));
+    tmat4<T> m = perspectiveProjectionToOpenGLClipSpace(fovy, aspectRatio, zNear, zNear + static_cast<T>(1));
+    m.z.z = -static_cast<T>(1);
+    m.w.z = -static_cast<T>(2) * zNear;
+    return m;
+}
+
+// Closed-form inverses of projection matrices, which only take a few divisions instead of a general 4x4 inverse. The
+// perspective version works for all of the perspective projections above (also with a sub-pixel jitter or an off-center
+// frustum in m.z.x and m.z.y), and the orthographic version works for all of the orthographic projections above.
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> inversePerspectiveProjection(const tmat4<T>& m)
+{
+    // The projection maps (x, y, z, 1) to (a*x + e*z, b*y + f*z, c*z + d, -z), which gives z = -w', and so on
+    MOOS_ASSERT(m.z.w == -static_cast<T>(1) && m.w.w == static_cast<T>(0));
+    MOOS_ASSERT(cx::abs(m.w.z) > static_cast<T>(0));
+
+    tmat4<T> inv(static_cast<T>(0));
+    inv.x.x = static_cast<T>(1) / m.x.x;
+    inv.y.y = static_cast<T>(1) / m.y.y;
+    inv.w.x = m.z.x / m.x.x;
+    inv.w.y = m.z.y / m.y.y;
+    inv.w.z = -static_cast<T>(1);
+    inv.z.w = static_cast<T>(1) / m.w.z;
+    inv.w.w = m.z.z / m.w.z;
+    return inv;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tmat4<T> inverseOrthographicProjection(const tmat4<T>& m)
+{
+    MOOS_ASSERT(m.x.w == static_cast<T>(0) && m.y.w == static_cast<T>(0) && m.z.w == static_cast<T>(0) && m.w.w == static_cast<T>(1));
+
+    tmat4<T> inv(static_cast<T>(1));
+    inv.x.x = static_cast<T>(1) / m.x.x;
+    inv.y.y = static_cast<T>(1) / m.y.y;
+    inv.z.z = static_cast<T>(1) / m.z.z;
+    inv.w.x = -m.w.x / m.x.x;
+    inv.w.y = -m.w.y / m.y.y;
+    inv.w.z = -m.w.z / m.z.z;
+    return inv;
+}
+
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
 constexpr void extractWorldFrustumPlanesFromViewProjection(const tmat4<T>& m, tvec4<T> planes[6])
 {
-    // Code rewritten from https://stackoverflow.com/a/34960913
+    // Code rewritten from https://stackoverflow.com/a/34960913 (see frustum.h for normalized planes & culling tests)
+
+    tmat4<T> rows = transpose(m);
+    planes[0] = rows.w + rows.x; // (left)
+    planes[1] = rows.w - rows.x; // (right)
+    planes[2] = rows.w + rows.y; // (bottom)
+    planes[3] = rows.w - rows.y; // (top)
+    planes[4] = rows.w + rows.z; // (near)
+    planes[5] = rows.w - rows.z; // (far)
+}
+
+// Transforms stored as separate translation, rotation, and scale (TRS), which is cheaper to compose than matrices. It
+// has 10 values, but doesn't save memory over a 3x4 matrix: for f32 with SSE the quaternion is 16-byte aligned, so a
+// transform is 48 bytes (use ttransformPacket or compressed rotations when the size matters). A transform maps a point
+// p to rotation * (scale * p) + translation. Note that the composition of two transforms with non-uniform scale can
+// contain shear, which a TRS transform can't represent, so composition & inversion are only exact for uniform scale (or
+// when the scale axes line up with the rotation).
+
+template<typename T, typename _ = void>
+struct ttransform {
+};
+
+template<typename T>
+struct ttransform<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
+    tvec3<T> translation;
+    tquat<T> rotation;
+    tvec3<T> scale;
+
+    constexpr ttransform(const tvec3<T>& translation, const tquat<T>& rotation, const tvec3<T>& scale) noexcept
+        : translation(translation)
+        , rotation(rotation)
+        , scale(scale)
+    {
+    }
+
+    constexpr ttransform(const tvec3<T>& translation, const tquat<T>& rotation, T uniformScale = static_cast<T>(1)) noexcept
+        : ttransform(translation, rotation, tvec3<T>(uniformScale))
+    {
+    }
+
+    constexpr ttransform() noexcept
+        : ttransform(tvec3<T>(static_cast<T>(0)), tquat<T>(), static_cast<T>(1))
+    {
+    }
+
+    constexpr ttransform<T> operator*(const ttransform<T>& child) const
+    {
+        return { rotation * (scale * child.translation) + translation,
+                 rotation * child.rotation,
+                 scale * child.scale };
+    }
+};
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr ttransform<T> inverse(const ttransform<T>& t)
+{
+    tquat<T> invRotation = conjugate(t.rotation);
+    tvec3<T> invScale = tvec3<T>(static_cast<T>(1)) / t.scale;
+    return { invScale * (invRotation * -t.translation), invRotation, invScale };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec3<T> transformPoint(const ttransform<T>& t, const tvec3<T>& point)
+{
+    return t.rotation * (t.scale * point) + t.translation;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec3<T> transformDirection(const ttransform<T>& t, const tvec3<T>& direction)
+{
+    // (only rotates, so that unit directions stay unit length)
+    return t.rotation * direction;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tmat4<T> transformToMatrix(const ttransform<T>& t)
+{
+    tmat4<T> m;
+    quatToMatrixBatch(&t.rotation, &t.translation, &t.scale, &m, 1);
+    return m;
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tmat3x4<T> transformToMatrix3x4(const ttransform<T>& t)
+{
+    // (same layout as quatToMatrixBatch for tmat3x4, i.e., the rows of the affine transform)
+    tmat3x4<T> m;
+    quatToMatrixBatch(&t.rotation, &t.translation, &t.scale, &m, 1);
+    return m;
+}
+
+using transform = ttransform<Float>;
+using ftransform = ttransform<f32>;
+using dtransform = ttransform<f64>;
+
+// Transform packets, i.e., N transforms stored as structure-of-arrays (see tquatPacket)
+
+template<typename T, int N>
+struct ttransformPacket {
+    tvec3Packet<T, N> translation;
+    tquatPacket<T, N> rotation;
+    tvec3Packet<T, N> scale;
+};
+
+template<typename T, int N>
+void loadPacket(ttransformPacket<T, N>& packet, const ttransform<T>* transforms)
+{
+    for (int i = 0; i < N; ++i) {
+        packet.translation.x[i] = transforms[i].translation.x;
+        packet.translation.y[i] = transforms[i].translation.y;
+        packet.translation.z[i] = transforms[i].translation.z;
+        packet.rotation.x[i] = transforms[i].rotation.vec.x;
+        packet.rotation.y[i] = transforms[i].rotation.vec.y;
+        packet.rotation.z[i] = transforms[i].rotation.vec.z;
+        packet.rotation.w[i] = transforms[i].rotation.w;
+        packet.scale.x[i] = transforms[i].scale.x;
+        packet.scale.y[i] = transforms[i].scale.y;
+        packet.scale.z[i] = transforms[i].scale.z;
+    }
+}
+
+template<typename T, int N>
+void storePacket(const ttransformPacket<T, N>& packet, ttransform<T>* transforms)
+{
+    for (int i = 0; i < N; ++i) {
+        transforms[i].translation = { packet.translation.x[i], packet.translation.y[i], packet.translation.z[i] };
+        transforms[i].rotation = { { packet.rotation.x[i], packet.rotation.y[i], packet.rotation.z[i] }, packet.rotation.w[i] };
+        transforms[i].scale = { packet.scale.x[i], packet.scale.y[i], packet.scale.z[i] };
+    }
+}
+
+template<typename T, int N>
+ttransformPacket<T, N> operator*(const ttransformPacket<T, N>& parent, const ttransformPacket<T, N>& child)
+{
+    ttransformPacket<T, N> res;
+    res.translation = parent.rotation * (parent.scale * child.translation) + parent.translation;
+    res.rotation = parent.rotation * child.rotation;
+    res.scale = parent.scale * child.scale;
+    return res;
+}
+
+template<typename T, int N>
+tvec3Packet<T, N> transformPoint(const ttransformPacket<T, N>& t, const tvec3Packet<T, N>& points)
+{
+    return t.rotation * (t.scale * points) + t.translation;
+}
+
+// Composes count pairs of transforms, i.e., result[i] = parents[i] * children[i]. The result may alias the inputs.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void composeTransformsBatch(const ttransform<T>* parents, const ttransform<T>* children, ttransform<T>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        ttransformPacket<T, 4> parent, child;
+        loadPacket(parent, parents + i);
+        loadPacket(child, children + i);
+        storePacket(parent * child, result + i);
+    }
+    for (; i < count; ++i) {
+        result[i] = parents[i] * children[i];
+    }
+}
+
+// Transforms count points by the same transform
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void transformPointsBatch(const ttransform<T>& t, const tvec3<T>* points, tvec3<T>* result, size_t count)
+{
+    const ttransform<T> broadcast[4] = { t, t, t, t };
+    ttransformPacket<T, 4> packet;
+    loadPacket(packet, broadcast);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        tvec3Packet<T, 4> p;
+        loadPacket(p, points + i);
+        storePacket(transformPoint(packet, p), result + i);
+    }
+    for (; i < count; ++i) {
+        result[i] = transformPoint(t, points[i]);
+    }
+}
+
+// Transforms count points by the affine matrix m (i.e., ignoring its projective row, which is assumed to be (0, 0, 0, 1)).
+// The result may alias the points. For f32 this is dispatched to the best kernel for the CPU, see cpu.h.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void transformPointsBatch(const tmat4<T>& m, const tvec3<T>* points, tvec3<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        tvec3<T> p = points[i];
+        result[i] = m.x.xyz() * p.x + m.y.xyz() * p.y + m.z.xyz() * p.z + m.w.xyz();
+    }
+}
+
+namespace detail {
+
+    static_assert(sizeof(tvec3<f32>) == 3 * sizeof(f32), "f32 vectors must be tightly packed for the kernels");
+
+    inline void transformPointsScalar(const tmat4<f32>& m, const tvec3<f32>* points, tvec3<f32>* result, size_t count)
+    {
+        transformPointsBatch<f32>(m, points, result, count);
+    }
+
+#ifdef MOOS_SSE
+
+    // Loads four consecutive vec3s (i.e., 12 floats) as structure-of-arrays with three 16-byte loads & some shuffles
+    inline void deinterleaveVec3x4(const tvec3<f32>* v, __m128& x, __m128& y, __m128& z)
+    {
+        const f32* p = value_ptr(v[0]);
+        __m128 a = _mm_loadu_ps(p); // (x0, y0, z0, x1)
+        __m128 b = _mm_loadu_ps(p + 4); // (y1, z1, x2, y2)
+        __m128 c = _mm_loadu_ps(p + 8); // (z2, x3, y3, z3)
+        x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+    inline void interleaveVec3x4(__m128 x, __m128 y, __m128 z, tvec3<f32>* v)
+    {
+        f32* p = value_ptr(v[0]);
+        _mm_storeu_ps(p, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(p + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(p + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+
+    inline void transformPointsSSE2(const tmat4<f32>& m, const tvec3<f32>* points, tvec3<f32>* result, size_t count)
+    {
+        const f32* c = value_ptr(m);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 x, y, z;
+            deinterleaveVec3x4(points + i, x, y, z);
+            __m128 res[3];
+            for (int row = 0; row < 3; ++row) {
+                __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[row]), x), _mm_mul_ps(_mm_set1_ps(c[4 + row]), y));
+                res[row] = _mm_add_ps(_mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(c[8 + row]), z)), _mm_set1_ps(c[12 + row]));
+            }
+            interleaveVec3x4(res[0], res[1], res[2], result + i);
+        }
+        transformPointsScalar(m, points + i, result + i, count - i);
+    }
+
+#endif
+
+#ifdef MOOS_DISPATCH
+
+    // The same as deinterleaveVec3x4, but for eight vec3s, where each 128-bit lane is shuffled like with SSE (with
+    // vectors 0-3 in the low lanes and 4-7 in the high lanes)
+    MOOS_TARGET_AVX2 inline void deinterleaveVec3x8(const tvec3<f32>* v, __m256& x, __m256& y, __m256& z)
+    {
+        const f32* p = value_ptr(v[0]);
+        __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+        __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+        __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+        x = _mm256_shuffle_ps(a, _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        z = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+    MOOS_TARGET_AVX2 inline void interleaveVec3x8(__m256 x, __m256 y, __m256 z, tvec3<f32>* v)
+    {
+        f32* p = value_ptr(v[0]);
+        __m256 a = _mm256_shuffle_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 b = _mm256_shuffle_ps(_mm256_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 c = _mm256_shuffle_ps(_mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        _mm_storeu_ps(p, _mm256_castps256_ps128(a));
+        _mm_storeu_ps(p + 4, _mm256_castps256_ps128(b));
+        _mm_storeu_ps(p + 8, _mm256_castps256_ps128(c));
+        _mm_storeu_ps(p + 12, _mm256_extractf128_ps(a, 1));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(b, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(c, 1));
+    }
+
+    // Sixteen vectors with AVX-512, gathering each component from the three loads with two-source permutes
+    MOOS_TARGET_AVX512 inline void deinterleaveVec3x16(const tvec3<f32>* v, __m512& x, __m512& y, __m512& z)
+    {
+        const f32* p = value_ptr(v[0]);
+        __m512 a = _mm512_loadu_ps(p);
+        __m512 b = _mm512_loadu_ps(p + 16);
+        __m512 c = _mm512_loadu_ps(p + 32);
+        x = _mm512_permutex2var_ps(a, _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 0, 0, 0, 0, 0), b);
+        y = _mm512_permutex2var_ps(a, _mm512_setr_epi32(1, 4, 7, 10, 13, 16, 19, 22, 25, 28, 31, 0, 0, 0, 0, 0), b);
+        z = _mm512_permutex2var_ps(a, _mm512_setr_epi32(2, 5, 8, 11, 14, 17, 20, 23, 26, 29, 0, 0, 0, 0, 0, 0), b);
+        x = _mm512_permutex2var_ps(x, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 17, 20, 23, 26, 29), c);
+        y = _mm512_permutex2var_ps(y, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 18, 21, 24, 27, 30), c);
+        z = _mm512_permutex2var_ps(z, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 19, 22, 25, 28, 31), c);
+    }
 
-    for (int i = 4; i--;) {
-        planes[0][i] = m[i][3] + m[i][0]; // (left)
+    MOOS_TARGET_AVX2 inline void transformPointsAVX2(const tmat4<f32>& m, const tvec3<f32>* points, tvec3<f32>* result, size_t count)
+    {
+        const f32* c = value_ptr(m);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 x, y, z;
+            deinterleaveVec3x8(points + i, x, y, z);
+            __m256 res[3];
+            for (int row = 0; row < 3; ++row) {
+                __m256 r = _mm256_fmadd_ps(_mm256_set1_ps(c[row]), x, _mm256_set1_ps(c[12 + row]));
+                r = _mm256_fmadd_ps(_mm256_set1_ps(c[4 + row]), y, r);
+                res[row] = _mm256_fmadd_ps(_mm256_set1_ps(c[8 + row]), z, r);
+            }
+            interleaveVec3x8(res[0], res[1], res[2], result + i);
+        }
+        transformPointsSSE2(m, points + i, result + i, count - i);
     }
 
-    for (int i = 4; i--;) {
-        planes[1][i] = m[i][3] - m[i][0]; // (right)
+#endif
+
+} // namespace detail
+
+inline void transformPointsBatch(const tmat4<f32>& m, const tvec3<f32>* points, tvec3<f32>* result, size_t count)
+{
+    using Kernel = void (*)(const tmat4<f32>&, const tvec3<f32>*, tvec3<f32>*, size_t);
+    static const KernelTable<Kernel> kernels = {
+        { SimdLevel::Scalar, detail::transformPointsScalar },
+#ifdef MOOS_SSE
+        { SimdLevel::SSE2, detail::transformPointsSSE2 },
+#endif
+#ifdef MOOS_DISPATCH
+        { SimdLevel::AVX2, detail::transformPointsAVX2 },
+#endif
+    };
+    kernels.select()(m, points, result, count);
+}
+
+// Computes world (i.e. root-relative) transforms for a hierarchy of local transforms, where parentIndices[i] is the index
+// of the parent of node i, or negative for root nodes. Parents must come before their children in the arrays.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void computeWorldTransforms(const ttransform<T>* localTransforms, const i32* parentIndices, ttransform<T>* worldTransforms, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        i32 parent = parentIndices[i];
+        MOOS_ASSERT(parent < static_cast<i32>(i));
+        worldTransforms[i] = (parent >= 0)
+            ? worldTransforms[parent] * localTransforms[i]
+            : localTransforms[i];
     }
+}
 
-    for (int i = 4; i--;) {
-        planes[2][i] = m[i][3] + m[i][1]; // (bottom)
+// Matrix decomposition
+
+// An affine matrix decomposed as m = translate(translation) * rotate(rotation) * stretch, where the stretch is the
+// symmetric matrix with scale on the diagonal and shear = (xy, xz, yz) off the diagonal. Without shear this is the
+// usual TRS decomposition (i.e., shear is zero), but unlike it this is exact for any affine matrix, e.g. a composition
+// of transforms with non-uniform scale. A mirroring matrix gets a negated scale (and shear) instead of an improper rotation.
+
+template<typename T, typename _ = void>
+struct tdecomposition {
+};
+
+template<typename T>
+struct tdecomposition<T, ENABLE_STRUCT_IF_FLOATING_POINT(T)> {
+    tvec3<T> translation;
+    tquat<T> rotation;
+    tvec3<T> scale;
+    tvec3<T> shear;
+
+    tmat3<T> stretch() const
+    {
+        return { { scale.x, shear.x, shear.y },
+                 { shear.x, scale.y, shear.z },
+                 { shear.y, shear.z, scale.z } };
     }
 
-    for (int i = 4; i--;) {
-        planes[3][i] = m[i][3] - m[i][1]; // (top)
+    // (drops the shear)
+    constexpr ttransform<T> toTransform() const
+    {
+        return { translation, rotation, scale };
     }
+};
+
+using decomposition = tdecomposition<Float>;
+using fdecomposition = tdecomposition<f32>;
+using ddecomposition = tdecomposition<f64>;
+
+namespace detail {
+
+    constexpr int polarDecompositionMaxIterations = 20;
 
-    for (int i = 4; i--;) {
-        planes[4][i] = m[i][3] + m[i][2]; // (near)
+    template<typename T>
+    constexpr T polarDecompositionTolerance()
+    {
+        // (squared Frobenius norm of the change of an iteration, close to rounding noise for a rotation matrix)
+        return (8 * std::numeric_limits<T>::epsilon()) * (8 * std::numeric_limits<T>::epsilon());
     }
 
-    for (int i = 4; i--;) {
-        planes[5][i] = m[i][3] - m[i][2]; // (far)
+    template<typename T>
+    bool isSingularForDecomposition(T det, T frobeniusSquared)
+    {
+        return !(std::abs(det) > std::numeric_limits<T>::epsilon() * frobeniusSquared * std::sqrt(frobeniusSquared));
     }
+
+    // Finds the orthogonal factor q of the polar decomposition m = q * s with the scaled Newton iteration
+    // q' = (gamma * q + q^-T / gamma) / 2, where q^-T is the cofactor matrix over the determinant and gamma is the
+    // Frobenius norm scaling which makes the iteration converge in a handful of steps even for large scale ratios.
+    // Returns false for singular matrices, which don't have a unique orthogonal factor.
+    template<typename T>
+    bool polarDecomposition(const tmat3<T>& m, tmat3<T>& q)
+    {
+        q = m;
+        for (int iteration = 0; iteration < polarDecompositionMaxIterations; ++iteration) {
+            tvec3<T> cx = cross(q.y, q.z), cy = cross(q.z, q.x), cz = cross(q.x, q.y);
+            T det = dot(q.x, cx);
+            T norm2 = dot(q.x, q.x) + dot(q.y, q.y) + dot(q.z, q.z);
+            if (iteration == 0 && isSingularForDecomposition(det, norm2)) {
+                return false;
+            }
+
+            T invDet = static_cast<T>(1) / det;
+            T inverseNorm2 = (dot(cx, cx) + dot(cy, cy) + dot(cz, cz)) * invDet * invDet;
+            T gamma = std::sqrt(std::sqrt(inverseNorm2 / norm2));
+            T a = static_cast<T>(0.5) * gamma;
+            T b = static_cast<T>(0.5) * invDet / gamma;
+
+            tmat3<T> next = { a * q.x + b * cx, a * q.y + b * cy, a * q.z + b * cz };
+            tvec3<T> dx = next.x - q.x, dy = next.y - q.y, dz = next.z - q.z;
+            q = next;
+            if (dot(dx, dx) + dot(dy, dy) + dot(dz, dz) <= polarDecompositionTolerance<T>()) {
+                break;
+            }
+        }
+        return true;
+    }
+
+} // namespace detail
+
+// Decomposes an affine matrix (see tdecomposition). Singular matrices (e.g. with a zero scale) have no unique rotation,
+// and decompose to the identity rotation and the column lengths as scale.
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+tdecomposition<T> decompose(const tmat4<T>& m)
+{
+    tdecomposition<T> result;
+    result.translation = m.w.xyz();
+
+    tmat3<T> m3 = tmat3<T>(m);
+    tmat3<T> q;
+    if (!detail::polarDecomposition(m3, q)) {
+        result.rotation = tquat<T>();
+        result.scale = { length(m3.x), length(m3.y), length(m3.z) };
+        result.shear = tvec3<T>(static_cast<T>(0));
+        return result;
+    }
+
+    // (q is flipped if it's a reflection, and the stretch is q^T * m, symmetrized to remove rounding errors)
+    if (determinant(m3) < static_cast<T>(0)) {
+        q = static_cast<T>(-1) * q;
+    }
+    result.rotation = quatFromMatrix(tmat4<T>(q));
+    result.scale = { dot(q.x, m3.x), dot(q.y, m3.y), dot(q.z, m3.z) };
+    result.shear = static_cast<T>(0.5) * tvec3<T>(dot(q.x, m3.y) + dot(q.y, m3.x), dot(q.x, m3.z) + dot(q.z, m3.x), dot(q.y, m3.z) + dot(q.z, m3.y));
+    return result;
 }
 
+// Batch versions of decompose, with the result either as full decompositions or as TRS transforms (dropping any shear).
+// For f32 these are SSE versions which iterate four polar decompositions at a time.
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void decomposeBatch(const tmat4<T>* matrices, tdecomposition<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = decompose(matrices[i]);
+    }
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+void decomposeBatch(const tmat4<T>* matrices, ttransform<T>* result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = decompose(matrices[i]).toTransform();
+    }
+}
+
+#ifdef MOOS_SSE
+
+namespace detail {
+
+    // Decomposes four matrices, see decompose. Returns a mask of the lanes with singular matrices, which are left untouched.
+    inline int decomposex4(const tmat4<f32>* matrices, tdecomposition<f32>* result)
+    {
+        // m[column][row] holds that entry for the four matrices
+        __m128 m[3][3];
+        for (int col = 0; col < 3; ++col) {
+            __m128 x = _mm_loadu_ps(value_ptr(matrices[0]) + 4 * col);
+            __m128 y = _mm_loadu_ps(value_ptr(matrices[1]) + 4 * col);
+            __m128 z = _mm_loadu_ps(value_ptr(matrices[2]) + 4 * col);
+            __m128 w = _mm_loadu_ps(value_ptr(matrices[3]) + 4 * col);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            m[col][0] = x, m[col][1] = y, m[col][2] = z;
+        }
+
+        auto dot3 = [](const __m128 a[3], const __m128 b[3]) {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+        };
+
+        __m128 q[3][3];
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 0; row < 3; ++row) {
+                q[col][row] = m[col][row];
+            }
+        }
+        __m128 originalDet = _mm_setzero_ps();
+        int singularMask = 0;
+
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 tolerance = _mm_set1_ps(polarDecompositionTolerance<f32>());
+        for (int iteration = 0; iteration < polarDecompositionMaxIterations; ++iteration) {
+            __m128 c[3][3];
+            cross3x4(q[1][0], q[1][1], q[1][2], q[2][0], q[2][1], q[2][2], c[0][0], c[0][1], c[0][2]);
+            cross3x4(q[2][0], q[2][1], q[2][2], q[0][0], q[0][1], q[0][2], c[1][0], c[1][1], c[1][2]);
+            cross3x4(q[0][0], q[0][1], q[0][2], q[1][0], q[1][1], q[1][2], c[2][0], c[2][1], c[2][2]);
+            __m128 det = dot3(q[0], c[0]);
+            __m128 norm2 = _mm_add_ps(_mm_add_ps(dot3(q[0], q[0]), dot3(q[1], q[1])), dot3(q[2], q[2]));
+
+            if (iteration == 0) {
+                originalDet = det;
+                alignas(16) f32 dets[4], norms[4];
+                _mm_store_ps(dets, det);
+                _mm_store_ps(norms, norm2);
+                for (int lane = 0; lane < 4; ++lane) {
+                    singularMask |= isSingularForDecomposition(dets[lane], norms[lane]) ? (1 << lane) : 0;
+                }
+                if (singularMask == 0xF) {
+                    return singularMask;
+                }
+            }
+
+            __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+            __m128 inverseNorm2 = _mm_add_ps(_mm_add_ps(dot3(c[0], c[0]), dot3(c[1], c[1])), dot3(c[2], c[2]));
+            inverseNorm2 = _mm_mul_ps(inverseNorm2, _mm_mul_ps(invDet, invDet));
+            __m128 gamma = _mm_sqrt_ps(_mm_sqrt_ps(_mm_div_ps(inverseNorm2, norm2)));
+            __m128 a = _mm_mul_ps(half, gamma);
+            __m128 b = _mm_div_ps(_mm_mul_ps(half, invDet), gamma);
+
+            __m128 change = _mm_setzero_ps();
+            for (int col = 0; col < 3; ++col) {
+                for (int row = 0; row < 3; ++row) {
+                    __m128 next = _mm_add_ps(_mm_mul_ps(a, q[col][row]), _mm_mul_ps(b, c[col][row]));
+                    __m128 difference = _mm_sub_ps(next, q[col][row]);
+                    change = _mm_add_ps(change, _mm_mul_ps(difference, difference));
+                    q[col][row] = next;
+                }
+            }
+
+            // (lanes with singular matrices are NaN or infinite, which compare as converged or are masked out)
+            int notConverged = _mm_movemask_ps(_mm_cmpgt_ps(change, tolerance)) & ~singularMask;
+            if (notConverged == 0) {
+                break;
+            }
+        }
+
+        // Flip q for reflections, compute the stretch q^T * m, and convert q to quaternions
+        __m128 sign = _mm_and_ps(originalDet, _mm_set1_ps(-0.0f));
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 0; row < 3; ++row) {
+                q[col][row] = _mm_xor_ps(q[col][row], sign);
+            }
+        }
+        __m128 scale[3], shear[3];
+        for (int k = 0; k < 3; ++k) {
+            scale[k] = dot3(q[k], m[k]);
+        }
+        shear[0] = _mm_mul_ps(half, _mm_add_ps(dot3(q[0], m[1]), dot3(q[1], m[0])));
+        shear[1] = _mm_mul_ps(half, _mm_add_ps(dot3(q[0], m[2]), dot3(q[2], m[0])));
+        shear[2] = _mm_mul_ps(half, _mm_add_ps(dot3(q[1], m[2]), dot3(q[2], m[1])));
+
+        tquat<f32> rotations[4];
+        quatFromMatrixEntries4(q, rotations);
+
+        alignas(16) f32 values[6][4];
+        for (int k = 0; k < 3; ++k) {
+            _mm_store_ps(values[k], scale[k]);
+            _mm_store_ps(values[3 + k], shear[k]);
+        }
+        for (int lane = 0; lane < 4; ++lane) {
+            if (singularMask & (1 << lane)) {
+                continue;
+            }
+            result[lane].translation = matrices[lane].w.xyz();
+            result[lane].rotation = rotations[lane];
+            result[lane].scale = { values[0][lane], values[1][lane], values[2][lane] };
+            result[lane].shear = { values[3][lane], values[4][lane], values[5][lane] };
+        }
+        return singularMask;
+    }
+
+} // namespace detail
+
+template<>
+inline void decomposeBatch(const tmat4<f32>* matrices, tdecomposition<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int singularMask = detail::decomposex4(matrices + i, result + i);
+        for (int lane = 0; lane < 4; ++lane) {
+            if (singularMask & (1 << lane)) {
+                result[i + lane] = decompose(matrices[i + lane]);
+            }
+        }
+    }
+
+    for (; i < count; ++i) {
+        result[i] = decompose(matrices[i]);
+    }
+}
+
+template<>
+inline void decomposeBatch(const tmat4<f32>* matrices, ttransform<f32>* result, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        tdecomposition<f32> decompositions[4];
+        decomposeBatch(matrices + i, decompositions, 4);
+        for (int lane = 0; lane < 4; ++lane) {
+            result[i + lane] = decompositions[lane].toTransform();
+        }
+    }
+
+    for (; i < count; ++i) {
+        result[i] = decompose(matrices[i]).toTransform();
+    }
+}
+
+#endif
+
 } // namespace moos
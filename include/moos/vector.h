@@ -99,7 +99,7 @@ struct tvec2<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return x == other.x && y == other.y;
     }
 
-    T& operator[](int index)
+    constexpr T& operator[](int index)
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 2);
@@ -107,7 +107,7 @@ struct tvec2<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *v[index];
     }
 
-    const T& operator[](int index) const
+    constexpr const T& operator[](int index) const
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 2);
@@ -118,6 +118,7 @@ struct tvec2<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     constexpr tvec2<T> operator+() const { return *this; }
     constexpr tvec2<T> operator-() const { return { -x, -y }; }
 
+    constexpr tvec2<T> operator+(T t) const { return { x + t, y + t }; }
     constexpr tvec2<T> operator+(const tvec2<T>& v) const { return { x + v.x, y + v.y }; }
     constexpr tvec2<T>& operator+=(const tvec2<T>& v)
     {
@@ -126,6 +127,7 @@ struct tvec2<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *this;
     }
 
+    constexpr tvec2<T> operator-(T t) const { return { x - t, y - t }; }
     constexpr tvec2<T> operator-(const tvec2<T>& v) const { return { x - v.x, y - v.y }; }
     constexpr tvec2<T>& operator-=(const tvec2<T>& v)
     {
@@ -134,6 +136,22 @@ struct tvec2<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *this;
     }
 
+    constexpr tvec2<T> operator*(const tvec2<T>& v) const { return { x * v.x, y * v.y }; }
+    constexpr tvec2<T>& operator*=(const tvec2<T>& v)
+    {
+        x *= v.x;
+        y *= v.y;
+        return *this;
+    }
+
+    constexpr tvec2<T> operator/(const tvec2<T>& v) const { return { x / v.x, y / v.y }; }
+    constexpr tvec2<T>& operator/=(const tvec2<T>& v)
+    {
+        x /= v.x;
+        y /= v.y;
+        return *this;
+    }
+
     constexpr tvec2<T> operator*(T f) const { return { x * f, y * f }; }
     constexpr tvec2<T>& operator*=(T f)
     {
@@ -172,7 +190,7 @@ constexpr T length2(const tvec2<T>& v)
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
 constexpr T length(const tvec2<T>& v)
 {
-    return std::sqrt(length2(v));
+    return cx::sqrt(length2(v));
 }
 
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
@@ -293,7 +311,12 @@ struct tvec3<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     {
     }
 
-    T& operator[](int index)
+    bool operator==(const tvec3& other) const
+    {
+        return x == other.x && y == other.y && z == other.z;
+    }
+
+    constexpr T& operator[](int index)
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 3);
@@ -301,7 +324,7 @@ struct tvec3<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *v[index];
     }
 
-    const T& operator[](int index) const
+    constexpr const T& operator[](int index) const
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 3);
@@ -400,7 +423,7 @@ constexpr T length2(const tvec3<T>& v)
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
 constexpr T length(const tvec3<T>& v)
 {
-    return std::sqrt(length2(v));
+    return cx::sqrt(length2(v));
 }
 
 template<typename T, ENABLE_IF_FLOATING_POINT(T)>
@@ -528,7 +551,12 @@ struct tvec4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     {
     }
 
-    T& operator[](int index)
+    bool operator==(const tvec4& other) const
+    {
+        return x == other.x && y == other.y && z == other.z && w == other.w;
+    }
+
+    constexpr T& operator[](int index)
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 4);
@@ -536,7 +564,7 @@ struct tvec4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
         return *v[index];
     }
 
-    const T& operator[](int index) const
+    constexpr const T& operator[](int index) const
     {
         MOOS_ASSERT(index >= 0);
         MOOS_ASSERT(index < 4);
@@ -547,8 +575,67 @@ struct tvec4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     constexpr tvec4<T> operator+() const { return *this; }
     constexpr tvec4<T> operator-() const { return { -x, -y, -z, -w }; }
 
+    constexpr tvec4<T> operator+(T t) const { return { x + t, y + t, z + t, w + t }; }
     constexpr tvec4<T> operator+(const tvec4<T>& v) const { return { x + v.x, y + v.y, z + v.z, w + v.w }; }
+    constexpr tvec4<T>& operator+=(const tvec4<T>& v)
+    {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        w += v.w;
+        return *this;
+    }
+
+    constexpr tvec4<T> operator-(T t) const { return { x - t, y - t, z - t, w - t }; }
     constexpr tvec4<T> operator-(const tvec4<T>& v) const { return { x - v.x, y - v.y, z - v.z, w - v.w }; }
+    constexpr tvec4<T>& operator-=(const tvec4<T>& v)
+    {
+        x -= v.x;
+        y -= v.y;
+        z -= v.z;
+        w -= v.w;
+        return *this;
+    }
+
+    constexpr tvec4<T> operator*(const tvec4<T>& v) const { return { x * v.x, y * v.y, z * v.z, w * v.w }; }
+    constexpr tvec4<T>& operator*=(const tvec4<T>& v)
+    {
+        x *= v.x;
+        y *= v.y;
+        z *= v.z;
+        w *= v.w;
+        return *this;
+    }
+
+    constexpr tvec4<T> operator/(const tvec4<T>& v) const { return { x / v.x, y / v.y, z / v.z, w / v.w }; }
+    constexpr tvec4<T>& operator/=(const tvec4<T>& v)
+    {
+        x /= v.x;
+        y /= v.y;
+        z /= v.z;
+        w /= v.w;
+        return *this;
+    }
+
+    constexpr tvec4<T> operator*(T f) const { return { x * f, y * f, z * f, w * f }; }
+    constexpr tvec4<T>& operator*=(T f)
+    {
+        x *= f;
+        y *= f;
+        z *= f;
+        w *= f;
+        return *this;
+    }
+
+    constexpr tvec4<T> operator/(T f) const { return { x / f, y / f, z / f, w / f }; }
+    constexpr tvec4<T>& operator/=(T f)
+    {
+        x /= f;
+        y /= f;
+        z /= f;
+        w /= f;
+        return *this;
+    }
 
     // (a rare member function to simulate swizzling)
     constexpr tvec3<T> xyz() const
@@ -557,6 +644,12 @@ struct tvec4<T, ENABLE_STRUCT_IF_ARITHMETIC(T)> {
     }
 };
 
+template<typename T, ENABLE_IF_ARITHMETIC(T)>
+constexpr tvec4<T> operator*(T lhs, const tvec4<T>& rhs)
+{
+    return rhs * lhs;
+}
+
 template<typename T, ENABLE_IF_ARITHMETIC(T)>
 constexpr T dot(const tvec4<T>& lhs, const tvec4<T>& rhs)
 {
@@ -564,24 +657,418 @@ constexpr T dot(const tvec4<T>& lhs, const tvec4<T>& rhs)
 }
 
 template<>
-inline f32 dot(const tvec4<f32>& lhs, const tvec4<f32>& rhs)
-{
-#ifdef __SSE__
-    auto* a = reinterpret_cast<const __m128*>(value_ptr(lhs));
-    auto* b = reinterpret_cast<const __m128*>(value_ptr(rhs));
-    __m128 prod = _mm_mul_ps(*a, *b);
-    return prod[0] + prod[1] + prod[2] + prod[3];
-#else
-    return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
+MOOS_CONSTEXPR_SIMD f32 dot(const tvec4<f32>& lhs, const tvec4<f32>& rhs)
+{
+#ifdef MOOS_SSE
+    if (!isConstantEvaluated()) {
+        __m128 a = _mm_loadu_ps(value_ptr(lhs));
+        __m128 b = _mm_loadu_ps(value_ptr(rhs));
+        __m128 prod = _mm_mul_ps(a, b);
+        return prod[0] + prod[1] + prod[2] + prod[3];
+    }
 #endif
+    return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
+}
+
+template<typename T, ENABLE_IF_ARITHMETIC(T)>
+constexpr T length2(const tvec4<T>& v)
+{
+    return dot(v, v);
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T length(const tvec4<T>& v)
+{
+    return cx::sqrt(length2(v));
 }
 
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T distance(const tvec4<T>& a, const tvec4<T>& b)
+{
+    return length(a - b);
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec4<T> normalize(const tvec4<T>& v)
+{
+    return v / length(v);
+}
+
+template<typename T, ENABLE_IF_ARITHMETIC(T)>
+constexpr tvec4<T> min(const tvec4<T>& lhs, const tvec4<T>& rhs)
+{
+    return { std::min(lhs.x, rhs.x), std::min(lhs.y, rhs.y), std::min(lhs.z, rhs.z), std::min(lhs.w, rhs.w) };
+}
+
+template<typename T, ENABLE_IF_ARITHMETIC(T)>
+constexpr tvec4<T> max(const tvec4<T>& lhs, const tvec4<T>& rhs)
+{
+    return { std::max(lhs.x, rhs.x), std::max(lhs.y, rhs.y), std::max(lhs.z, rhs.z), std::max(lhs.w, rhs.w) };
+}
+
+template<typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvec4<T> lerp(const tvec4<T>& a, const tvec4<T>& b, T x)
+{
+    return (static_cast<T>(1) - x) * a + x * b;
+}
+
+template<typename T, ENABLE_IF_ARITHMETIC(T)>
+constexpr tvec4<T> clamp(const tvec4<T>& x, const tvec4<T>& minEdge, const tvec4<T>& maxEdge)
+{
+    return max(minEdge, min(x, maxEdge));
+}
+
+#ifdef MOOS_SSE
+namespace simd {
+
+    // Small helpers for SSE code paths operating on f32 vectors stored in a __m128 as (x, y, z, w)
+
+    inline __m128 load(const tvec3<f32>& v, f32 w = 0.0f)
+    {
+        return _mm_setr_ps(v.x, v.y, v.z, w);
+    }
+
+    inline tvec3<f32> storeVec3(__m128 v)
+    {
+        alignas(16) f32 res[4];
+        _mm_store_ps(res, v);
+        return { res[0], res[1], res[2] };
+    }
+
+    template<int index>
+    inline __m128 splat(__m128 v)
+    {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(index, index, index, index));
+    }
+
+    inline __m128 cross3(__m128 a, __m128 b)
+    {
+        // (the w-component of the result is a.w * b.w - a.w * b.w, i.e., zero for finite inputs)
+        __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    inline __m128 dot4(__m128 a, __m128 b)
+    {
+        // Returns the dot product in all four lanes
+        __m128 prod = _mm_mul_ps(a, b);
+        __m128 sum = _mm_add_ps(prod, _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+} // namespace simd
+#endif
+
 using vec4 = tvec4<Float>;
 using fvec4 = tvec4<f32>;
 using dvec4 = tvec4<f64>;
 using uvec4 = tvec4<u32>;
 using ivec4 = tvec4<i32>;
 
+// Generic fixed-dimension vectors, e.g. for feature vectors or small linear systems. All operations are expanded per
+// element at compile time (with index sequences, and pairwise sums for the reductions), so there are no loops for the
+// compiler to unroll and the code auto-vectorizes well. Vectors whose size is a power of two of at most 64 bytes are
+// aligned to their size (like tvec3Packet) so they can be loaded with aligned SIMD loads.
+
+namespace detail {
+
+    constexpr size_t vecNAlignment(size_t size, size_t elementAlignment)
+    {
+        return ((size & (size - 1)) == 0 && size <= 64 && size > elementAlignment) ? size : elementAlignment;
+    }
+
+    struct ElementsTag {
+    };
+
+    template<typename... Ts>
+    constexpr bool allArithmetic()
+    {
+        bool result = true;
+        const bool arithmetic[] = { true, std::is_arithmetic<Ts>::value... };
+        for (bool a : arithmetic) {
+            result = result && a;
+        }
+        return result;
+    }
+
+} // namespace detail
+
+template<size_t N, typename T>
+struct alignas(detail::vecNAlignment(N * sizeof(T), alignof(T))) tvecN {
+    static_assert(N > 0, "tvecN must have at least one element");
+    static_assert(std::is_arithmetic<T>::value, "tvecN is only defined for arithmetic types");
+
+    static constexpr size_t size = N;
+    T elements[N];
+
+    constexpr tvecN() noexcept
+        : tvecN(static_cast<T>(0))
+    {
+    }
+
+    explicit constexpr tvecN(T e) noexcept
+        : tvecN(e, std::make_index_sequence<N> {})
+    {
+    }
+
+    template<typename... Ts, typename = typename std::enable_if<(N > 1 && sizeof...(Ts) == N && detail::allArithmetic<Ts...>())>::type>
+    constexpr tvecN(Ts... es) noexcept
+        : elements { static_cast<T>(es)... }
+    {
+    }
+
+    template<typename Fn, size_t... I>
+    constexpr tvecN(detail::ElementsTag, Fn&& fn, std::index_sequence<I...>) noexcept
+        : elements { fn(I)... }
+    {
+    }
+
+    template<size_t M = N, typename = typename std::enable_if<M == 2>::type>
+    explicit constexpr tvecN(const tvec2<T>& v) noexcept
+        : elements { v.x, v.y }
+    {
+    }
+
+    template<size_t M = N, typename = typename std::enable_if<M == 3>::type>
+    explicit constexpr tvecN(const tvec3<T>& v) noexcept
+        : elements { v.x, v.y, v.z }
+    {
+    }
+
+    template<size_t M = N, typename = typename std::enable_if<M == 4>::type>
+    explicit constexpr tvecN(const tvec4<T>& v) noexcept
+        : elements { v.x, v.y, v.z, v.w }
+    {
+    }
+
+    // Constructs the vector from fn(i) for every index i
+    template<typename Fn>
+    static constexpr tvecN generate(Fn&& fn)
+    {
+        return tvecN(detail::ElementsTag {}, fn, std::make_index_sequence<N> {});
+    }
+
+    static tvecN load(const T* values)
+    {
+        return generate([values](size_t i) { return values[i]; });
+    }
+
+    void store(T* values) const
+    {
+        for (size_t i = 0; i < N; ++i) {
+            values[i] = elements[i];
+        }
+    }
+
+    template<size_t M = N, typename = typename std::enable_if<M == 2>::type>
+    constexpr tvec2<T> vec() const { return { elements[0], elements[1] }; }
+    template<size_t M = N, typename = typename std::enable_if<M == 3>::type, typename = void>
+    constexpr tvec3<T> vec() const { return { elements[0], elements[1], elements[2] }; }
+    template<size_t M = N, typename = typename std::enable_if<M == 4>::type, typename = void, typename = void>
+    constexpr tvec4<T> vec() const { return { elements[0], elements[1], elements[2], elements[3] }; }
+
+    constexpr T& operator[](int index)
+    {
+        MOOS_ASSERT(index >= 0);
+        MOOS_ASSERT(index < static_cast<int>(N));
+        return elements[index];
+    }
+
+    constexpr const T& operator[](int index) const
+    {
+        MOOS_ASSERT(index >= 0);
+        MOOS_ASSERT(index < static_cast<int>(N));
+        return elements[index];
+    }
+
+    constexpr bool operator==(const tvecN& v) const { return equal(v, std::make_index_sequence<N> {}); }
+    constexpr bool operator!=(const tvecN& v) const { return !(*this == v); }
+
+    constexpr tvecN operator+() const { return *this; }
+    constexpr tvecN operator-() const { return generate([this](size_t i) { return -elements[i]; }); }
+
+    constexpr tvecN operator+(const tvecN& v) const { return generate([this, &v](size_t i) { return elements[i] + v.elements[i]; }); }
+    constexpr tvecN operator-(const tvecN& v) const { return generate([this, &v](size_t i) { return elements[i] - v.elements[i]; }); }
+    constexpr tvecN operator*(const tvecN& v) const { return generate([this, &v](size_t i) { return elements[i] * v.elements[i]; }); }
+    constexpr tvecN operator/(const tvecN& v) const { return generate([this, &v](size_t i) { return elements[i] / v.elements[i]; }); }
+
+    constexpr tvecN operator+(T t) const { return generate([this, t](size_t i) { return elements[i] + t; }); }
+    constexpr tvecN operator-(T t) const { return generate([this, t](size_t i) { return elements[i] - t; }); }
+    constexpr tvecN operator*(T f) const { return generate([this, f](size_t i) { return elements[i] * f; }); }
+    constexpr tvecN operator/(T f) const { return generate([this, f](size_t i) { return elements[i] / f; }); }
+
+    constexpr tvecN& operator+=(const tvecN& v) { return *this = *this + v; }
+    constexpr tvecN& operator-=(const tvecN& v) { return *this = *this - v; }
+    constexpr tvecN& operator*=(const tvecN& v) { return *this = *this * v; }
+    constexpr tvecN& operator/=(const tvecN& v) { return *this = *this / v; }
+    constexpr tvecN& operator*=(T f) { return *this = *this * f; }
+    constexpr tvecN& operator/=(T f) { return *this = *this / f; }
+
+private:
+    template<size_t... I>
+    constexpr tvecN(T e, std::index_sequence<I...>) noexcept
+        : elements { (static_cast<void>(I), e)... }
+    {
+    }
+
+    template<size_t... I>
+    constexpr bool equal(const tvecN& v, std::index_sequence<I...>) const
+    {
+        bool result = true;
+        const bool equalities[] = { (elements[I] == v.elements[I])... };
+        for (bool e : equalities) {
+            result = result && e;
+        }
+        return result;
+    }
+};
+
+namespace detail {
+
+    // Pairwise sum of elements [Begin, Begin + Count), which keeps the dependency chain short
+    template<size_t Begin, size_t Count>
+    struct PairwiseSum {
+        template<size_t N, typename T>
+        static constexpr T of(const tvecN<N, T>& v)
+        {
+            return PairwiseSum<Begin, Count / 2>::of(v) + PairwiseSum<Begin + Count / 2, Count - Count / 2>::of(v);
+        }
+    };
+
+    template<size_t Begin>
+    struct PairwiseSum<Begin, 1> {
+        template<size_t N, typename T>
+        static constexpr T of(const tvecN<N, T>& v)
+        {
+            return v.elements[Begin];
+        }
+    };
+
+} // namespace detail
+
+template<size_t N, typename T>
+constexpr tvecN<N, T> operator*(T lhs, const tvecN<N, T>& rhs)
+{
+    return rhs * lhs;
+}
+
+// Sum of all elements
+template<size_t N, typename T>
+constexpr T sum(const tvecN<N, T>& v)
+{
+    return detail::PairwiseSum<0, N>::of(v);
+}
+
+template<size_t N, typename T>
+constexpr T dot(const tvecN<N, T>& lhs, const tvecN<N, T>& rhs)
+{
+    return sum(lhs * rhs);
+}
+
+template<size_t N, typename T>
+constexpr T length2(const tvecN<N, T>& v)
+{
+    return dot(v, v);
+}
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T length(const tvecN<N, T>& v)
+{
+    return cx::sqrt(length2(v));
+}
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr T distance(const tvecN<N, T>& a, const tvecN<N, T>& b)
+{
+    return length(a - b);
+}
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvecN<N, T> normalize(const tvecN<N, T>& v)
+{
+    return v / length(v);
+}
+
+template<size_t N, typename T>
+constexpr tvecN<N, T> min(const tvecN<N, T>& lhs, const tvecN<N, T>& rhs)
+{
+    return tvecN<N, T>::generate([&](size_t i) { return std::min(lhs.elements[i], rhs.elements[i]); });
+}
+
+template<size_t N, typename T>
+constexpr tvecN<N, T> max(const tvecN<N, T>& lhs, const tvecN<N, T>& rhs)
+{
+    return tvecN<N, T>::generate([&](size_t i) { return std::max(lhs.elements[i], rhs.elements[i]); });
+}
+
+template<size_t N, typename T, ENABLE_IF_FLOATING_POINT(T)>
+constexpr tvecN<N, T> lerp(const tvecN<N, T>& a, const tvecN<N, T>& b, T x)
+{
+    return (static_cast<T>(1) - x) * a + x * b;
+}
+
+template<size_t N, typename T>
+constexpr tvecN<N, T> clamp(const tvecN<N, T>& x, const tvecN<N, T>& minEdge, const tvecN<N, T>& maxEdge)
+{
+    return max(minEdge, min(x, maxEdge));
+}
+
+template<size_t N>
+using vecN = tvecN<N, Float>;
+using vec8 = tvecN<8, Float>;
+using vec16 = tvecN<16, Float>;
+using fvec8 = tvecN<8, f32>;
+using fvec16 = tvecN<16, f32>;
+
+// Vector packets, i.e., N vectors stored as structure-of-arrays for batch processing (see also tquatPacket)
+
+template<typename T, int N>
+struct alignas(detail::vecNAlignment(N * sizeof(T), alignof(T))) tvec3Packet {
+    T x[N], y[N], z[N];
+
+    tvec3Packet<T, N> operator+(const tvec3Packet<T, N>& v) const
+    {
+        tvec3Packet<T, N> res;
+        for (int i = 0; i < N; ++i) {
+            res.x[i] = x[i] + v.x[i];
+            res.y[i] = y[i] + v.y[i];
+            res.z[i] = z[i] + v.z[i];
+        }
+        return res;
+    }
+
+    tvec3Packet<T, N> operator*(const tvec3Packet<T, N>& v) const
+    {
+        tvec3Packet<T, N> res;
+        for (int i = 0; i < N; ++i) {
+            res.x[i] = x[i] * v.x[i];
+            res.y[i] = y[i] * v.y[i];
+            res.z[i] = z[i] * v.z[i];
+        }
+        return res;
+    }
+};
+
+template<typename T, int N>
+void loadPacket(tvec3Packet<T, N>& packet, const tvec3<T>* vectors)
+{
+    for (int i = 0; i < N; ++i) {
+        packet.x[i] = vectors[i].x;
+        packet.y[i] = vectors[i].y;
+        packet.z[i] = vectors[i].z;
+    }
+}
+
+template<typename T, int N>
+void storePacket(const tvec3Packet<T, N>& packet, tvec3<T>* vectors)
+{
+    for (int i = 0; i < N; ++i) {
+        vectors[i] = { packet.x[i], packet.y[i], packet.z[i] };
+    }
+}
+
 // Vector math constants
 
 constexpr vec3 globalX = vec3(static_cast<Float>(1), static_cast<Float>(0), static_cast<Float>(0));
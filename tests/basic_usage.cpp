@@ -1,13 +1,27 @@
+#include <moos/allocators.h>
+#include <moos/animation.h>
+#include <moos/camera.h>
+#include <moos/camerarelative.h>
 #include <moos/color.h>
+#include <moos/cpu.h>
+#include <moos/df64.h>
+#include <moos/dualquaternion.h>
+#include <moos/frustum.h>
 #include <moos/material.h>
 #include <moos/matrix.h>
+#include <moos/matrixnm.h>
+#include <moos/occlusion.h>
+#include <moos/parallel.h>
+#include <moos/quatcompression.h>
 #include <moos/quaternion.h>
 #include <moos/random.h>
+#include <moos/shadows.h>
 #include <moos/spd.h>
 #include <moos/transform.h>
 #include <moos/vector.h>
 
 #include <fmt/format.h>
+#include <cstring>
 #include <limits>
 
 int main()
@@ -41,6 +55,109 @@ int main()
         }
     }
 
+    fmt::print("fast math:\n");
+    {
+        for (f32 x = -10.0f; x <= 10.0f; x += 0.37f) {
+            f32 s, c;
+            fast::sincos(x, s, c);
+            assert(std::abs(s - std::sin(x)) < 2e-7f && std::abs(c - std::cos(x)) < 2e-7f);
+            assert(std::abs(fast::atan2(x, 0.5f) - std::atan2(x, 0.5f)) < 4e-7f);
+            assert(std::abs(fast::atan2(0.5f, x) - std::atan2(0.5f, x)) < 1e-6f);
+            assert(std::abs(fast::exp(x) - std::exp(x)) <= 2.5e-7f * std::exp(x));
+            assert(std::abs(fast::exp2(x) - std::exp2(x)) <= 2.5e-7f * std::exp2(x));
+            assert(std::abs(fast::cbrt(x) - std::cbrt(x)) <= 2.5e-7f * std::abs(std::cbrt(x)));
+        }
+        for (f32 x = -0.99f; x < 1.0f; x += 0.03f) {
+            assert(std::abs(fast::tan(x) - std::tan(x)) < 3e-7f);
+            assert(std::abs(fast::asin(x) - std::asin(x)) < 4e-7f);
+            assert(std::abs(fast::acos(x) - std::acos(x)) < 5e-7f);
+        }
+        for (f32 x = 1e-6f; x < 1e6f; x *= 1.7f) {
+            assert(std::abs(fast::log(x) - std::log(x)) < 2e-7f * std::max(1.0f, std::abs(std::log(x))));
+            assert(std::abs(fast::log2(x) - std::log2(x)) < 2e-7f * std::max(1.0f, std::abs(std::log2(x))));
+            assert(std::abs(fast::rsqrt(x) - 1.0f / std::sqrt(x)) < 5e-7f / std::sqrt(x));
+            assert(std::abs(fast::pow(x, 2.4f) - std::pow(x, 2.4f)) < 8e-6f * std::pow(x, 2.4f));
+        }
+
+        assert(fast::log(0.0f) == -std::numeric_limits<f32>::infinity() && std::isnan(fast::log(-1.0f)));
+        assert(fast::exp(-100.0f) == 0.0f && fast::exp(100.0f) == std::numeric_limits<f32>::infinity());
+        assert(fast::exp2(127.5f) < std::numeric_limits<f32>::infinity() && fast::pow(0.0f, 0.0f) == 1.0f);
+        assert(fast::atan2(0.0f, -1.0f) == fast::detail::pi && fast::cbrt(-8.0f) == -2.0f);
+        assert(std::isnan(fast::sin(3e9f)) && std::isnan(fast::cos(-std::numeric_limits<f32>::infinity())));
+        assert(std::isnan(fast::sin(std::numeric_limits<f32>::quiet_NaN())) && std::abs(fast::sin(1e7f)) <= 1.0f);
+        fmt::print(" fast::exp(1)={}, fast::pow(2, 0.5)={}, fast::cbrt(27)={}\n", fast::exp(1.0f), fast::pow(2.0f, 0.5f), fast::cbrt(27.0f));
+
+#ifdef MOOS_SSE
+        {
+            // The SIMD versions give the same results as the scalar ones (except for rsqrt)
+            alignas(16) f32 x[4] = { -3.1f, 0.2f, 1.7f, 42.0f };
+            alignas(16) f32 res[4];
+            __m128 s, c;
+            fast::sincos(_mm_load_ps(x), s, c);
+            _mm_store_ps(res, s);
+            for (int i = 0; i < 4; ++i) {
+                assert(res[i] == fast::sin(x[i]));
+            }
+            _mm_store_ps(res, fast::pow(_mm_set1_ps(0.3f), _mm_load_ps(x)));
+            for (int i = 0; i < 4; ++i) {
+                assert(res[i] == fast::pow(0.3f, x[i]));
+            }
+            _mm_store_ps(res, fast::sin(_mm_setr_ps(3e9f, -1e7f, std::numeric_limits<f32>::infinity(), 1.0f)));
+            assert(std::isnan(res[0]) && res[1] == fast::sin(-1e7f) && std::isnan(res[2]) && res[3] == fast::sin(1.0f));
+            _mm_store_ps(res, fast::log(_mm_load_ps(x)));
+            assert(std::isnan(res[0]) && res[3] == fast::log(42.0f));
+        }
+#endif
+#ifdef MOOS_AVX2
+        {
+            alignas(32) f32 x[8] = { -3.1f, 0.2f, 1.7f, 42.0f, -0.5f, 0.0f, 7.0f, 1e10f };
+            alignas(32) f32 res[8];
+            _mm256_store_ps(res, fast::cbrt(_mm256_load_ps(x)));
+            for (int i = 0; i < 8; ++i) {
+                assert(res[i] == fast::cbrt(x[i]));
+            }
+            _mm256_store_ps(res, fast::atan2(_mm256_load_ps(x), _mm256_set1_ps(-1.0f)));
+            for (int i = 0; i < 8; ++i) {
+                assert(res[i] == fast::atan2(x[i], -1.0f));
+            }
+        }
+#endif
+    }
+
+    fmt::print("constexpr math:\n");
+    {
+        constexpr f64 sqrt2 = cx::sqrt(2.0);
+        constexpr f64 sin1 = cx::sin(1.0);
+        constexpr f64 e = cx::exp(1.0);
+        static_assert(cx::sqrt(16.0) == 4.0 && cx::floor(-1.5) == -2.0 && cx::abs(-3.0f) == 3.0f, "");
+        static_assert(cx::pow(2.0, 10.0) == 1024.0 && cx::log(1.0) == 0.0 && cx::exp(0.0) == 1.0, "");
+        assert(std::abs(sqrt2 - std::sqrt(2.0)) < 1e-15 && std::abs(sin1 - std::sin(1.0)) < 1e-15 && std::abs(e - std::exp(1.0)) < 1e-15);
+        assert(std::abs(cx::cos(-20.0) - std::cos(-20.0)) < 1e-15 && std::abs(cx::tan(0.5) - std::tan(0.5)) < 1e-15);
+        assert(std::abs(cx::atan2(-1.0, -3.0) - std::atan2(-1.0, -3.0)) < 1e-15 && std::abs(cx::log(1e-5) - std::log(1e-5)) < 1e-14);
+
+#ifdef MOOS_IS_CONSTANT_EVALUATED
+        // Projection, camera & color matrices can all be computed at compile time
+        constexpr mat4 projection = perspectiveProjectionToVulkanClipSpace(toRadians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        constexpr mat4 view = lookAt(vec3(1, 2, 3), vec3(0), globalUp);
+        constexpr mat4 viewProjection = projection * view;
+        constexpr mat4 inverseViewProjection = inverse(viewProjection);
+        constexpr quat rotation = axisAngle(globalY, toRadians(90.0f)) * axisAngle(globalX, toRadians(45.0f));
+        constexpr vec3 rotated = rotation * globalZ;
+        constexpr mat3 sRGBRoundTrip = colorspace::sRGB_from_XYZ * colorspace::XYZ_from_sRGB;
+        static_assert(sRGBRoundTrip.x.x > 0.999f && sRGBRoundTrip.x.x < 1.001f, "");
+
+        mat4 runtimeViewProjection = perspectiveProjectionToVulkanClipSpace(toRadians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) * lookAt(vec3(1, 2, 3), vec3(0), globalUp);
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                assert(std::abs(viewProjection[i][j] - runtimeViewProjection[i][j]) < 1e-5f);
+                assert(std::abs((inverseViewProjection * viewProjection)[i][j] - (i == j ? 1.0f : 0.0f)) < 1e-5f);
+            }
+        }
+        assert(distance(rotated, axisAngle(globalY, toRadians(90.0f)) * (axisAngle(globalX, toRadians(45.0f)) * globalZ)) < 1e-6f);
+        fmt::print(" compile-time rotated vector: ({}, {}, {})\n", rotated.x, rotated.y, rotated.z);
+#endif
+    }
+
     fmt::print("vec2:\n");
     {
         vec2 fv2 { 1, 1 };
@@ -66,6 +183,27 @@ int main()
         fmt::print(" SIMD vec4 dot product gives {}, correct is {}\n", d, 200.0f);
     }
 
+    fmt::print("vecN:\n");
+    {
+        vec4 a = 2.0f * vec4(1, 2, 3, 4) / vec4(2.0f) + vec4(1.0f);
+        assert(length2(a) == 4.0f + 9.0f + 16.0f + 25.0f && a * vec4(2.0f) == vec4(4, 6, 8, 10));
+        vec2 b = vec2(1, 2) * vec2(3, 4);
+        assert(b == vec2(3, 8));
+
+        constexpr fvec8 features = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        static_assert(sum(features) == 36.0f, "");
+        static_assert(alignof(fvec8) == 32 && alignof(fvec16) == 64, "");
+        fvec8 weights { 0.5f };
+        weights *= 2.0f;
+        assert(dot(features, weights) == 36.0f && max(features, weights)[0] == 1.0f);
+        tvecN<3, Float> c { globalUp };
+        c += vecN<3>(1.0f);
+        assert(c.vec() == vec3(1, 2, 1) && c == vecN<3>(1, 2, 1));
+        vec16 d = normalize(vec16(3.0f));
+        assert(std::abs(length(d) - 1.0f) < 1e-6f && d[15] == 0.25f);
+        fmt::print(" check generic vector operations ...\n");
+    }
+
     fmt::print("mat3:\n");
     {
         mat3 a = { { 1, 3, 2 },
@@ -93,6 +231,54 @@ int main()
         fmt::print(" check transpose ...\n");
     }
 
+    fmt::print("matNM:\n");
+    {
+        mat4 a4 = { { 1, 3, 2, 2 },
+                    { 2, 2, 1, 1 },
+                    { 3, 1, 3, 2 },
+                    { 4, 4, 4, 4 } };
+        matNM<4, 4> a { a4 };
+        matNM<4, 4> aInv { inverse(a4) };
+        matNM<4, 4> identity = a * inverse(a);
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                assert(std::abs(identity(i, j) - (i == j ? 1.0f : 0.0f)) < 1e-5f);
+                assert(std::abs(inverse(a)(i, j) - aInv(i, j)) < 1e-5f);
+            }
+        }
+
+        matNM<3, 4> b { 2.0f };
+        matNM<4, 3> bT = transpose(b);
+        matNM<3, 3> bbT = b * bT;
+        assert(bbT == decltype(bbT)(4.0f) && bT(2, 2) == 2.0f && bT(3, 2) == 0.0f);
+        matNM<2, 3> defaulted = {};
+        assert(defaulted(1, 1) == 1.0f && defaulted(1, 2) == 0.0f && defaulted.data()[3] == 1.0f);
+
+        // A 6x6 inertia-like symmetric positive definite system, solved with both decompositions
+        mat6 inertia { 0.0f };
+        for (size_t j = 0; j < 6; ++j) {
+            for (size_t i = 0; i < 6; ++i) {
+                inertia(i, j) = (i == j) ? 4.0f : 1.0f / static_cast<Float>(1 + i + j);
+            }
+        }
+        vecN<6> x { 1, -2, 3, -4, 5, -6 };
+        vecN<6> rhs = inertia * x;
+        tCholeskyDecomposition<6, Float> cholesky = choleskyDecompose(inertia);
+        assert(cholesky.valid);
+        assert(distance(cholesky.solve(rhs), x) < 1e-5f);
+        assert(distance(solve(inertia, rhs), x) < 1e-5f);
+        assert(!choleskyDecompose(inertia * -1.0f).valid && !luDecompose(mat6(0.0f)).valid);
+
+        // Runtime-sized systems use the in-place solvers directly
+        f64 system[3 * 3] = { 2, 1, 0, 1, 3, 1, 0, 1, 4 };
+        f64 values[3] = { 3, 5, 5 };
+        size_t pivots[3];
+        bool nonSingular = luDecomposeInPlace(system, 3, pivots);
+        luSolveInPlace(system, 3, pivots, values);
+        assert(nonSingular && std::abs(values[0] - 1.0) < 1e-12 && std::abs(values[1] - 1.0) < 1e-12 && std::abs(values[2] - 1.0) < 1e-12);
+        fmt::print(" check NxM multiply, transpose and solves ...\n");
+    }
+
     fmt::print("quat:\n");
     {
         quat q = axisAngle(globalUp, HALF_PI);
@@ -100,6 +286,363 @@ int main()
         assert(diff1 < 1e-6f);
         float diff2 = distance(rotateVector(q, globalRight), globalForward);
         assert(diff2 < 1e-6f);
+
+        fquat a = normalize(fquat({ 0.1f, 0.2f, 0.3f }, 0.9f));
+        fquat b = normalize(fquat({ -0.5f, 0.4f, 0.1f }, 0.3f));
+        dquat ad = { { a.vec.x, a.vec.y, a.vec.z }, a.w };
+        dquat bd = { { b.vec.x, b.vec.y, b.vec.z }, b.w };
+        fquat ab = a * b;
+        dquat abd = ad * bd;
+        assert(std::abs(ab.vec.x - abd.vec.x) + std::abs(ab.vec.y - abd.vec.y) + std::abs(ab.vec.z - abd.vec.z) + std::abs(ab.w - abd.w) < 1e-5);
+        fquat identity = a * inverse(a);
+        assert(length(identity.vec) < 1e-6f && std::abs(identity.w - 1.0f) < 1e-6f);
+        assert(distance(conjugate(a) * (a * globalUp), globalUp) < 1e-6f);
+        fmt::print(" SIMD quat product gives ({}, {}, {}, {}), correct is ({}, {}, {}, {})\n", ab.vec.x, ab.vec.y, ab.vec.z, ab.w, abd.vec.x, abd.vec.y, abd.vec.z, abd.w);
+    }
+
+    fmt::print("euler angles:\n");
+    {
+        vec3 euler = vec3(0.3f, -1.1f, 2.5f);
+        quat q = quatFromEulerAngles(euler);
+        quat expected = axisAngle(globalZ, euler.z) * axisAngle(globalY, euler.y) * axisAngle(globalX, euler.x);
+        assert(std::abs(dot(q, expected)) > 1.0f - 1e-6f);
+        assert(distance(quatToEulerAngles(q), euler) < 1e-5f);
+
+        constexpr size_t count = 7;
+        vec3 eulers[count], axes[count], roundTrip[count];
+        f32 angles[count];
+        quat quats[count], axisAngleQuats[count];
+        for (size_t i = 0; i < count; ++i) {
+            eulers[i] = vec3(0.4f * i - 1.0f, 0.2f * i - 0.6f, -0.5f * i + 0.3f);
+            axes[i] = normalize(vec3(1.0f, f32(i), -2.0f));
+            angles[i] = 1.5f * i - 3.0f;
+        }
+        quatFromEulerAnglesBatch(eulers, quats, count);
+        quatToEulerAnglesBatch(quats, roundTrip, count);
+        axisAngleBatch(axes, angles, axisAngleQuats, count);
+        for (size_t i = 0; i < count; ++i) {
+            assert(std::abs(dot(quats[i], quatFromEulerAngles(eulers[i]))) > 1.0f - 1e-6f);
+            assert(distance(roundTrip[i], eulers[i]) < 1e-5f);
+            assert(std::abs(dot(axisAngleQuats[i], axisAngle(axes[i], angles[i]))) > 1.0f - 1e-6f);
+        }
+#ifdef MOOS_SSE
+        // Out of range angles give NaN instead of garbage
+        f32 hugeAngles[4] = { 1e8f, -std::numeric_limits<f32>::infinity(), std::numeric_limits<f32>::quiet_NaN(), 1.0f };
+        axisAngleBatch(axes, hugeAngles, axisAngleQuats, 4);
+        assert(std::isnan(axisAngleQuats[0].w) && std::isnan(axisAngleQuats[1].w) && std::isnan(axisAngleQuats[2].w));
+        assert(std::abs(dot(axisAngleQuats[3], axisAngle(axes[3], 1.0f))) > 1.0f - 1e-6f);
+#endif
+        fmt::print(" euler angles round trip gives ({}, {}, {})\n", roundTrip[2].x, roundTrip[2].y, roundTrip[2].z);
+    }
+
+    fmt::print("quat batch conversion:\n");
+    {
+        constexpr size_t count = 6;
+        quat rotations[count];
+        vec3 translations[count], scales[count];
+        for (size_t i = 0; i < count; ++i) {
+            rotations[i] = axisAngle(normalize(vec3(1.0f, f32(i), 2.0f)), 0.5f * i);
+            translations[i] = vec3(f32(i), 1.0f, -2.0f);
+            scales[i] = vec3(1.0f, 2.0f, 0.5f + i);
+        }
+
+        mat4 matrices[count];
+        mat3x4 palette[count];
+        quatToMatrixBatch(rotations, translations, scales, matrices, count);
+        quatToMatrixBatch(rotations, translations, scales, palette, count);
+
+        quat decomposedRotations[count];
+        vec3 decomposedTranslations[count], decomposedScales[count];
+        quatFromMatrixBatch(matrices, decomposedRotations, decomposedTranslations, decomposedScales, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            mat4 expected = translate(translations[i]) * rotate(rotations[i]) * scale(scales[i]);
+            assert(distance(matrices[i].w.xyz(), expected.w.xyz()) < 1e-5f && distance(matrices[i].x.xyz(), expected.x.xyz()) < 1e-5f);
+            assert(std::abs(palette[i].x.w - translations[i].x) < 1e-5f && std::abs(palette[i].y.x - expected.x.y) < 1e-5f);
+            assert(std::abs(dot(decomposedRotations[i], rotations[i])) > 1.0f - 1e-6f);
+            assert(distance(decomposedTranslations[i], translations[i]) < 1e-5f);
+            assert(distance(decomposedScales[i], scales[i]) < 1e-5f);
+        }
+    }
+
+    fmt::print("look rotation:\n");
+    {
+        vec3 forward = normalize(vec3(1, 0.5f, -2));
+        quat q = lookRotation(forward, globalUp);
+        vec3 rotated = q * globalForward;
+        fmt::print(" lookRotation rotates globalForward to ({}, {}, {}), correct is ({}, {}, {})\n", rotated.x, rotated.y, rotated.z, forward.x, forward.y, forward.z);
+        assert(length(q * globalForward - forward) < 1e-5f);
+        assert(dot(q * globalRight, globalUp) < 1e-6f);
+
+        // The default up vector also works for f64
+        dvec3 forwardD = dvec3(forward.x, forward.y, forward.z);
+        dquat qd = lookRotation(forwardD);
+        assert(std::abs(qd.w - f64(q.w)) < 1e-6 && std::abs(qd.vec.y - f64(q.vec.y)) < 1e-6);
+        dmat4 viewD = lookAt(dvec3(0.0), forwardD);
+        dmat4 viewInverseD = lookAtInverse(dvec3(0.0), forwardD);
+        assert(std::abs(viewD.z.z + forwardD.z) < 1e-6 && std::abs(viewInverseD.z.x + forwardD.x) < 1e-6);
+
+        quat between = rotationBetween(globalX, vec3(0, 2, 0));
+        assert(length(between * globalX - globalY) < 1e-6f);
+        assert(length(rotationBetween(globalZ, -globalZ) * globalZ + globalZ) < 1e-6f);
+
+        constexpr size_t count = 6;
+        vec3 forwards[count], targets[count];
+        quat looks[count], arcs[count];
+        for (size_t i = 0; i < count; ++i) {
+            forwards[i] = vec3(std::cos(0.7f * i), 0.3f * i - 1.0f, std::sin(0.7f * i));
+            targets[i] = (i == 3) ? -forwards[i] : globalUp;
+        }
+        lookRotationBatch(forwards, static_cast<const vec3*>(nullptr), looks, count);
+        rotationBetweenBatch(forwards, targets, arcs, count);
+        for (size_t i = 0; i < count; ++i) {
+            assert(std::abs(dot(looks[i], lookRotation(forwards[i]))) > 1.0f - 1e-6f);
+            assert(length(arcs[i] * normalize(forwards[i]) - normalize(targets[i])) < 1e-5f);
+        }
+    }
+
+    fmt::print("quat integration:\n");
+    {
+        quat q = axisAngle(normalize(vec3(1, 2, 3)), 0.4f);
+        assert(std::abs(dot(exp(log(q)), q)) > 1.0f - 1e-6f);
+
+        // Near w = 0 with a tiny vector part the angle is still pi / 2, and small angles & negative reals don't blow up
+        quat tinyHalfTurn = log(quat({ 0.0f, 2e-8f, 0.0f }, 0.0f));
+        assert(std::abs(tinyHalfTurn.vec.y - HALF_PI) < 1e-6f && std::abs(tinyHalfTurn.w - std::log(2e-8f)) < 1e-5f);
+        assert(std::abs(log(quat({ 1e-8f, 0.0f, 0.0f }, 1e-9f)).vec.x - std::atan2(1e-8f, 1e-9f)) < 1e-6f);
+        quat smallAngle = axisAngle(globalX, 1e-4f);
+        assert(std::abs(log(smallAngle).vec.x - 0.5e-4f) < 1e-10f && length(log(quat({ 0, 0, 0 }, -2.0f)).vec) == 0.0f);
+
+        vec3 angularVelocity = vec3(0.0f, 2.0f, 0.0f);
+        quat exact = integrate(q, angularVelocity, 0.25f);
+        assert(std::abs(dot(exact, axisAngle(globalY, 0.5f) * q)) > 1.0f - 1e-6f);
+        quat approx = integrateFast(q, angularVelocity, 0.01f);
+        assert(std::abs(dot(approx, integrate(q, angularVelocity, 0.01f))) > 1.0f - 1e-6f);
+
+        constexpr size_t count = 9;
+        quat orientations[count], orientationsFast[count];
+        vec3 angularVelocities[count];
+        for (size_t i = 0; i < count; ++i) {
+            orientations[i] = orientationsFast[i] = axisAngle(globalX, 0.1f * i);
+            angularVelocities[i] = vec3(0.5f * i, 0.0f, (i % 2) ? 0.0f : -1.0f);
+        }
+        integrateBatch(orientations, angularVelocities, 0.1f, count);
+        integrateFastBatch(orientationsFast, angularVelocities, 0.1f, count);
+        for (size_t i = 0; i < count; ++i) {
+            quat expected = integrate(axisAngle(globalX, 0.1f * i), angularVelocities[i], 0.1f);
+            assert(std::abs(dot(orientations[i], expected)) > 1.0f - 1e-6f);
+            assert(std::abs(dot(orientationsFast[i], expected)) > 0.999f);
+        }
+    }
+
+    fmt::print("quat interpolation:\n");
+    {
+        quat a = axisAngle(globalUp, 0.2f);
+        quat b = axisAngle(normalize(vec3(1, 1, 0)), 2.5f);
+        quat s = slerp(a, b, 0.25f);
+        quat n = nlerp(a, b, 0.25f);
+        quat f = slerpFast(a, b, 0.25f);
+        assert(std::abs(dot(s, f)) > 1.0f - 1e-5f);
+        assert(std::abs(dot(s, n)) > 0.99f);
+        assert(std::abs(dot(slerp(a, b, 1.0f), b)) > 1.0f - 1e-6f);
+        fmt::print(" slerp gives ({}, {}, {}, {}), fast slerp gives ({}, {}, {}, {})\n", s.vec.x, s.vec.y, s.vec.z, s.w, f.vec.x, f.vec.y, f.vec.z, f.w);
+
+        constexpr size_t count = 11;
+        quat as[count], bs[count], results[count];
+        for (size_t i = 0; i < count; ++i) {
+            as[i] = axisAngle(globalX, 0.3f * i);
+            bs[i] = axisAngle(globalZ, -0.2f * i);
+        }
+        slerpFastBatch(as, bs, 0.7f, results, count);
+        for (size_t i = 0; i < count; ++i) {
+            assert(std::abs(dot(results[i], slerp(as[i], bs[i], 0.7f))) > 1.0f - 1e-5f);
+        }
+        nlerpBatch(as, bs, 0.7f, results, count);
+        for (size_t i = 0; i < count; ++i) {
+            assert(std::abs(dot(results[i], nlerp(as[i], bs[i], 0.7f))) > 1.0f - 1e-6f);
+        }
+        slerpBatch(as, bs, 0.7f, results, count);
+        for (size_t i = 0; i < count; ++i) {
+            quat expected = slerp(as[i], bs[i], 0.7f);
+            assert(distance(results[i].vec, expected.vec) < 1e-6f && std::abs(results[i].w - expected.w) < 1e-6f);
+        }
+
+        // 8-lane packets (with AVX2 if enabled), and packets with a lane count that isn't a power of two
+        quatPacket<8> pa, pb;
+        loadPacket(pa, as);
+        loadPacket(pb, bs);
+        storePacket(pa * pb, results);
+        for (size_t i = 0; i < 8; ++i) {
+            assert(std::abs(dot(results[i], as[i] * bs[i])) > 1.0f - 1e-6f);
+        }
+        storePacket(slerp(pa, pb, 0.3f), results);
+        assert(std::abs(dot(results[7], slerp(as[7], bs[7], 0.3f))) > 1.0f - 1e-6f);
+        quatPacket<3> p3;
+        loadPacket(p3, as);
+        storePacket(nlerp(p3, p3, 0.5f), results);
+        assert(std::abs(dot(results[2], as[2])) > 1.0f - 1e-6f && alignof(quatPacket<3>) == alignof(Float));
+    }
+
+    fmt::print("quat compression:\n");
+    {
+        constexpr size_t count = 7;
+        quat quats[count];
+        for (size_t i = 0; i < count; ++i) {
+            quats[i] = normalize(quat({ std::sin(1.3f * i), 0.5f - 0.2f * i, std::cos(0.7f * i) }, 0.9f - 0.3f * i));
+        }
+
+        QuatSmallestThree29 st29[count];
+        QuatSmallestThree32 st32[count];
+        QuatSmallestThree48 st48[count];
+        QuatOctahedral32 oct32[count];
+        QuatComponents64 c64[count];
+        compressQuatBatch(quats, st29, count);
+        compressQuatBatch(quats, st32, count);
+        compressQuatBatch(quats, st48, count);
+        compressQuatBatch(quats, oct32, count);
+        compressQuatBatch(quats, c64, count);
+
+        quat decoded[5][count];
+        decompressQuatBatch(st29, decoded[0], count);
+        decompressQuatBatch(st32, decoded[1], count);
+        decompressQuatBatch(st48, decoded[2], count);
+        decompressQuatBatch(oct32, decoded[3], count);
+        decompressQuatBatch(c64, decoded[4], count);
+
+        for (size_t i = 0; i < count; ++i) {
+            // (batch decoding is bit-exact with the scalar versions)
+            quat scalar[5] = { decompressQuat(st29[i]), decompressQuat(st32[i]), decompressQuat(st48[i]), decompressQuat(oct32[i]), decompressQuat(c64[i]) };
+            f32 tolerances[5] = { 1e-4f, 3e-5f, 1e-6f, 3e-5f, 1e-6f };
+            for (int format = 0; format < 5; ++format) {
+                assert(std::memcmp(&scalar[format], &decoded[format][i], sizeof(quat)) == 0);
+                assert(std::abs(dot(scalar[format], quats[i])) > 1.0f - tolerances[format]);
+            }
+        }
+
+        // -32768 is never written, but decoding it (e.g. from corrupt data) is defined and the same as -32767
+        QuatComponents64 extreme = { { -32768, -32768, -32768, -32768 } };
+        quat extremeBatch;
+        decompressQuatBatch(&extreme, &extremeBatch, 1);
+        quat extremeScalar = decompressQuat(extreme);
+        assert(std::memcmp(&extremeScalar, &extremeBatch, sizeof(quat)) == 0 && std::abs(extremeScalar.w + 0.5f) < 1e-6f);
+        fmt::print(" 29-bit smallest three of ({}, {}, {}, {}) gives ({}, {}, {}, {})\n", quats[1].vec.x, quats[1].vec.y, quats[1].vec.z, quats[1].w,
+                   decoded[0][1].vec.x, decoded[0][1].vec.y, decoded[0][1].vec.z, decoded[0][1].w);
+    }
+
+    fmt::print("animation:\n");
+    {
+        quat q = normalize(quat({ -0.3f, 0.5f, 0.1f }, -0.8f));
+        quat qc = decompressQuat(compressQuat(q));
+        assert(std::abs(dot(q, qc)) > 1.0f - 1e-6f);
+
+        constexpr size_t keyCount = 5;
+        constexpr size_t jointCount = 7;
+        f32 times[keyCount] = { 0.0f, 0.5f, 0.6f, 1.2f, 2.0f };
+        fquat rotations[jointCount][keyCount];
+        fvec3 translations[jointCount][keyCount];
+
+        AnimationClip clip;
+        for (size_t joint = 0; joint < jointCount; ++joint) {
+            for (size_t key = 0; key < keyCount; ++key) {
+                rotations[joint][key] = axisAngle(normalize(vec3(1.0f, f32(joint), f32(key))), 0.4f * (joint + key));
+                translations[joint][key] = vec3(f32(key), f32(joint), -2.0f * key);
+            }
+            clip.addJointTrack(times, rotations[joint], translations[joint], keyCount);
+        }
+
+        AnimationCursor cursor;
+        fquat sampledRotations[jointCount];
+        fvec3 sampledTranslations[jointCount];
+        for (f32 time : { 0.0f, 0.25f, 0.55f, 0.7f, 1.9f, 0.3f, 5.0f }) {
+            clip.sample(time, cursor, sampledRotations, sampledTranslations);
+
+            size_t key = 0;
+            while (key + 1 < keyCount && times[key + 1] <= time)
+                key += 1;
+            size_t nextKey = std::min(key + 1, keyCount - 1);
+            f32 t = (nextKey == key) ? 0.0f : clamp((time - times[key]) / (times[nextKey] - times[key]), 0.0f, 1.0f);
+
+            for (size_t joint = 0; joint < jointCount; ++joint) {
+                quat expectedRotation = nlerp(rotations[joint][key], rotations[joint][nextKey], t);
+                vec3 expectedTranslation = lerp(translations[joint][key], translations[joint][nextKey], t);
+                assert(std::abs(dot(sampledRotations[joint], expectedRotation)) > 1.0f - 1e-6f);
+                assert(distance(sampledTranslations[joint], expectedTranslation) < 1e-3f);
+            }
+        }
+        fmt::print(" compressed clip with {} joints & {} keys sampled correctly\n", jointCount, keyCount);
+    }
+
+    fmt::print("dual quat:\n");
+    {
+        quat ra = axisAngle(globalUp, 0.7f);
+        quat rb = axisAngle(normalize(vec3(1, 0, 1)), -1.3f);
+        dualquat a = dualQuatFromRotationTranslation(ra, vec3(1, 2, 3));
+        dualquat b = dualQuatFromMatrix(translate(vec3(-4, 0, 2)) * rotate(rb));
+
+        vec3 p = vec3(0.5f, -1.0f, 2.0f);
+        vec3 expected = a.real * (b.real * p + vec3(-4, 0, 2)) + vec3(1, 2, 3);
+        assert(distance(transformPoint(a * b, p), expected) < 1e-5f);
+        assert(distance(transformPoint(inverse(a), transformPoint(a, p)), p) < 1e-5f);
+
+        vec4 pm = dualQuatToMatrix(a * b) * vec4(p, 1.0f);
+        assert(distance(pm.xyz(), expected) < 1e-5f);
+
+        dualquat bones[2] = { a, b };
+        vec3 positions[2] = { p, p };
+        u16 indices[4] = { 0, 1, 1, 0 };
+        f32 weights[4] = { 1.0f, 0.0f, 0.5f, 0.5f };
+        vec3 skinned[2];
+        skinDualQuatBatch(bones, indices, weights, 2, positions, static_cast<const vec3*>(nullptr), 2, skinned, static_cast<vec3*>(nullptr));
+        assert(distance(skinned[0], transformPoint(a, p)) < 1e-5f);
+        fmt::print(" blended skinned position ({}, {}, {})\n", skinned[1].x, skinned[1].y, skinned[1].z);
+
+        // Two bones with the same rotation (90 degrees around z) but different translations blend to that rotation and
+        // the weighted translation: 0.25 * (4, 0, 0) + 0.75 * (0, 8, 0) = (1, 6, 0), and (1, 0, 0) rotates to (0, 1, 0)
+        quat quarterTurn = axisAngle(globalZ, HALF_PI);
+        dualquat blendBones[2] = { dualQuatFromRotationTranslation(quarterTurn, vec3(4, 0, 0)),
+                                   dualQuatFromRotationTranslation(quarterTurn, vec3(0, 8, 0)) };
+        vec3 vertex = vec3(1, 0, 0);
+        u16 blendIndices[2] = { 0, 1 };
+        f32 blendWeights[2] = { 0.25f, 0.75f };
+        vec3 blended;
+        skinDualQuatBatch(blendBones, blendIndices, blendWeights, 2, &vertex, static_cast<const vec3*>(nullptr), 1, &blended, static_cast<vec3*>(nullptr));
+        assert(distance(blended, vec3(1, 7, 0)) < 1e-5f);
+
+        // Rotations of 0 and 90 degrees around z blend to 2 * atan(0.75 sin(45) / (0.25 + 0.75 cos(45))) = 68.40 degrees
+        blendBones[0] = dualQuatFromRotationTranslation(quat(), vec3(0));
+        blendBones[1] = dualQuatFromRotationTranslation(quarterTurn, vec3(0));
+        skinDualQuatBatch(blendBones, blendIndices, blendWeights, 2, &vertex, static_cast<const vec3*>(nullptr), 1, &blended, static_cast<vec3*>(nullptr));
+        f32 blendedAngle = 2.0f * std::atan(0.75f * std::sin(HALF_PI / 2.0f) / (0.25f + 0.75f * std::cos(HALF_PI / 2.0f)));
+        assert(std::abs(toDegrees(blendedAngle) - 68.40f) < 0.01f);
+        assert(distance(blended, vec3(std::cos(blendedAngle), std::sin(blendedAngle), 0)) < 1e-5f);
+
+        // Many vertices (skinned four at a time with SSE) match skinning them one at a time, including bones in the
+        // opposite hemisphere
+        constexpr size_t vertexCount = 11;
+        constexpr int influenceCount = 3;
+        dualquat manyBones[4];
+        for (int i = 0; i < 4; ++i) {
+            quat rotation = axisAngle(normalize(vec3(1.0f, f32(i), -1.0f)), 0.8f * i - 1.0f);
+            manyBones[i] = dualQuatFromRotationTranslation((i == 2) ? -rotation : rotation, vec3(f32(i), -2.0f, 0.5f * i));
+        }
+        vec3 manyPositions[vertexCount], manyNormals[vertexCount], skinnedPositions[vertexCount], skinnedNormals[vertexCount];
+        u16 manyIndices[vertexCount * influenceCount];
+        f32 manyWeights[vertexCount * influenceCount];
+        for (size_t v = 0; v < vertexCount; ++v) {
+            manyPositions[v] = vec3(0.3f * v, 1.0f - 0.2f * v, 2.0f);
+            manyNormals[v] = normalize(vec3(1.0f, f32(v), 0.5f));
+            for (int i = 0; i < influenceCount; ++i) {
+                manyIndices[v * influenceCount + i] = static_cast<u16>((v + i) % 4);
+                manyWeights[v * influenceCount + i] = (i == 0) ? 0.5f : 0.25f;
+            }
+        }
+        skinDualQuatBatch(manyBones, manyIndices, manyWeights, influenceCount, manyPositions, manyNormals, vertexCount, skinnedPositions, skinnedNormals);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            vec3 position, normal;
+            skinDualQuatBatch(manyBones, manyIndices + v * influenceCount, manyWeights + v * influenceCount, influenceCount,
+                              manyPositions + v, manyNormals + v, 1, &position, &normal);
+            assert(distance(skinnedPositions[v], position) < 1e-5f && distance(skinnedNormals[v], normal) < 1e-5f);
+        }
     }
 
     fmt::print("transformations:\n");
@@ -128,6 +671,332 @@ int main()
         extractWorldFrustumPlanesFromViewProjection(proj1 * cam, frustumPlanes);
     }
 
+    fmt::print("projections & cameras:\n");
+    {
+        auto maxDifference = [](const mat4& a, const mat4& b) {
+            f32 difference = 0.0f;
+            for (int col = 0; col < 4; ++col) {
+                for (int row = 0; row < 4; ++row) {
+                    difference = std::max(difference, std::abs(a[col][row] - b[col][row]));
+                }
+            }
+            return difference;
+        };
+
+        mat4 reverseZ = perspectiveProjectionToVulkanClipSpaceReverseZ(toRadians(60), 1.5f, 0.1f, 100.0f);
+        vec4 nearPoint = reverseZ * vec4(0, 0, -0.1f, 1);
+        vec4 farPoint = reverseZ * vec4(0, 0, -100.0f, 1);
+        fmt::print(" reverse-Z depth at near = {}, at far = {}\n", nearPoint.z / nearPoint.w, farPoint.z / farPoint.w);
+        assert(std::abs(nearPoint.z / nearPoint.w - 1.0f) < 1e-6f && std::abs(farPoint.z / farPoint.w) < 1e-6f);
+
+        mat4 projections[] = {
+            perspectiveProjectionToVulkanClipSpace(toRadians(60), 1.5f, 0.1f, 100.0f),
+            perspectiveProjectionToOpenGLClipSpace(toRadians(60), 1.5f, 0.1f, 100.0f),
+            reverseZ,
+            perspectiveProjectionToVulkanClipSpaceInfiniteFar(toRadians(60), 1.5f, 0.1f),
+            perspectiveProjectionToVulkanClipSpaceReverseZInfiniteFar(toRadians(60), 1.5f, 0.1f),
+            perspectiveProjectionToOpenGLClipSpaceInfiniteFar(toRadians(60), 1.5f, 0.1f)
+        };
+        for (const mat4& projection : projections) {
+            assert(maxDifference(inversePerspectiveProjection(projection), inverse(projection)) < 1e-5f);
+        }
+        mat4 ortho = orthographicProjectionToVulkanClipSpace(10.0f, 0.1f, 50.0f);
+        assert(maxDifference(inverseOrthographicProjection(ortho), inverse(ortho)) < 1e-5f);
+
+        camera cam;
+        cam.lookAt(vec3(1, 2, 3), vec3(0, 0, 0));
+        cam.setPerspectiveProjection(projections[4]);
+        assert(length(cam.position() - vec3(1, 2, 3)) < 1e-5f);
+        assert(maxDifference(cam.inverseViewProjection(), inverse(cam.viewProjection())) < 1e-4f);
+        cam.setOrthographicProjection(ortho);
+        assert(maxDifference(cam.inverseViewProjection() * cam.viewProjection(), mat4(1.0f)) < 1e-5f);
+
+        vec3 eyes[6], targets[6], ups[6];
+        for (int i = 0; i < 6; ++i) {
+            eyes[i] = vec3(1.0f + i, 2.0f - i, 0.5f * i);
+            targets[i] = eyes[i] + vec3(i % 3 == 0 ? 1.0f : -2.0f, 0.3f * i - 1.0f, i % 2 == 0 ? 3.0f : -1.0f);
+            ups[i] = normalize(vec3(0.1f * i, 1.0f, -0.2f));
+        }
+        mat4 views[6], inverseViews[6];
+        lookAtBatch(eyes, targets, ups, views, 6);
+        lookAtInverseBatch(eyes, targets, static_cast<const vec3*>(nullptr), inverseViews, 6);
+        for (int i = 0; i < 6; ++i) {
+            mat4 view = lookAt(eyes[i], targets[i], ups[i]);
+            assert(maxDifference(views[i], view) < 1e-5f);
+            assert(maxDifference(inverse(view), lookAtInverse(eyes[i], targets[i], ups[i])) < 1e-4f);
+            assert(maxDifference(inverseViews[i] * lookAt(eyes[i], targets[i]), mat4(1.0f)) < 1e-5f);
+        }
+        fmt::print(" batched look at matches scalar version\n");
+    }
+
+    fmt::print("frustum culling:\n");
+    {
+        mat4 view = lookAt(vec3(1, 2, 3), vec3(5, 1, -2));
+        mat4 viewProjection = perspectiveProjectionToVulkanClipSpace(toRadians(70), 1.3f, 0.5f, 50.0f) * view;
+        frustum cameraFrustum(viewProjection);
+
+        plane3 plane = normalize(plane3(vec4(0, 2, 0, -4)));
+        assert(std::abs(plane.signedDistance(vec3(7, 5, -1)) - 3.0f) < 1e-6f);
+        assert(std::abs(planeFromPointAndNormal(vec3(1, 2, 3), globalUp).signedDistance(vec3(0)) + 2.0f) < 1e-6f);
+
+        vec3 target = vec3(5, 1, -2);
+        vec3 behind = vec3(1, 2, 3) - (target - vec3(1, 2, 3));
+        assert(cameraFrustum.contains(target) && !cameraFrustum.contains(behind));
+        assert(cameraFrustum.classify(target, 0.5f) == Containment::Inside);
+        assert(cameraFrustum.classify(target, 100.0f) == Containment::Intersecting);
+        assert(cameraFrustum.classify(behind, 0.5f) == Containment::Outside);
+
+        // A sphere with radius > 1 fully inside, which the padding planes of the SIMD path must not make intersecting
+        vec3 center = vec3(1, 2, 3) + 10.0f * normalize(target - vec3(1, 2, 3));
+        for (int i = 0; i < frustum::PlaneCount; ++i) {
+            assert(cameraFrustum.plane(i).signedDistance(center) > 2.0f);
+        }
+        assert(cameraFrustum.classify(center, 2.0f) == Containment::Inside);
+        assert(cameraFrustum.classify(aabb3(target - vec3(0.5f), target + vec3(0.5f))) == Containment::Inside);
+        assert(cameraFrustum.classify(aabb3(behind - vec3(0.5f), behind + vec3(0.5f))) == Containment::Outside);
+        assert(cameraFrustum.classify(aabb3(behind - vec3(5.0f), target)) == Containment::Intersecting);
+
+        frustum narrowFrustum(perspectiveProjectionToVulkanClipSpace(toRadians(30), 1.3f, 1.0f, 20.0f) * view);
+        assert(cameraFrustum.classify(narrowFrustum) == Containment::Inside);
+        assert(narrowFrustum.classify(cameraFrustum) == Containment::Intersecting);
+
+        vec4 ndc = inverse(viewProjection) * vec4(1, 1, 1, 1);
+        fmt::print(" far top right corner ({}, {}, {}), correct is ({}, {}, {})\n", cameraFrustum.corners[7].x, cameraFrustum.corners[7].y, cameraFrustum.corners[7].z,
+                   ndc.x / ndc.w, ndc.y / ndc.w, ndc.z / ndc.w);
+    }
+
+    fmt::print("occlusion culling:\n");
+    {
+        mat4 viewProjection = perspectiveProjectionToVulkanClipSpace(toRadians(60), 2.0f, 0.1f, 100.0f) * lookAt(vec3(0, 1, 5), vec3(0, 1, 0));
+
+        // A wall in front of the camera and a ground plane which crosses the near plane
+        vec3 wall[4] = { vec3(-2, -1, 0), vec3(2, -1, 0), vec3(2, 3, 0), vec3(-2, 3, 0) };
+        vec3 ground[4] = { vec3(-100, -1, 100), vec3(100, -1, 100), vec3(100, -1, -100), vec3(-100, -1, -100) };
+        u32 indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+        OcclusionBuffer occlusionBuffer(256, 128);
+        occlusionBuffer.addOccluders(wall, indices, 2, viewProjection);
+        occlusionBuffer.addOccluders(ground, indices, 2, viewProjection);
+        for (int tile = 0; tile < occlusionBuffer.tileCount(); ++tile) {
+            occlusionBuffer.rasterizeTile(tile);
+        }
+
+        assert(!occlusionBuffer.isVisible(aabb3(vec3(-0.5f, 0, -3), vec3(0.5f, 1, -2)), viewProjection));
+        assert(occlusionBuffer.isVisible(aabb3(vec3(-0.5f, 0, 1), vec3(0.5f, 1, 2)), viewProjection));
+        assert(occlusionBuffer.isVisible(aabb3(vec3(5, 0, -3), vec3(6, 1, -2)), viewProjection));
+        assert(occlusionBuffer.isVisible(aabb3(vec3(-0.5f, 0, -3), vec3(0.5f, 6, -2)), viewProjection));
+        assert(!occlusionBuffer.isVisible(aabb3(vec3(3, -3, -5), vec3(4, -2, -4)), viewProjection));
+        fmt::print(" depth at center {}, at bottom {}\n", occlusionBuffer.depthAt(128, 64), occlusionBuffer.depthAt(128, 127));
+    }
+
+    fmt::print("shadow cascades:\n");
+    {
+        ShadowCascadeSetup setup;
+        setup.cameraView = lookAt(vec3(3, 2, 1), vec3(10, 0, -5));
+        setup.fovy = toRadians(60);
+        setup.aspectRatio = 16.0f / 9.0f;
+        setup.zNear = 0.1f;
+        setup.zFar = 200.0f;
+        setup.lightDirection = vec3(0.3f, -1.0f, 0.2f);
+        setup.cascadeCount = 4;
+        setup.splitLambda = 0.8f;
+        setup.shadowMapResolution = 2048;
+        setup.casterMargin = 50.0f;
+        setup.depthMode = OrthographicProjectionDepthMode::ZeroToOne;
+
+        ShadowCascade cascades[4];
+        computeShadowCascades(setup, cascades);
+        assert(std::abs(cascades[0].nearDistance - setup.zNear) < 1e-6f && std::abs(cascades[3].farDistance - setup.zFar) < 1e-3f);
+
+        for (const ShadowCascade& cascade : cascades) {
+            fmt::print(" cascade {}-{} with radius {}\n", cascade.nearDistance, cascade.farDistance, cascade.sphereRadius);
+            for (const vec3& corner : cascade.corners) {
+                assert(cascade.bounds.contains(corner));
+                assert(length(corner - cascade.sphereCenter) <= cascade.sphereRadius * 1.0001f);
+                vec4 lightClip = cascade.lightViewProjection * vec4(corner, 1.0f);
+                assert(std::abs(lightClip.x) <= 1.0f && std::abs(lightClip.y) <= 1.0f);
+                assert(lightClip.z >= 0.0f && lightClip.z <= 1.0f);
+            }
+        }
+
+        // Snapping moves the cascades by up to a texel, which must not push the slice corners out of the projections, for
+        // camera positions that aren't texel aligned
+        for (int i = 0; i < 64; ++i) {
+            vec3 eye = vec3(3.137f, 2.071f, 1.593f) + vec3(0.0371f, 0.0113f, -0.0291f) * static_cast<Float>(i);
+            setup.cameraView = lookAt(eye, eye + vec3(7.0f, -2.0f, -6.0f));
+            computeShadowCascades(setup, cascades);
+            for (const ShadowCascade& cascade : cascades) {
+                for (const vec3& corner : cascade.corners) {
+                    vec4 lightClip = cascade.lightViewProjection * vec4(corner, 1.0f);
+                    assert(std::abs(lightClip.x) <= 1.0f && std::abs(lightClip.y) <= 1.0f);
+                }
+                // (also the whole bounding sphere, which the corners can touch for any camera rotation)
+                vec4 centerClip = cascade.lightViewProjection * vec4(cascade.sphereCenter, 1.0f);
+                assert(std::abs(centerClip.x) + cascade.sphereRadius * std::abs(cascade.lightProjection.x.x) <= 1.0f);
+                assert(std::abs(centerClip.y) + cascade.sphereRadius * std::abs(cascade.lightProjection.y.y) <= 1.0f);
+            }
+        }
+    }
+
+    fmt::print("TRS transforms:\n");
+    {
+        transform parent = transform(vec3(1, 2, 3), axisAngle(globalUp, 0.5f), 2.0f);
+        transform child = transform(vec3(-1, 0, 4), axisAngle(globalX, -1.2f), vec3(1.0f, 0.5f, 3.0f));
+        vec3 p = vec3(0.25f, -2.0f, 1.0f);
+
+        vec3 expected = transformPoint(parent, transformPoint(child, p));
+        assert(distance(transformPoint(parent * child, p), expected) < 1e-5f);
+        assert(distance(transformPoint(inverse(parent), transformPoint(parent, p)), p) < 1e-5f);
+        vec4 pm = transformToMatrix(parent * child) * vec4(p, 1.0f);
+        assert(distance(pm.xyz(), expected) < 1e-5f);
+
+        constexpr size_t count = 6;
+        transform locals[count];
+        i32 parentIndices[count] = { -1, 0, 1, 0, 3, -1 };
+        for (size_t i = 0; i < count; ++i) {
+            locals[i] = transform(vec3(f32(i), 1.0f, 0.0f), axisAngle(globalZ, 0.3f * i), 1.0f + 0.1f * i);
+        }
+        transform worlds[count], composed[count];
+        computeWorldTransforms(locals, parentIndices, worlds, count);
+        composeTransformsBatch(worlds, locals, composed, count);
+        vec3 points[count], transformed[count];
+        for (size_t i = 0; i < count; ++i) {
+            points[i] = vec3(f32(i), -f32(i), 2.0f);
+        }
+        transformPointsBatch(worlds[4], points, transformed, count);
+        for (size_t i = 0; i < count; ++i) {
+            assert(distance(transformPoint(composed[i], p), transformPoint(worlds[i], transformPoint(locals[i], p))) < 1e-4f);
+            assert(distance(transformed[i], transformPoint(worlds[4], points[i])) < 1e-5f);
+        }
+        vec3 leaf = transformPoint(worlds[4], p);
+        vec3 leafExpected = transformPoint(locals[0], transformPoint(locals[3], transformPoint(locals[4], p)));
+        assert(distance(leaf, leafExpected) < 1e-5f);
+    }
+
+    fmt::print("matrix decomposition:\n");
+    {
+        constexpr size_t count = 7;
+        mat4 matrices[count];
+        for (size_t i = 0; i < count; ++i) {
+            quat rotation = axisAngle(normalize(vec3(1.0f + i, -2.0f, 0.5f * i)), 0.4f * i + 0.1f);
+            matrices[i] = translate(vec3(f32(i), 2.0f, -f32(i))) * rotate(rotation) * scale(vec3(1.0f + i, 0.05f + 0.3f * i, 3.0f));
+        }
+        // (non-uniform scale followed by a rotation gives shear, and a negative scale mirrors)
+        matrices[1] = matrices[1] * rotate(axisAngle(globalZ, 0.7f)) * scale(vec3(2.0f, 0.5f, 1.0f));
+        matrices[2] = matrices[2] * scale(vec3(-1.0f, 1.0f, 1.0f));
+        matrices[5] = scale(vec3(1.0f, 0.0f, 2.0f));
+
+        decomposition decompositions[count];
+        transform transforms[count];
+        decomposeBatch(matrices, decompositions, count);
+        decomposeBatch(matrices, transforms, count);
+        for (size_t i = 0; i < count; ++i) {
+            decomposition d = decompose(matrices[i]);
+            for (const decomposition& candidate : { d, decompositions[i] }) {
+                mat4 reconstructed = translate(candidate.translation) * rotate(candidate.rotation) * mat4(candidate.stretch());
+                for (int col = 0; col < 4; ++col) {
+                    assert(distance(reconstructed[col].xyz(), matrices[i][col].xyz()) < 1e-5f);
+                }
+            }
+            assert(distance(transforms[i].scale, d.scale) < 1e-5f);
+        }
+        assert(distance(decompositions[0].scale, vec3(1.0f, 0.05f, 3.0f)) < 1e-5f && length(decompositions[0].shear) < 1e-5f);
+        assert(std::abs(decompositions[1].shear.x) > 0.1f);
+        assert(decompositions[2].scale.x < 0.0f && decompositions[2].scale.y < 0.0f && decompositions[2].scale.z < 0.0f);
+        fmt::print(" sheared scale ({}, {}, {}), shear xy = {}\n", decompositions[1].scale.x, decompositions[1].scale.y, decompositions[1].scale.z, decompositions[1].shear.x);
+    }
+
+    fmt::print("normal matrices:\n");
+    {
+        constexpr size_t count = 6;
+        mat4 models[count];
+        for (size_t i = 0; i < count; ++i) {
+            quat rotation = axisAngle(normalize(vec3(f32(i), 1.0f, -1.0f)), 0.6f * i);
+            models[i] = translate(vec3(1.0f, f32(i), 2.0f)) * rotate(rotation) * scale(vec3(0.5f + i, 2.0f, i % 2 == 0 ? 1.0f : -3.0f));
+        }
+
+        // A normal stays perpendicular to a transformed tangent
+        vec3 tangent = normalize(vec3(1, 1, 0));
+        vec3 normal = normalize(vec3(1, -1, 2));
+        vec3 transformedTangent = (models[1] * vec4(tangent, 0.0f)).xyz();
+        assert(std::abs(dot(normalMatrix(models[1]) * normal, transformedTangent)) < 1e-5f);
+        assert(std::abs(dot(normalMatrixCofactor(models[1]) * normal, transformedTangent)) < 1e-5f);
+
+        mat3x4 modelPalette[count], normalPalette[count];
+        normalMatrixBatch(models, modelPalette, normalPalette, count);
+        for (size_t i = 0; i < count; ++i) {
+            mat3 expected = transpose(inverse(mat3(models[i])));
+            const vec4* normalRows[] = { &normalPalette[i].x, &normalPalette[i].y, &normalPalette[i].z };
+            const vec4* modelRows[] = { &modelPalette[i].x, &modelPalette[i].y, &modelPalette[i].z };
+            for (int row = 0; row < 3; ++row) {
+                vec3 expectedRow = vec3(expected.x[row], expected.y[row], expected.z[row]);
+                assert(distance(normalRows[row]->xyz(), expectedRow) < 1e-5f && normalRows[row]->w == 0.0f);
+                assert(std::abs(modelRows[row]->w - models[i].w[row]) < 1e-6f);
+            }
+        }
+
+        // Moving only changes the translation, so the cached normal matrix is kept
+        cachednormalmatrix cached { models[2] };
+        assert(!cached.setModel(translate(vec3(5, 0, 0)) * models[2]));
+        assert(cached.setModel(models[3]));
+        mat3 expected = transpose(inverse(mat3(models[3])));
+        assert(distance(cached.normal().x, expected.x) < 1e-5f && distance(cached.normal().z, expected.z) < 1e-5f);
+        fmt::print(" check normal matrices ...\n");
+    }
+
+    fmt::print("camera-relative rendering:\n");
+    {
+        dvec3 cameraPosition = dvec3(1.0e7, 250.0, -3.0e6);
+        dmat4 view = lookAt(cameraPosition, cameraPosition + dvec3(1.0, -0.2, 0.5), dvec3(0.0, 1.0, 0.0));
+
+        constexpr size_t count = 5;
+        dmat4 worlds[count];
+        dvec3 positions[count];
+        for (size_t i = 0; i < count; ++i) {
+            positions[i] = cameraPosition + dvec3(0.123 * i, 1.0 + 0.01 * i, -2.5 * i);
+            worlds[i] = translate(positions[i]) * rotate(axisAngle(dvec3(0, 1, 0), 0.3 * i)) * scale(1.0 + i);
+        }
+        fmat4 relativeMatrices[count];
+        fmat3x4 relativePalette[count];
+        fvec3 relativePositions[count];
+        cameraRelativeMatricesBatch(worlds, cameraPosition, relativeMatrices, count);
+        cameraRelativeMatricesBatch(worlds, cameraPosition, relativePalette, count);
+        cameraRelativePositionsBatch(positions, cameraPosition, relativePositions, count);
+
+        fmat4 relativeView = cameraRelativeViewMatrix(view, cameraPosition);
+        for (size_t i = 0; i < count; ++i) {
+            // The view space position of a local point is the same as with f64, and far more precise than plain f32
+            dvec4 expected = view * (worlds[i] * dvec4(0.5, 0.25, -1.0, 1.0));
+            fvec4 relative = relativeView * (relativeMatrices[i] * fvec4(0.5f, 0.25f, -1.0f, 1.0f));
+            assert(std::abs(relative.x - expected.x) < 1e-4 && std::abs(relative.y - expected.y) < 1e-4 && std::abs(relative.z - expected.z) < 1e-4);
+
+            fmat4 single = cameraRelativeMatrix(worlds[i], cameraPosition);
+            assert(distance(single.w.xyz(), relativeMatrices[i].w.xyz()) == 0.0f);
+            assert(relativePalette[i].x.w == single.w.x && relativePalette[i].y.x == single.x.y);
+            assert(distance(relativePositions[i], relativeMatrices[i].w.xyz()) < 1e-6f);
+        }
+
+        // df64 keeps ~48 bits of precision with only f32 arithmetic
+        df64 a = df64(1.0e7 + 0.123456789);
+        df64 b = df64(1.0e7);
+        f64 difference = static_cast<f64>(a - b);
+        fmt::print(" df64 difference {}, f32 difference {}\n", difference, static_cast<f32>(1.0e7 + 0.123456789) - 1.0e7f);
+        assert(std::abs(difference - 0.123456789) < 1e-7);
+        assert(std::abs(static_cast<f64>(df64(3.0) * df64(1.0 / 3.0)) - 1.0) < 1e-13);
+        assert(std::abs(static_cast<f64>(df64(2.0) / df64(3.0)) - 2.0 / 3.0) < 1e-13);
+        assert(std::abs(static_cast<f64>(sqrt(df64(2.0))) - std::sqrt(2.0)) < 1e-13);
+        assert(b < a && a != b);
+        assert(static_cast<f64>(df64(16777217)) == 16777217.0 && df64(-3) == -df64(3.0f));
+        assert(std::abs(static_cast<f64>(df64(3) * df64(1.0e30)) / 3.0e30 - 1.0) < 1e-13);
+
+        fvec3 high[count], low[count];
+        splitDf64Batch(positions, high, low, count);
+        for (size_t i = 0; i < count; ++i) {
+            assert(f64(high[i].x) + f64(low[i].x) == static_cast<f64>(df64(positions[i].x)));
+            assert(high[i].z == df64(positions[i].z).hi && low[i].y == df64(positions[i].y).lo);
+        }
+    }
+
     fmt::print("random:\n");
     {
         Random random { 12345u };
@@ -143,5 +1012,145 @@ int main()
         fmt::print(" check random values ...\n");
     }
 
+    fmt::print("cpu dispatch:\n");
+    {
+        fmt::print(" detected SIMD level {}, using {}\n", simdLevelName(detectedSimdLevel()), simdLevelName(simdLevel()));
+        assert(setSimdLevel(SimdLevel::Scalar) == SimdLevel::Scalar);
+        assert(setSimdLevel(SimdLevel::AVX512) <= detectedSimdLevel());
+
+        constexpr size_t count = 37;
+        mat4 transform = translate(vec3(1, 2, 3)) * rotate(axisAngle(globalUp, 0.7f)) * scale(vec3(2.0f));
+        mat3 conversion = colorspace::Rec2020_from_XYZ * colorspace::XYZ_from_sRGB;
+        frustum cullingFrustum { perspectiveProjectionToVulkanClipSpace(1.0f, 1.5f, 0.1f, 50.0f) * lookAt(vec3(0, 0, 5), vec3(0), globalUp) };
+        Random random { 71u };
+        vec3 points[count];
+        Float radii[count];
+        quat rotations[count];
+        vec3 scales[count];
+        for (size_t i = 0; i < count; ++i) {
+            points[i] = vec3(random.randomFloatInRange(-20.0f, 20.0f), random.randomFloatInRange(-20.0f, 20.0f), random.randomFloatInRange(-60.0f, 10.0f));
+            radii[i] = random.randomFloatInRange(0.0f, 5.0f);
+            rotations[i] = axisAngle(normalize(points[i] + vec3(0.1f)), radii[i]);
+            scales[i] = vec3(1.0f + 0.1f * radii[i], 1.0f, 2.0f - 0.1f * radii[i]);
+        }
+
+        setSimdLevel(SimdLevel::Scalar);
+        vec3 expectedPoints[count], expectedColors[count];
+        Containment expectedContainments[count];
+        f32 expectedRandoms[count];
+        mat3x4 expectedPalette[count];
+        transformPointsBatch(transform, points, expectedPoints, count);
+        colorspace::convertBatch(conversion, points, expectedColors, count);
+        cullingFrustum.classifyBatch(points, radii, expectedContainments, count);
+        randomFloatsBatch(71u, 5u, expectedRandoms, count);
+        quatToMatrixBatch(rotations, points, scales, expectedPalette, count);
+
+        for (int level = 0; level < static_cast<int>(SimdLevel::Count); ++level) {
+            setSimdLevel(static_cast<SimdLevel>(level));
+            vec3 transformed[count], colors[count];
+            Containment containments[count];
+            f32 randoms[count];
+            mat3x4 palette[count];
+            transformPointsBatch(transform, points, transformed, count);
+            colorspace::convertBatch(conversion, points, colors, count);
+            cullingFrustum.classifyBatch(points, radii, containments, count);
+            randomFloatsBatch(71u, 5u, randoms, count);
+            quatToMatrixBatch(rotations, points, scales, palette, count);
+            for (size_t i = 0; i < count; ++i) {
+                assert(distance(transformed[i], vec3(transform * vec4(points[i], 1.0f))) < 1e-4f);
+                assert(distance(transformed[i], expectedPoints[i]) < 1e-4f);
+                assert(distance(colors[i], expectedColors[i]) < 1e-4f);
+                assert(containments[i] == expectedContainments[i] && containments[i] == cullingFrustum.classify(points[i], radii[i]));
+                assert(randoms[i] == expectedRandoms[i] && randoms[i] >= 0.0f && randoms[i] < 1.0f);
+                for (size_t j = 0; j < 12; ++j) {
+                    assert(std::abs(value_ptr(palette[i])[j] - value_ptr(expectedPalette[i])[j]) < 1e-5f);
+                }
+            }
+        }
+        setSimdLevel(detectedSimdLevel());
+
+        f32 filled[count];
+        random.fillRandomFloats(filled, count);
+        fmt::print(" check batch kernels match at every level ...\n");
+    }
+
+    fmt::print("parallel:\n");
+    {
+        ThreadPool pool { 3 };
+        constexpr size_t count = 1000;
+        std::vector<vec3> points(count), transformed(count);
+        for (size_t i = 0; i < count; ++i) {
+            points[i] = vec3(static_cast<Float>(i), 1.0f, 2.0f);
+        }
+        mat4 transform = translate(vec3(0, 0, 10)) * scale(vec3(2.0f));
+        parallelFor(0, count, 64, [&](size_t begin, size_t end) {
+            transformPointsBatch(transform, points.data() + begin, transformed.data() + begin, end - begin);
+        }, pool);
+        for (size_t i = 0; i < count; ++i) {
+            assert(distance(transformed[i], vec3(2.0f * static_cast<Float>(i), 2.0f, 14.0f)) < 1e-4f);
+        }
+
+        f64 sum = parallelReduce(0, count, 100, 0.0, [&](size_t begin, size_t end) {
+            f64 partial = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                partial += transformed[i].x;
+            }
+            return partial;
+        }, [](f64 a, f64 b) { return a + b; }, pool);
+        assert(sum == 999.0 * 1000.0);
+
+        std::atomic<int> taskCount { 0 };
+        TaskGroup group { pool };
+        for (int i = 0; i < 8; ++i) {
+            group.run([&] {
+                parallelFor(0, 10, 1, [&](size_t begin, size_t end) { taskCount += static_cast<int>(end - begin); }, pool);
+            });
+        }
+        group.wait();
+        assert(taskCount == 80);
+
+        fmt::print(" check parallel for, reduce and task groups ...\n");
+    }
+
+    fmt::print("allocators:\n");
+    {
+        AlignedVector<mat4> matrices(5, mat4(1.0f));
+        assert(reinterpret_cast<uintptr_t>(matrices.data()) % SimdAlignment == 0);
+        AlignedVector<f32, 32> floats { 1.0f, 2.0f, 3.0f };
+        assert(reinterpret_cast<uintptr_t>(floats.data()) % 32 == 0 && floats[2] == 3.0f);
+
+        FrameArena arena { 64 * 1024 };
+        vec3* points = arena.allocateArray<vec3>(100);
+        FrameArena::Marker marker = arena.mark();
+        mat4* scratch = arena.allocateArray<mat4>(16);
+        assert(points != nullptr && scratch != nullptr);
+        assert(reinterpret_cast<uintptr_t>(scratch) % SimdAlignment == 0 && arena.used() >= marker + 16 * sizeof(mat4));
+        arena.resetTo(marker);
+        assert(arena.used() == marker);
+        {
+            std::vector<u32, ArenaAllocator<u32>> indices { ArenaAllocator<u32>(arena) };
+            for (u32 i = 0; i < 100; ++i) {
+                indices.push_back(i);
+            }
+            assert(indices[99] == 99 && arena.used() > marker);
+        }
+        arena.reset();
+        assert(arena.used() == 0);
+
+        struct Node {
+            Node* children[2] { nullptr, nullptr };
+            aabb3 bounds {};
+        };
+        PoolAllocator<Node> nodePool { 4 };
+        Node* root = nodePool.create();
+        root->children[0] = nodePool.create();
+        root->children[1] = nodePool.create();
+        assert(nodePool.liveCount() == 3 && nodePool.capacity() == 4);
+        Node* child = root->children[1];
+        nodePool.destroy(child);
+        assert(nodePool.create() == child);
+        fmt::print(" check aligned, arena and pool allocation ...\n");
+    }
+
     // etc..
 }